@@ -0,0 +1,200 @@
+/**
+ * baseline.cpp --
+ *
+ *      Saves the benchmark results of a run and compares later runs
+ *      against them.  A baseline file keeps one line per device (its
+ *      "platform[i] device[j]" tag and names), driver version and metric,
+ *      so a single file can follow a fleet of devices through driver
+ *      updates, and identical devices in one machine stay apart:
+ *
+ *          # clinfo baseline 1
+ *          saved<TAB>tag<TAB>platform<TAB>device<TAB>driver<TAB>metric<TAB>runs<TAB>mean<TAB>ci<TAB>median
+ *
+ *      saved is the Unix time the line was written.
+ *
+ *      All values are times in seconds, so lower is better for every
+ *      metric.  A metric regresses when its mean got slower by more than
+ *      the threshold and the confidence intervals of both runs do not
+ *      overlap.
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include "bench.h"
+
+using namespace std;
+
+#define BASELINE_HEADER "# clinfo baseline 1"
+
+namespace {
+
+struct Entry {
+  uint64_t saved;   /* Unix time */
+  string tag;
+  string platform, device, driver, metric;
+  size_t runs;
+  double mean, ci, median;
+};
+
+}
+
+/* Tabs and newlines would break the line format. */
+static string field(const string& s)
+{
+  string r = s;
+  for (auto& c : r)
+    if ('\t' == c || '\n' == c)
+      c = ' ';
+  return r;
+}
+
+static bool same_metric(const Entry& e, const Bench_result& r)
+{
+  return e.tag == field(r.tag) && e.platform == field(r.device.platform)
+         && e.device == field(r.device.name) && e.metric == field(r.metric);
+}
+
+/**
+ * load --
+ *
+ *      Reads a baseline file.
+ *
+ * Results:
+ *      true and the entries in file order; a missing file is an empty
+ *      baseline if missing_ok.
+ */
+static bool load(const string& path, vector<Entry>& entries, bool missing_ok)
+{
+  ifstream in(path);
+  if (!in)
+  {
+    if (missing_ok && ENOENT == errno)
+      return true;
+    cerr << "Unable to open " << path << ": " << strerror(errno) << "!" << endl;
+    return false;
+  }
+  string line;
+  if (!getline(in, line) || line != BASELINE_HEADER)
+  {
+    cerr << path << ": not a clinfo baseline!" << endl;
+    return false;
+  }
+  for (int number = 2; getline(in, line); ++number)
+  {
+    Entry e;
+    stringstream ss(line);
+    string saved, runs, mean, ci, median;
+    if (!getline(ss, saved, '\t') || !getline(ss, e.tag, '\t')
+        || !getline(ss, e.platform, '\t') || !getline(ss, e.device, '\t') || !getline(ss, e.driver, '\t')
+        || !getline(ss, e.metric, '\t') || !getline(ss, runs, '\t') || !getline(ss, mean, '\t')
+        || !getline(ss, ci, '\t') || !getline(ss, median))
+    {
+      cerr << path << ":" << number << ": malformed baseline entry!" << endl;
+      return false;
+    }
+    e.saved = strtoull(saved.c_str(), nullptr, 10);
+    e.runs = strtoul(runs.c_str(), nullptr, 10);
+    e.mean = strtod(mean.c_str(), nullptr);
+    e.ci = strtod(ci.c_str(), nullptr);
+    e.median = strtod(median.c_str(), nullptr);
+    entries.push_back(e);
+  }
+  return true;
+}
+
+bool baseline_save(const string& path)
+{
+  vector<Entry> entries;
+  if (!load(path, entries, true))
+    return false;
+  uint64_t now = time(nullptr);
+  for (auto& r : bench_results())
+  {
+    Entry e = {now, field(r.tag), field(r.device.platform), field(r.device.name), field(r.device.driver),
+               field(r.metric), r.stats.runs, r.stats.mean, r.stats.ci, r.stats.median};
+    auto replaced = false;
+    for (auto& old : entries)
+    {
+      if (old.tag == e.tag && old.platform == e.platform && old.device == e.device && old.driver == e.driver
+          && old.metric == e.metric)
+      {
+        old = e;
+        replaced = true;
+      }
+    }
+    if (!replaced)
+      entries.push_back(e);
+  }
+
+  auto tmp = path + ".tmp." + to_string(getpid());
+  auto fp = fopen(tmp.c_str(), "w");
+  if (nullptr == fp)
+  {
+    cerr << "Unable to create " << tmp << ": " << strerror(errno) << "!" << endl;
+    return false;
+  }
+  fprintf(fp, "%s\n", BASELINE_HEADER);
+  for (auto& e : entries)
+    fprintf(fp, "%llu\t%s\t%s\t%s\t%s\t%s\t%zu\t%.9g\t%.9g\t%.9g\n", (unsigned long long) e.saved, e.tag.c_str(),
+            e.platform.c_str(), e.device.c_str(), e.driver.c_str(), e.metric.c_str(), e.runs, e.mean, e.ci, e.median);
+  auto ok = 0 == fclose(fp);
+  if (!ok || 0 != rename(tmp.c_str(), path.c_str()))
+  {
+    cerr << "Unable to write " << path << ": " << strerror(errno) << "!" << endl;
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+int baseline_compare(const string& path, double threshold)
+{
+  vector<Entry> entries;
+  if (!load(path, entries, false))
+    return EXIT_FAILURE;
+
+  auto regressions = 0;
+  for (auto& r : bench_results())
+  {
+    /* Prefer the same driver, then the most recently saved entry */
+    auto driver = field(r.device.driver);
+    const Entry* base = nullptr;
+    for (auto& e : entries)
+    {
+      if (!same_metric(e, r))
+        continue;
+      auto same = e.driver == driver;
+      auto base_same = base && base->driver == driver;
+      if (nullptr == base || (same && !base_same) || (same == base_same && e.saved > base->saved))
+        base = &e;
+    }
+    if (nullptr == base)
+    {
+      printf("%s: %-28s no baseline\n", r.tag.c_str(), r.metric.c_str());
+      continue;
+    }
+    auto change = r.stats.mean / base->mean - 1.0;
+    auto separated = r.stats.mean * (1.0 - r.stats.ci) > base->mean * (1.0 + base->ci)
+                     || r.stats.mean * (1.0 + r.stats.ci) < base->mean * (1.0 - base->ci);
+    const char* verdict = "unchanged";
+    if (separated && change > threshold)
+    {
+      verdict = "REGRESSION";
+      ++regressions;
+    }
+    else if (separated && change < -threshold)
+      verdict = "improved";
+    printf("%s: %-28s %10s -> %10s (%+6.1f%%, driver %s) %s%s\n", r.tag.c_str(), r.metric.c_str(),
+           format_seconds(base->mean).c_str(), format_seconds(r.stats.mean).c_str(), change * 100,
+           base->driver.c_str(), verdict, r.stats.noisy ? ", noisy" : "");
+  }
+  if (regressions)
+    printf("%d metric%s regressed by more than %.1f%%\n", regressions, 1 == regressions ? "" : "s", threshold * 100);
+  return regressions ? EXIT_REGRESSION : EXIT_SUCCESS;
+}
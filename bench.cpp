@@ -0,0 +1,381 @@
+/**
+ * bench.cpp --
+ *
+ *      Scaffolding shared by the device benchmarks.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "icd.h"
+#include "timeline.h"
+
+using namespace std;
+
+Bench_context::Bench_context(const string& tag, const vector<cl_device_id>& devices)
+  : tag(tag), devices(devices), context(nullptr)
+{
+  cl_int err;
+  auto ctx = clCreateContext(NULL, devices.size(), devices.data(), NULL, NULL, &err);
+  if (!check(err, "create context"))
+    return;
+  for (auto device : devices)
+  {
+    auto queue = clCreateCommandQueue(ctx, device, CL_QUEUE_PROFILING_ENABLE, &err);
+    if (!check(err, "create command queue"))
+    {
+      for (auto q : queues)
+        clReleaseCommandQueue(q);
+      queues.clear();
+      clReleaseContext(ctx);
+      return;
+    }
+    queues.push_back(queue);
+    if (Timeline::enabled())
+      tracks.push_back(Timeline::device_track(tag + " queue " + to_string(queues.size() - 1), queue));
+  }
+  context = ctx;
+}
+
+Bench_context::~Bench_context()
+{
+  for (auto q : queues)
+    clFinish(q);
+  record_pending();
+  for (auto k : kernels)
+    clReleaseKernel(k);
+  for (auto p : programs)
+    clReleaseProgram(p);
+  for (auto m : buffers)
+    clReleaseMemObject(m);
+#ifdef CL_VERSION_2_0
+  for (auto p : svm_buffers)
+    clSVMFree(context, p);
+#endif
+  for (auto q : queues)
+    clReleaseCommandQueue(q);
+  if (context != nullptr)
+    clReleaseContext(context);
+}
+
+/**
+ * Bench_context::check --
+ *
+ *      Reports a failed OpenCL call against the benchmark's tag.
+ *
+ * Results:
+ *      true if err is CL_SUCCESS.
+ */
+bool Bench_context::check(cl_int err, const char* what) const
+{
+  if (CL_SUCCESS == err)
+    return true;
+  cerr << tag << ": Unable to " << what << ": " << cl_error_str(err) << "!" << endl;
+  return false;
+}
+
+bool Bench_context::finish()
+{
+  for (auto q : queues)
+    if (!check(clFinish(q), "finish command queue"))
+      return false;
+  record_pending();
+  return true;
+}
+
+bool Bench_context::enqueue(size_t ii, cl_kernel kernel, cl_uint dims, const size_t* global, const size_t* local)
+{
+  if (!Timeline::enabled())
+    return check(clEnqueueNDRangeKernel(queues[ii], kernel, dims, NULL, global, local, 0, NULL, NULL), "enqueue kernel");
+
+  char name[256] = "kernel";
+  clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof name, name, NULL);
+  name[sizeof name - 1] = '\0';
+  cl_event event;
+  {
+    Timeline_scope scope(string("enqueue ") + name, "enqueue");
+    if (!check(clEnqueueNDRangeKernel(queues[ii], kernel, dims, NULL, global, local, 0, NULL, &event), "enqueue kernel"))
+      return false;
+  }
+  pending.push_back(Pending{ii, name, event});
+  return true;
+}
+
+/**
+ * Bench_context::record_pending --
+ *
+ *      Moves the finished commands of enqueue onto the timeline.
+ *
+ * Results:
+ *      void.
+ */
+void Bench_context::record_pending()
+{
+  for (auto& p : pending)
+  {
+    cl_int status;
+    if (CL_SUCCESS == clGetEventInfo(p.event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof status, &status, NULL)
+        && CL_COMPLETE == status)
+      Timeline::device_event(tracks[p.queue], p.name, p.event);
+    clReleaseEvent(p.event);
+  }
+  pending.clear();
+}
+
+/**
+ * Bench_context::build --
+ *
+ *      Builds a program for all devices of the context, dumping the
+ *      build log of the first device on failure.
+ *
+ * Results:
+ *      the program or nullptr.
+ */
+cl_program Bench_context::build(const char* source, const char* options)
+{
+  cl_int err;
+  auto program = clCreateProgramWithSource(context, 1, &source, NULL, &err);
+  if (!check(err, "create program"))
+    return nullptr;
+  programs.push_back(program);
+  err = clBuildProgram(program, devices.size(), devices.data(), options, NULL, NULL);
+  if (!check(err, "build program"))
+  {
+    char log[16384];
+    if (CL_SUCCESS == clGetProgramBuildInfo(program, devices[0], CL_PROGRAM_BUILD_LOG, sizeof log, log, NULL))
+      cerr << log << endl;
+    return nullptr;
+  }
+  return program;
+}
+
+cl_kernel Bench_context::kernel(cl_program program, const char* name)
+{
+  cl_int err;
+  auto kernel = clCreateKernel(program, name, &err);
+  if (!check(err, (string("create kernel ") + name).c_str()))
+    return nullptr;
+  kernels.push_back(kernel);
+  return kernel;
+}
+
+/**
+ * Bench_context::set_arg --
+ *
+ *      Sets one kernel argument.
+ *
+ * Results:
+ *      true on success, otherwise false after reporting which argument
+ *      of which kernel failed.
+ */
+bool Bench_context::set_arg(cl_kernel kernel, cl_uint index, size_t size, const void* value) const
+{
+  auto err = clSetKernelArg(kernel, index, size, value);
+  if (CL_SUCCESS == err)
+    return true;
+  char name[256] = "";
+  clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof name, name, NULL);
+  name[sizeof name - 1] = '\0';
+  return check(err, ("set argument " + to_string(index) + " of " + name).c_str());
+}
+
+cl_mem Bench_context::buffer(cl_mem_flags flags, size_t size, void* host_ptr)
+{
+  cl_int err;
+  auto mem = clCreateBuffer(context, flags, size, host_ptr, &err);
+  if (!check(err, "create buffer"))
+    return nullptr;
+  buffers.push_back(mem);
+  return mem;
+}
+
+#ifdef CL_VERSION_2_0
+void* Bench_context::svm_alloc(cl_svm_mem_flags flags, size_t size)
+{
+  auto ptr = clSVMAlloc(context, flags, size, 0);
+  if (nullptr == ptr)
+  {
+    cerr << tag << ": Unable to allocate " << size << " bytes of shared virtual memory!" << endl;
+    return nullptr;
+  }
+  svm_buffers.push_back(ptr);
+  return ptr;
+}
+#endif
+
+uint64_t device_uint(cl_device_id device, cl_device_info param)
+{
+  uint64_t val = 0; /* Narrower params fill only the low bytes */
+  if (CL_SUCCESS != icd_get_device_info(device, param, sizeof val, &val, NULL))
+    return 0;
+  return val;
+}
+
+string device_string(cl_device_id device, cl_device_info param)
+{
+  char buf[4096];
+  if (CL_SUCCESS != icd_get_device_info(device, param, sizeof buf, buf, NULL))
+    return string();
+  buf[sizeof buf - 1] = '\0';
+  return buf;
+}
+
+double event_seconds(cl_event event)
+{
+  cl_ulong start, end;
+  if (CL_SUCCESS != clWaitForEvents(1, &event)
+      || CL_SUCCESS != clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof start, &start, NULL)
+      || CL_SUCCESS != clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof end, &end, NULL))
+    return -1.0;
+  return (end - start) * 1e-9;
+}
+
+Device_identity device_identity(cl_device_id device)
+{
+  Device_identity id;
+  cl_platform_id platform;
+  char buf[4096];
+  if (CL_SUCCESS == icd_get_device_info(device, CL_DEVICE_PLATFORM, sizeof platform, &platform, NULL)
+      && CL_SUCCESS == icd_get_platform_info(platform, CL_PLATFORM_NAME, sizeof buf, buf, NULL))
+  {
+    buf[sizeof buf - 1] = '\0';
+    id.platform = buf;
+  }
+  id.name = device_string(device, CL_DEVICE_NAME);
+  id.vendor = device_string(device, CL_DEVICE_VENDOR);
+  id.version = device_string(device, CL_DEVICE_VERSION);
+  id.driver = device_string(device, CL_DRIVER_VERSION);
+  return id;
+}
+
+/**
+ * t_quantile --
+ *
+ *      The two-sided 95% quantile of Student's t distribution, so small
+ *      run counts get honest confidence intervals.
+ *
+ * Results:
+ *      the quantile for the given degrees of freedom.
+ */
+static double t_quantile(size_t df)
+{
+  static const double table[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (0 == df)
+    return INFINITY;
+  return df <= sizeof table / sizeof table[0] ? table[df - 1] : 1.96;
+}
+
+#define OUTLIER_MADS     3.0
+#define OUTLIER_MIN      0.05 /* relative deviation that is never an outlier */
+#define OUTLIER_FRACTION 0.1
+
+/**
+ * bench_summarize --
+ *
+ *      Rejects the samples more than OUTLIER_MADS scaled median absolute
+ *      deviations away from the median (a preempted run, a page fault
+ *      storm) and summarizes the rest.
+ *
+ * Results:
+ *      the statistics; noisy if the confidence interval is wider than
+ *      the target or too many runs had to be rejected.
+ */
+Bench_stats bench_summarize(vector<double> samples, double target_ci)
+{
+  Bench_stats stats = Bench_stats();
+  if (samples.empty())
+  {
+    stats.noisy = true;
+    return stats;
+  }
+  sort(samples.begin(), samples.end());
+  auto median = [](const vector<double>& v) { return (v[(v.size() - 1) / 2] + v[v.size() / 2]) / 2; };
+  auto med = median(samples);
+  vector<double> deviations;
+  for (auto x : samples)
+    deviations.push_back(fabs(x - med));
+  sort(deviations.begin(), deviations.end());
+  /* 1.4826 MAD estimates sigma; the floor keeps timer quantization from rejecting runs */
+  auto limit = max(OUTLIER_MADS * 1.4826 * median(deviations), OUTLIER_MIN * med);
+  auto total = samples.size();
+  samples.erase(remove_if(samples.begin(), samples.end(), [&](double x) { return fabs(x - med) > limit; }),
+                samples.end());
+
+  auto n = samples.size();
+  auto rank = [&](double p) { return samples[min(n - 1, (size_t) ceil(p * n) - 1)]; };
+  stats.runs = n;
+  stats.outliers = total - n;
+  stats.min = samples.front();
+  stats.median = median(samples);
+  stats.p90 = rank(0.90);
+  stats.p99 = rank(0.99);
+  stats.max = samples.back();
+  double sum = 0, sum2 = 0;
+  for (auto x : samples)
+    sum += x;
+  stats.mean = sum / n;
+  for (auto x : samples)
+    sum2 += (x - stats.mean) * (x - stats.mean);
+  auto sd = n > 1 ? sqrt(sum2 / (n - 1)) : 0.0;
+  stats.cv = stats.mean > 0 ? sd / stats.mean : 0.0;
+  stats.ci = n > 1 && stats.mean > 0 ? t_quantile(n - 1) * sd / sqrt(n) / stats.mean : INFINITY;
+  stats.noisy = stats.ci > target_ci || stats.outliers > OUTLIER_FRACTION * total;
+  return stats;
+}
+
+bool bench_measure(const function<double()>& run, Bench_stats& stats, const Bench_policy& policy)
+{
+  for (int ii = 0; ii < policy.warmup; ++ii)
+    if (run() < 0)
+      return false;
+
+  vector<double> samples;
+  double elapsed = 0;
+  for (;;)
+  {
+    auto t = run();
+    if (t < 0)
+      return false;
+    samples.push_back(t);
+    elapsed += t;
+    if ((int) samples.size() < policy.min_runs)
+      continue;
+    stats = bench_summarize(samples, policy.target_ci);
+    if (!stats.noisy || elapsed >= policy.budget || (int) samples.size() >= policy.max_runs)
+      return true;
+  }
+}
+
+static vector<Bench_result> results;
+
+void bench_report(const string& tag, cl_device_id device, const string& metric,
+                  const Bench_stats& stats, double work, const char* unit)
+{
+  Bench_result r;
+  r.tag = tag;
+  r.device = device ? device_identity(device) : Device_identity();
+  r.metric = metric;
+  r.stats = stats;
+  r.work = work;
+  r.unit = unit;
+  results.push_back(r);
+
+  printf("%s: %-28s median %10s, min %10s, p90 %10s, p99 %10s, max %10s, cv %5.1f%%, %3zu runs",
+         tag.c_str(), metric.c_str(), format_seconds(stats.median).c_str(), format_seconds(stats.min).c_str(),
+         format_seconds(stats.p90).c_str(), format_seconds(stats.p99).c_str(), format_seconds(stats.max).c_str(),
+         stats.cv * 100, stats.runs);
+  if (stats.outliers)
+    printf(" (%zu outlier%s rejected)", stats.outliers, 1 == stats.outliers ? "" : "s");
+  if (work > 0 && stats.median > 0)
+    printf(" = %.2f %s", work / stats.median, unit);
+  printf("%s\n", stats.noisy ? " NOISY" : "");
+}
+
+const vector<Bench_result>& bench_results()
+{
+  return results;
+}
@@ -0,0 +1,174 @@
+/**
+ * bench.h --
+ *
+ *      Scaffolding shared by the device benchmarks and probes: a context
+ *      with one profiling command queue per device, program builds and
+ *      timing helpers.  Every benchmark reports under a tag such as
+ *      "platform[0] device[1]" and skips the device on the first error.
+ */
+#ifndef CLINFO_BENCH_H
+#define CLINFO_BENCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "clinfo.h"
+#include "format.h"
+
+class Bench_context {
+
+public:
+
+  Bench_context(const std::string& tag, const std::vector<cl_device_id>& devices);
+  ~Bench_context();
+
+  explicit operator bool() const { return context != nullptr; }
+  cl_context get() const { return context; }
+  size_t size() const { return queues.size(); }
+  cl_device_id device(size_t ii = 0) const { return devices[ii]; }
+  cl_command_queue queue(size_t ii = 0) const { return queues[ii]; }
+  const std::string& name() const { return tag; }
+
+  /* The objects below are owned by the context and released with it. */
+  cl_program build(const char* source, const char* options = "");
+  cl_kernel kernel(cl_program program, const char* name);
+  cl_mem buffer(cl_mem_flags flags, size_t size, void* host_ptr = nullptr);
+#ifdef CL_VERSION_2_0
+  void* svm_alloc(cl_svm_mem_flags flags, size_t size);
+#endif
+
+  /* Enqueues a kernel and, with a timeline, records its execution. */
+  bool enqueue(size_t ii, cl_kernel kernel, cl_uint dims, const size_t* global, const size_t* local = nullptr);
+
+  bool check(cl_int err, const char* what) const;
+  /* clSetKernelArg, reported with the argument index and kernel name. */
+  bool set_arg(cl_kernel kernel, cl_uint index, size_t size, const void* value) const;
+  bool finish();
+
+private:
+  std::string tag;
+  std::vector<cl_device_id> devices;
+  cl_context context;
+  std::vector<cl_command_queue> queues;
+  std::vector<cl_program> programs;
+  std::vector<cl_kernel> kernels;
+  std::vector<cl_mem> buffers;
+  std::vector<void*> svm_buffers;
+  struct Pending { size_t queue; std::string name; cl_event event; };
+  std::vector<int> tracks;
+  std::vector<Pending> pending;
+
+  void record_pending();
+
+  Bench_context(const Bench_context&) = delete;
+  Bench_context& operator=(const Bench_context&) = delete;
+};
+
+/* Device queries that return 0 or an empty string on failure. */
+uint64_t device_uint(cl_device_id device, cl_device_info param);
+std::string device_string(cl_device_id device, cl_device_info param);
+
+/* Elapsed device time of a profiled command, negative on failure. */
+double event_seconds(cl_event event);
+
+/* The strings print_device() identifies a device by. */
+struct Device_identity {
+  std::string platform, name, vendor, version, driver;
+};
+
+Device_identity device_identity(cl_device_id device);
+
+/* How bench_measure repeats a run. */
+struct Bench_policy {
+  Bench_policy() : warmup(1), min_runs(5), max_runs(100), target_ci(0.02), budget(1.0) {}
+  int warmup;       /* untimed runs first */
+  int min_runs;
+  int max_runs;
+  double target_ci; /* stop once the 95% confidence interval is this close */
+  double budget;    /* or once the timed runs took this many seconds */
+};
+
+/* Summary of the timed runs left after outlier rejection, in seconds. */
+struct Bench_stats {
+  size_t runs, outliers;
+  double min, median, p90, p99, max, mean;
+  double cv; /* coefficient of variation */
+  double ci; /* half width of the 95% confidence interval of the mean, relative */
+  bool noisy;
+};
+
+/* One reported measurement, self-describing for baselines. */
+struct Bench_result {
+  std::string tag;
+  Device_identity device;
+  std::string metric;
+  Bench_stats stats;
+  double work;      /* per run, in units of unit times seconds */
+  std::string unit; /* empty for a latency */
+};
+
+/*
+ * Times run (which returns the seconds of one run, negative on failure)
+ * until the policy is satisfied.
+ */
+bool bench_measure(const std::function<double()>& run, Bench_stats& stats,
+                   const Bench_policy& policy = Bench_policy());
+Bench_stats bench_summarize(std::vector<double> samples, double target_ci = Bench_policy().target_ci);
+/* Prints a measurement and adds it to bench_results(); device is null for host work. */
+void bench_report(const std::string& tag, cl_device_id device, const std::string& metric,
+                  const Bench_stats& stats, double work = 0.0, const char* unit = "");
+const std::vector<Bench_result>& bench_results();
+
+/* Baselines of bench_results() per device, driver version and metric. */
+#define EXIT_REGRESSION 2
+
+bool baseline_save(const std::string& path);
+int baseline_compare(const std::string& path, double threshold);
+
+/* The benchmarks and probes, each run on one device at a time. */
+typedef void (*Benchmark)(const std::string& tag, cl_device_id device);
+
+void bench_partition(const std::string& tag, cl_device_id device);
+void bench_svm(const std::string& tag, cl_device_id device);
+void probe_alloc(const std::string& tag, cl_device_id device);
+void probe_zero_copy(const std::string& tag, cl_device_id device);
+void bench_roofline(const std::string& tag, cl_device_id device);
+void bench_rect(const std::string& tag, cl_device_id device);
+void bench_align(const std::string& tag, cl_device_id device);
+void bench_access(const std::string& tag, cl_device_id device);
+
+void report_kernels(const std::string& tag, cl_device_id device);
+
+/* Sets the OpenCL C file and build options report_kernels() uses. */
+void kernel_file(const std::string& path, const std::string& options);
+/* Adds a user kernel "file.cl:kernel:items:ops:bytes[:type]" to the roofline, built with options. */
+void roofline_kernel(const std::string& spec, const std::string& options);
+/* Writes the measured rooflines as JSON for a .json path, CSV otherwise. */
+bool roofline_write(const std::string& path);
+
+/*
+ * Writes the device inventory in the Prometheus text format, with probe
+ * results up to probe_age seconds old if it is positive.
+ */
+int prometheus_export(const std::string& path, double probe_age);
+
+#define PROMETHEUS_PROBE_AGE 600 /* seconds, by default */
+/* Prints changes of the dynamic device state every interval seconds. */
+int watch(double interval);
+/*
+ * Prints the platform:device indices of the devices the expression
+ * selects; EXIT_FAILURE if there are none, EXIT_QUERY_FAILED if the
+ * expression is malformed or a device could not be queried.
+ */
+int select_devices(const std::string& expression);
+/* Only compiles the expression; false and the message of the first error. */
+bool select_check(const std::string& expression, std::string& error);
+/* Builds every .cl file of dir with every option set for every device. */
+int compile_farm(const std::string& dir, const std::vector<std::string>& option_sets, unsigned jobs);
+/* Times platform discovery through the ICD loader and with only these libraries. */
+int bench_icd(const std::vector<std::string>& libraries);
+/* Times each phase of clinfo's own device discovery, cold and warm. */
+int self_bench(unsigned runs);
+
+#endif
@@ -0,0 +1,257 @@
+/**
+ * bench_access.cpp --
+ *
+ *      Measures effective global memory bandwidth under irregular access
+ *      patterns, to tell how much a device loses when neighbouring
+ *      work-items do not touch neighbouring addresses:
+ *
+ *      stride N  work-item i reads element i * N modulo the element
+ *                count, permuted so every element is read once, and
+ *                writes element i.
+ *      gather    reads through a random permutation, writes in order.
+ *      scatter   reads in order, writes through a random permutation.
+ *      random    reads and writes through random permutations.
+ *
+ *      Every pattern runs for elements of 1 to 16 bytes and with a
+ *      working set that fits in half of GLOBAL_MEM_CACHE_SIZE and one
+ *      eight times as large.  The bandwidth counts the payload read and
+ *      written, not the index loads of the last three patterns, since
+ *      that is what a workload gets for its data.  Each working set ends
+ *      with the coalescing curve: every pattern as a percentage of the
+ *      unit stride bandwidth at the same element size.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include "bench.h"
+
+using namespace std;
+
+#define ACCESS_MAX_BYTES     (256 << 20)
+#define ACCESS_DEFAULT_CACHE (1 << 20) /* when the device does not report one */
+#define ACCESS_CACHE_FACTOR  8
+
+/*
+ * The strided kernel runs on n = 1 << shift elements with a stride of
+ * odd << pow2, pow2 <= shift.  Writing i as hi << (shift - pow2) | lo,
+ * j = i << pow2 wraps to lo << pow2 and j >> shift is hi, so
+ * j + (j >> shift) is lo << pow2 | hi: a permutation of 0 .. n - 1.
+ * Multiplying by an odd number is a permutation modulo a power of two,
+ * so the read index is one too, and neighbouring work-items stay a
+ * stride apart.
+ */
+static const char* access_source = R"CLC(
+__kernel void strided(__global const T* src, __global T* dst, uint pow2, ulong odd, ulong mask, uint shift)
+{
+  ulong i = get_global_id(0), j = i << pow2;
+  dst[i] = src[((j + (j >> shift)) * odd) & mask];
+}
+
+__kernel void gather(__global const T* src, __global T* dst, __global const uint* index)
+{
+  size_t i = get_global_id(0);
+  dst[i] = src[index[i]];
+}
+
+__kernel void scatter(__global const T* src, __global T* dst, __global const uint* index)
+{
+  size_t i = get_global_id(0);
+  dst[index[i]] = src[i];
+}
+
+__kernel void random(__global const T* src, __global T* dst, __global const uint* index, uint mask)
+{
+  size_t i = get_global_id(0);
+  dst[index[i]] = src[index[i ^ mask]];
+}
+)CLC";
+
+static const cl_ulong strides[] = {1, 2, 4, 8, 16, 32, 3, 7, 17, 33};
+#define NUM_STRIDES (sizeof strides / sizeof strides[0])
+
+enum Pattern { GATHER = NUM_STRIDES, SCATTER, RANDOM, NUM_PATTERNS };
+
+static struct {size_t size; const char* type;} elements[] = {
+  {1, "uchar"}, {2, "ushort"}, {4, "uint"}, {8, "uint2"}, {16, "uint4"}};
+#define NUM_ELEMENTS (sizeof elements / sizeof elements[0])
+
+static string pattern_name(int pattern)
+{
+  switch (pattern)
+  {
+  case GATHER:  return "gather";
+  case SCATTER: return "scatter";
+  case RANDOM:  return "random";
+  default:      return "stride " + to_string(strides[pattern]);
+  }
+}
+
+/**
+ * time_kernel --
+ *
+ *      Times a kernel whose arguments are set, briefly: the sweep runs
+ *      well over a hundred of them per device.
+ *
+ * Results:
+ *      true and the statistics if it was measured.
+ */
+static bool time_kernel(Bench_context& ctx, cl_kernel kernel, size_t global, Bench_stats& stats)
+{
+  Bench_policy policy;
+  policy.max_runs = 20;
+  policy.budget = 0.1;
+  return bench_measure([&]() -> double
+  {
+    cl_event event;
+    if (!ctx.check(clEnqueueNDRangeKernel(ctx.queue(), kernel, 1, NULL, &global, NULL, 0, NULL, &event), "enqueue kernel"))
+      return -1.0;
+    auto t = event_seconds(event);
+    clReleaseEvent(event);
+    return t;
+  }, stats, policy);
+}
+
+/**
+ * sweep --
+ *
+ *      Runs every pattern for one element size and working set.
+ *
+ * Results:
+ *      the bandwidth of each pattern in GB/s, 0 where it was not measured.
+ */
+static vector<double> sweep(const string& tag, cl_device_id device, size_t element, const string& working_set,
+                            size_t bytes)
+{
+  vector<double> bandwidth(NUM_PATTERNS, 0.0);
+  auto size = elements[element].size;
+  /* A power of two of elements, so the wrap-around is a mask */
+  cl_uint shift = 0;
+  while ((size << (shift + 1)) <= bytes)
+    ++shift;
+  cl_ulong n = cl_ulong(1) << shift, mask = n - 1;
+
+  Bench_context ctx(tag, vector<cl_device_id>(1, device));
+  if (!ctx)
+    return bandwidth;
+  auto program = ctx.build(access_source, (string("-DT=") + elements[element].type).c_str());
+  if (!program)
+    return bandwidth;
+  vector<cl_uint> permutation(n);
+  for (cl_ulong ii = 0; ii < n; ++ii)
+    permutation[ii] = ii;
+  shuffle(permutation.begin(), permutation.end(), mt19937(42));
+  auto src = ctx.buffer(CL_MEM_READ_ONLY, n * size);
+  auto dst = ctx.buffer(CL_MEM_WRITE_ONLY, n * size);
+  auto index = ctx.buffer(CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, n * sizeof(cl_uint), permutation.data());
+  if (!src || !dst || !index)
+    return bandwidth;
+
+  for (int pattern = 0; pattern < NUM_PATTERNS; ++pattern)
+  {
+    auto kernel = ctx.kernel(program, pattern < GATHER ? "strided" : pattern_name(pattern).c_str());
+    if (!kernel)
+      return bandwidth;
+    if (!ctx.set_arg(kernel, 0, sizeof src, &src) || !ctx.set_arg(kernel, 1, sizeof dst, &dst))
+      return bandwidth;
+    if (pattern < GATHER)
+    {
+      cl_uint pow2 = 0;
+      cl_ulong odd = strides[pattern];
+      while (0 == odd % 2)
+      {
+        odd /= 2;
+        ++pow2;
+      }
+      if (pow2 > shift)
+        continue;
+      if (!ctx.set_arg(kernel, 2, sizeof pow2, &pow2) || !ctx.set_arg(kernel, 3, sizeof odd, &odd)
+          || !ctx.set_arg(kernel, 4, sizeof mask, &mask) || !ctx.set_arg(kernel, 5, sizeof shift, &shift))
+        return bandwidth;
+    }
+    else if (!ctx.set_arg(kernel, 2, sizeof index, &index))
+      return bandwidth;
+    cl_uint index_mask = mask;
+    if (RANDOM == pattern && !ctx.set_arg(kernel, 3, sizeof index_mask, &index_mask))
+      return bandwidth;
+    Bench_stats stats;
+    if (!time_kernel(ctx, kernel, n, stats))
+      continue;
+    stringstream metric;
+    metric << "access " << pattern_name(pattern) << " " << size << "B " << working_set;
+    bench_report(tag, device, metric.str(), stats, 2.0 * n * size * 1e-9, "GB/s");
+    if (stats.median > 0)
+      bandwidth[pattern] = 2.0 * n * size * 1e-9 / stats.median;
+  }
+  return bandwidth;
+}
+
+/**
+ * print_curve --
+ *
+ *      Prints the unit stride bandwidth per element size and every other
+ *      pattern as a percentage of it.
+ *
+ * Results:
+ *      void.
+ */
+static void print_curve(const string& tag, const string& working_set, const vector<vector<double>>& bandwidth)
+{
+  printf("%s: access coalescing curve, %s:\n", tag.c_str(), working_set.c_str());
+  printf("%s:   %-10s", tag.c_str(), "pattern");
+  for (auto& element : elements)
+    printf(" %7zuB", element.size);
+  printf("\n");
+  for (int pattern = 0; pattern < NUM_PATTERNS; ++pattern)
+  {
+    printf("%s:   %-10s", tag.c_str(), pattern_name(pattern).c_str());
+    for (size_t element = 0; element < NUM_ELEMENTS; ++element)
+    {
+      auto unit = bandwidth[element][0], bw = bandwidth[element][pattern];
+      if (0 == pattern)
+        printf(" %8.2f", unit);
+      else if (unit > 0 && bw > 0)
+        printf(" %7.0f%%", 100.0 * bw / unit);
+      else
+        printf(" %8s", "-");
+    }
+    printf("%s\n", 0 == pattern ? " GB/s" : "");
+  }
+}
+
+void bench_access(const string& tag, cl_device_id device)
+{
+  uint64_t cache = device_uint(device, CL_DEVICE_GLOBAL_MEM_CACHE_SIZE);
+  uint64_t limit = min<uint64_t>({ACCESS_MAX_BYTES, device_uint(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE),
+                                  device_uint(device, CL_DEVICE_GLOBAL_MEM_SIZE) / 8});
+  if (0 == cache)
+  {
+    cout << tag << ": access: no GLOBAL_MEM_CACHE_SIZE, assuming " << format_bytes(ACCESS_DEFAULT_CACHE) << endl;
+    cache = ACCESS_DEFAULT_CACHE;
+  }
+
+  struct {const char* name; uint64_t bytes;} working_sets[] = {
+    {"cache/2", cache / 2                  },
+    {"cache*8", cache * ACCESS_CACHE_FACTOR}};
+  vector<vector<double>> bandwidth;
+  for (auto& ws : working_sets)
+  {
+    auto bytes = min(ws.bytes, limit);
+    bandwidth.clear();
+    for (size_t element = 0; element < NUM_ELEMENTS; ++element)
+    {
+      /* The permutation takes four bytes per element */
+      auto element_bytes = min<uint64_t>(bytes, limit / sizeof(cl_uint) * elements[element].size);
+      bandwidth.push_back(sweep(tag, device, element, ws.name, element_bytes));
+    }
+    print_curve(tag, string(ws.name) + " = " + format_bytes(bytes), bandwidth);
+  }
+
+  /* What the uncached curve means for a layout with 4 byte fields */
+  auto unit = bandwidth[2][0], gather = bandwidth[2][GATHER];
+  if (unit > 0 && gather > 0)
+    printf("%s: access gathers of 4B elements beyond the cache keep %.0f%% of unit stride bandwidth: %s\n",
+           tag.c_str(), 100.0 * gather / unit,
+           gather < 0.5 * unit ? "prefer SoA layouts" : "gather kernels are affordable");
+}
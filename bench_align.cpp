@@ -0,0 +1,251 @@
+/**
+ * bench_align.cpp --
+ *
+ *      Measures what violating MEM_BASE_ADDR_ALIGN and
+ *      MIN_DATA_TYPE_ALIGN_SIZE costs.  For every power of two alignment
+ *      from 1 byte up to the larger of the base address alignment and
+ *      the page size it times
+ *
+ *      kernel      a copy kernel reading and writing 16 byte vectors at
+ *                  that offset into a buffer (vload16 of uchar, which
+ *                  only needs byte alignment),
+ *      sub-buffer  the same kernel on a sub-buffer created at that
+ *                  origin, where the driver accepts it,
+ *      write/read  transfers from and to a host pointer at that offset
+ *                  from a page boundary,
+ *      create      clCreateSubBuffer and clReleaseMemObject, or the error
+ *                  the driver rejects the origin with,
+ *
+ *      and reports the alignment below which each bandwidth collapses,
+ *      i.e. falls under ALIGN_COLLAPSE of the best aligned one.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include "bench.h"
+
+using namespace std;
+
+#define ALIGN_BYTES    (64 << 20)
+#define ALIGN_COLLAPSE 0.8
+
+static const char* align_source = R"CLC(
+__kernel void copy16(__global const uchar* src, __global uchar* dst, uint offset)
+{
+  size_t i = get_global_id(0);
+  vstore16(vload16(i, src + offset), i, dst + offset);
+}
+)CLC";
+
+enum Measure { KERNEL, SUB_BUFFER, WRITE, READ, NUM_MEASURES };
+
+static const char* measure_names[] = {"kernel", "sub-buffer", "write", "read"};
+
+/**
+ * time_command --
+ *
+ *      Times a command from its profiling event, briefly: the sweep runs
+ *      several per alignment.
+ *
+ * Results:
+ *      true and the statistics if it was measured.
+ */
+static bool time_command(Bench_context& ctx, const function<cl_int(cl_event*)>& enqueue, const char* what,
+                         Bench_stats& stats)
+{
+  Bench_policy policy;
+  policy.max_runs = 20;
+  policy.budget = 0.1;
+  return bench_measure([&]() -> double
+  {
+    cl_event event;
+    if (!ctx.check(enqueue(&event), what))
+      return -1.0;
+    auto t = event_seconds(event);
+    clReleaseEvent(event);
+    return t;
+  }, stats, policy);
+}
+
+/**
+ * time_create --
+ *
+ *      Times creating and releasing a sub-buffer at the given origin.
+ *
+ * Results:
+ *      CL_SUCCESS and the statistics, or the error of clCreateSubBuffer.
+ */
+static cl_int time_create(cl_mem parent, size_t origin, size_t size, Bench_stats& stats)
+{
+  cl_buffer_region region = {origin, size};
+  cl_int err = CL_SUCCESS;
+  Bench_policy policy;
+  policy.max_runs = 50;
+  policy.budget = 0.1;
+  bench_measure([&]() -> double
+  {
+    auto start = host_seconds();
+    auto sub = clCreateSubBuffer(parent, CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+    if (CL_SUCCESS != err)
+      return -1.0;
+    clReleaseMemObject(sub);
+    return host_seconds() - start;
+  }, stats, policy);
+  return err;
+}
+
+/**
+ * collapse --
+ *
+ *      The smallest alignment from which on every larger one was
+ *      measured and keeps ALIGN_COLLAPSE of the best bandwidth.
+ *
+ * Results:
+ *      the alignment, 0 if nothing was measured.
+ */
+static size_t collapse(const vector<size_t>& alignments, const vector<double>& bandwidth)
+{
+  auto best = *max_element(bandwidth.begin(), bandwidth.end());
+  size_t threshold = 0;
+  for (size_t ii = alignments.size(); best > 0 && ii-- > 0; )
+  {
+    if (bandwidth[ii] <= 0 || bandwidth[ii] < ALIGN_COLLAPSE * best)
+      break;
+    threshold = alignments[ii];
+  }
+  return threshold;
+}
+
+void bench_align(const string& tag, cl_device_id device)
+{
+  size_t base_align = device_uint(device, CL_DEVICE_MEM_BASE_ADDR_ALIGN) / 8; /* reported in bits */
+  size_t data_align = device_uint(device, CL_DEVICE_MIN_DATA_TYPE_ALIGN_SIZE);
+  size_t page = sysconf(_SC_PAGESIZE);
+  vector<size_t> alignments;
+  for (size_t a = 1; a <= max(base_align, page); a *= 2)
+    alignments.push_back(a);
+  auto largest = alignments.back();
+  size_t bytes = min<uint64_t>({ALIGN_BYTES, device_uint(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE),
+                                device_uint(device, CL_DEVICE_GLOBAL_MEM_SIZE) / 8});
+  /* Room to shift every view by up to the largest alignment */
+  if (bytes < largest + 16)
+  {
+    cout << tag << ": align needs " << format_bytes(largest + 16) << " buffers" << endl;
+    return;
+  }
+  size_t size = (bytes - largest) / 16 * 16, items = size / 16;
+  printf("%s: align MEM_BASE_ADDR_ALIGN %zu B, MIN_DATA_TYPE_ALIGN_SIZE %zu B, page %zu B, %s per copy\n",
+         tag.c_str(), base_align, data_align, page, format_bytes(size).c_str());
+
+  Bench_context ctx(tag, vector<cl_device_id>(1, device));
+  if (!ctx)
+    return;
+  auto program = ctx.build(align_source);
+  auto kernel = program ? ctx.kernel(program, "copy16") : nullptr;
+  auto src = ctx.buffer(CL_MEM_READ_WRITE, bytes);
+  auto dst = ctx.buffer(CL_MEM_READ_WRITE, bytes);
+  if (!kernel || !src || !dst)
+    return;
+  void* host;
+  if (0 != posix_memalign(&host, page, bytes + page))
+  {
+    cerr << tag << ": Unable to allocate host memory!" << endl;
+    return;
+  }
+  memset(host, 0, bytes + page);
+
+  vector<vector<double>> bandwidth(NUM_MEASURES, vector<double>(alignments.size(), 0.0));
+  vector<cl_int> create_status(alignments.size());
+  vector<double> create_seconds(alignments.size(), 0.0);
+  for (size_t ii = 0; ii < alignments.size(); ++ii)
+  {
+    /* Offset by exactly a: the largest alignment is reached at offset 0 */
+    auto a = alignments[ii];
+    auto offset = a == largest ? 0 : a;
+    auto host_ptr = static_cast<char*>(host) + (a == largest ? 0 : a);
+    auto report = [&](Measure measure, const Bench_stats& stats)
+    {
+      /* The kernels read and write every byte */
+      auto work = size * (KERNEL == measure || SUB_BUFFER == measure ? 2.0 : 1.0) * 1e-9;
+      bench_report(tag, device, string("align ") + measure_names[measure] + " " + to_string(a) + "B", stats,
+                   work, "GB/s");
+      if (stats.median > 0)
+        bandwidth[measure][ii] = work / stats.median;
+    };
+    auto set_args = [&](cl_mem in, cl_mem out, cl_uint kernel_offset)
+    {
+      return ctx.set_arg(kernel, 0, sizeof in, &in) && ctx.set_arg(kernel, 1, sizeof out, &out)
+             && ctx.set_arg(kernel, 2, sizeof kernel_offset, &kernel_offset);
+    };
+    auto run_kernel = [&](cl_event* event)
+    {
+      return clEnqueueNDRangeKernel(ctx.queue(), kernel, 1, NULL, &items, NULL, 0, NULL, event);
+    };
+
+    Bench_stats stats;
+    if (set_args(src, dst, offset) && time_command(ctx, run_kernel, "enqueue kernel", stats))
+      report(KERNEL, stats);
+
+    create_status[ii] = time_create(src, offset, size, stats);
+    if (CL_SUCCESS == create_status[ii])
+    {
+      bench_report(tag, device, "align create " + to_string(a) + "B", stats);
+      create_seconds[ii] = stats.median;
+      cl_buffer_region region = {offset, size};
+      cl_int err, err2;
+      auto sub_src = clCreateSubBuffer(src, CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+      auto sub_dst = clCreateSubBuffer(dst, CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region, &err2);
+      if (ctx.check(err, "create sub-buffer") && ctx.check(err2, "create sub-buffer")
+          && set_args(sub_src, sub_dst, 0) && time_command(ctx, run_kernel, "enqueue kernel", stats))
+        report(SUB_BUFFER, stats);
+      if (sub_src)
+        clReleaseMemObject(sub_src);
+      if (sub_dst)
+        clReleaseMemObject(sub_dst);
+    }
+
+    if (time_command(ctx, [&](cl_event* event)
+        { return clEnqueueWriteBuffer(ctx.queue(), src, CL_TRUE, 0, size, host_ptr, 0, NULL, event); },
+        "write buffer", stats))
+      report(WRITE, stats);
+    if (time_command(ctx, [&](cl_event* event)
+        { return clEnqueueReadBuffer(ctx.queue(), src, CL_TRUE, 0, size, host_ptr, 0, NULL, event); },
+        "read buffer", stats))
+      report(READ, stats);
+  }
+  free(host);
+
+  printf("%s: align %8s %11s %11s %11s %11s  %s\n", tag.c_str(), "offset", "kernel", "sub-buffer", "write",
+         "read", "clCreateSubBuffer");
+  for (size_t ii = 0; ii < alignments.size(); ++ii)
+  {
+    printf("%s: align %7zuB", tag.c_str(), alignments[ii]);
+    for (int measure = 0; measure < NUM_MEASURES; ++measure)
+    {
+      if (bandwidth[measure][ii] > 0)
+        printf(" %6.2f GB/s", bandwidth[measure][ii]);
+      else
+        printf(" %11s", "-");
+    }
+    if (CL_SUCCESS == create_status[ii])
+      printf("  %s\n", format_seconds(create_seconds[ii]).c_str());
+    else
+      printf("  %s\n", cl_error_str(create_status[ii]));
+  }
+  size_t accepted = 0;
+  for (size_t ii = alignments.size(); ii-- > 0 && CL_SUCCESS == create_status[ii]; )
+    accepted = alignments[ii];
+  if (accepted > 1)
+    printf("%s: align clCreateSubBuffer rejects origins below %zu B\n", tag.c_str(), accepted);
+  for (int measure = 0; measure < NUM_MEASURES; ++measure)
+  {
+    auto threshold = collapse(alignments, bandwidth[measure]);
+    if (threshold > (SUB_BUFFER == measure ? max<size_t>(accepted, 1) : 1))
+      printf("%s: align %s bandwidth collapses below %zu B alignment\n", tag.c_str(), measure_names[measure], threshold);
+    else if (threshold)
+      printf("%s: align %s bandwidth does not depend on alignment\n", tag.c_str(), measure_names[measure]);
+  }
+}
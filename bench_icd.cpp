@@ -0,0 +1,80 @@
+/**
+ * bench_icd.cpp --
+ *
+ *      What loading only the relevant vendor libraries saves.  Each run
+ *      forks a child that has not touched OpenCL yet and times it until
+ *      it has the platforms, once through the ICD loader, which loads
+ *      every installed vendor library, and once with icd_open() on the
+ *      selected ones.
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench.h"
+#include "icd.h"
+
+using namespace std;
+
+/**
+ * child_seconds --
+ *
+ *      Runs discover() in a fresh child process.
+ *
+ * Results:
+ *      the seconds from fork to exit, negative if the child failed.
+ */
+static double child_seconds(bool (*discover)(const vector<string>&), const vector<string>& libraries)
+{
+  auto start = host_seconds();
+  auto pid = fork();
+  if (pid < 0)
+    return -1;
+  if (0 == pid)
+    _exit(discover(libraries) ? 0 : 1);
+  int status;
+  while (waitpid(pid, &status, 0) < 0)
+    if (EINTR != errno)
+      return -1;
+  if (!WIFEXITED(status) || 0 != WEXITSTATUS(status))
+    return -1;
+  return host_seconds() - start;
+}
+
+static bool discover_loader(const vector<string>&)
+{
+  cl_uint num_platforms;
+  return CL_SUCCESS == clGetPlatformIDs(0, nullptr, &num_platforms);
+}
+
+static bool discover_direct(const vector<string>& libraries)
+{
+  cl_uint num_platforms;
+  return icd_open(libraries) && CL_SUCCESS == icd_get_platform_ids(0, nullptr, &num_platforms);
+}
+
+int bench_icd(const vector<string>& libraries)
+{
+  static const struct { bool (*discover)(const vector<string>&); const char* metric; } paths[] = {
+    { discover_loader, "platforms through the loader" },
+    { discover_direct, "platforms from --icd only" },
+  };
+  Bench_stats stats[2];
+  for (int ii = 0; ii < 2; ++ii)
+  {
+    if (!bench_measure([&] { return child_seconds(paths[ii].discover, libraries); }, stats[ii]))
+    {
+      cerr << "startup: Unable to get the " << paths[ii].metric << "!" << endl;
+      return EXIT_FAILURE;
+    }
+    bench_report("startup", nullptr, paths[ii].metric, stats[ii]);
+  }
+  auto saved = stats[0].median - stats[1].median;
+  printf("startup: loading only %zu ICD%s saves %s per start (%.1fx faster)\n", libraries.size(),
+         1 == libraries.size() ? "" : "s",
+         format_seconds(saved > 0 ? saved : 0).c_str(),
+         stats[1].median > 0 ? stats[0].median / stats[1].median : 0.0);
+  return EXIT_SUCCESS;
+}
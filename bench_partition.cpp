@@ -0,0 +1,246 @@
+/**
+ * bench_partition.cpp --
+ *
+ *      Compares aggregate memory bandwidth and compute throughput of a
+ *      device against its sub-devices, partitioned by NUMA node and into
+ *      equally sized parts.  The work is split across the sub-devices in
+ *      proportion to their compute units and timed on the host, so each
+ *      configuration is charged for the same total amount of work.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "icd.h"
+
+using namespace std;
+
+#ifdef CL_VERSION_1_2
+
+#define FLOPS_ITERATIONS 256
+#define ITEMS_PER_UNIT   (1 << 18)
+#define TRIAD_BYTES      (64 << 20)
+
+static const char* partition_source = R"CLC(
+__kernel void triad(__global const float4* a, __global const float4* b,
+                    __global float4* c, float s)
+{
+  size_t i = get_global_id(0);
+  c[i] = a[i] + s * b[i];
+}
+
+__kernel void flops(__global float* out, float a, float b)
+{
+  float x = (float) get_global_id(0), y = x + 1.0f, z = x + 2.0f, w = x + 3.0f;
+  for (int i = 0; i < FLOPS_ITERATIONS; ++i)
+  {
+    x = mad(x, a, b); y = mad(y, a, b); z = mad(z, a, b); w = mad(w, a, b);
+  }
+  out[get_global_id(0)] = x + y + z + w;
+}
+)CLC";
+
+struct Throughput {
+  double bandwidth; /* bytes per second */
+  double flops;     /* floating point operations per second */
+};
+
+/**
+ * measure --
+ *
+ *      Runs the triad and flops kernels concurrently on all devices,
+ *      one queue each, and reports both against the partitioned device.
+ *
+ * Results:
+ *      true and the median throughput if it was measured.
+ */
+static bool measure(const string& tag, cl_device_id parent, const vector<cl_device_id>& devices,
+                    const char* scheme, size_t elements, Throughput& result)
+{
+  Bench_context ctx(tag, devices);
+  if (!ctx)
+    return false;
+  auto options = "-DFLOPS_ITERATIONS=" + to_string(FLOPS_ITERATIONS);
+  auto program = ctx.build(partition_source, options.c_str());
+  if (nullptr == program)
+    return false;
+
+  vector<uint64_t> units;
+  uint64_t total_units = 0;
+  for (auto device : devices)
+  {
+    units.push_back(max<uint64_t>(1, device_uint(device, CL_DEVICE_MAX_COMPUTE_UNITS)));
+    total_units += units.back();
+  }
+
+  struct Slice { cl_kernel triad, flops; size_t elements, items; };
+  vector<Slice> slices;
+  size_t total_elements = 0, total_items = 0;
+  for (size_t ii = 0; ii < ctx.size(); ++ii)
+  {
+    Slice s;
+    s.elements = max<size_t>(1, elements * units[ii] / total_units);
+    s.items = ITEMS_PER_UNIT * units[ii];
+    s.triad = ctx.kernel(program, "triad");
+    s.flops = ctx.kernel(program, "flops");
+    auto a = ctx.buffer(CL_MEM_READ_ONLY, s.elements * sizeof(cl_float4));
+    auto b = ctx.buffer(CL_MEM_READ_ONLY, s.elements * sizeof(cl_float4));
+    auto c = ctx.buffer(CL_MEM_WRITE_ONLY, s.elements * sizeof(cl_float4));
+    auto out = ctx.buffer(CL_MEM_WRITE_ONLY, s.items * sizeof(cl_float));
+    if (!s.triad || !s.flops || !a || !b || !c || !out)
+      return false;
+    /* Uninitialized inputs may hold denormals, which are slow on CPUs */
+    cl_float one = 1.0f, scale = 3.0f, ma = 0.999f, mb = 0.001f;
+    if (!ctx.check(clEnqueueFillBuffer(ctx.queue(ii), a, &one, sizeof one, 0, s.elements * sizeof(cl_float4), 0, NULL, NULL), "fill buffer")
+        || !ctx.check(clEnqueueFillBuffer(ctx.queue(ii), b, &one, sizeof one, 0, s.elements * sizeof(cl_float4), 0, NULL, NULL), "fill buffer"))
+      return false;
+    if (!ctx.set_arg(s.triad, 0, sizeof a, &a) || !ctx.set_arg(s.triad, 1, sizeof b, &b)
+        || !ctx.set_arg(s.triad, 2, sizeof c, &c) || !ctx.set_arg(s.triad, 3, sizeof scale, &scale)
+        || !ctx.set_arg(s.flops, 0, sizeof out, &out) || !ctx.set_arg(s.flops, 1, sizeof ma, &ma)
+        || !ctx.set_arg(s.flops, 2, sizeof mb, &mb))
+      return false;
+    total_elements += s.elements;
+    total_items += s.items;
+    slices.push_back(s);
+  }
+  if (!ctx.finish())
+    return false;
+
+  auto run = [&](bool compute) -> double
+  {
+    auto start = host_seconds();
+    for (size_t ii = 0; ii < slices.size(); ++ii)
+    {
+      auto kernel = compute ? slices[ii].flops : slices[ii].triad;
+      auto global = compute ? slices[ii].items : slices[ii].elements;
+      if (!ctx.enqueue(ii, kernel, 1, &global)
+          || !ctx.check(clFlush(ctx.queue(ii)), "flush command queue"))
+        return -1.0;
+    }
+    return ctx.finish() ? host_seconds() - start : -1.0;
+  };
+
+  Bench_stats triad, flops;
+  if (!bench_measure([&] { return run(false); }, triad)
+      || !bench_measure([&] { return run(true); }, flops))
+    return false;
+  auto bytes = 3.0 * sizeof(cl_float4) * total_elements;
+  auto operations = 8.0 * FLOPS_ITERATIONS * total_items;
+  bench_report(tag, parent, string("partition ") + scheme + " triad", triad, bytes * 1e-9, "GB/s");
+  bench_report(tag, parent, string("partition ") + scheme + " flops", flops, operations * 1e-9, "GFLOP/s");
+  result.bandwidth = bytes / triad.median;
+  result.flops = operations / flops.median;
+  return true;
+}
+
+static void report(const string& tag, const char* scheme, size_t count, uint64_t units,
+                   const Throughput& t, const Throughput& base)
+{
+  printf("%s: %-13s %3zu x %-4lu CUs: %9.2f GB/s (%5.2fx), %10.2f GFLOP/s (%5.2fx)\n",
+         tag.c_str(), scheme, count, (unsigned long) units,
+         t.bandwidth * 1e-9, t.bandwidth / base.bandwidth, t.flops * 1e-9, t.flops / base.flops);
+}
+
+/**
+ * partition --
+ *
+ *      Creates sub-devices with the given properties, measures them and
+ *      releases them again.
+ *
+ * Results:
+ *      true and the throughput if the partition could be measured.
+ */
+static bool partition(const string& tag, cl_device_id device, const cl_device_partition_property* props,
+                      const char* scheme, size_t elements, const Throughput& base, Throughput& result)
+{
+  cl_uint num_devices;
+  auto err = clCreateSubDevices(device, props, 0, NULL, &num_devices);
+  if (CL_SUCCESS != err)
+  {
+    cerr << tag << ": Unable to partition " << scheme << ": " << cl_error_str(err) << "!" << endl;
+    return false;
+  }
+  vector<cl_device_id> sub_devices(num_devices);
+  err = clCreateSubDevices(device, props, num_devices, sub_devices.data(), NULL);
+  if (CL_SUCCESS != err)
+  {
+    cerr << tag << ": Unable to partition " << scheme << ": " << cl_error_str(err) << "!" << endl;
+    return false;
+  }
+  auto ok = measure(tag, device, sub_devices, scheme, elements, result);
+  if (ok)
+    report(tag, scheme, sub_devices.size(), device_uint(sub_devices[0], CL_DEVICE_MAX_COMPUTE_UNITS), result, base);
+  for (auto sub_device : sub_devices)
+    clReleaseDevice(sub_device);
+  return ok;
+}
+
+void bench_partition(const string& tag, cl_device_id device)
+{
+  cl_device_partition_property props[16];
+  size_t size;
+  auto err = icd_get_device_info(device, CL_DEVICE_PARTITION_PROPERTIES, sizeof props, props, &size);
+  if (CL_SUCCESS != err)
+  {
+    cerr << tag << ": Unable to get PARTITION_PROPERTIES: " << cl_error_str(err) << "!" << endl;
+    return;
+  }
+  auto num_props = min(size / sizeof props[0], sizeof props / sizeof props[0]);
+  auto equally = find(props, props + num_props, CL_DEVICE_PARTITION_EQUALLY) != props + num_props;
+  auto by_domain = find(props, props + num_props, CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN) != props + num_props;
+  if (!equally && !by_domain)
+  {
+    cout << tag << ": partitioning not supported" << endl;
+    return;
+  }
+
+  auto units = device_uint(device, CL_DEVICE_MAX_COMPUTE_UNITS);
+  auto max_sub_devices = device_uint(device, CL_DEVICE_PARTITION_MAX_SUB_DEVICES);
+  auto domains = device_uint(device, CL_DEVICE_PARTITION_AFFINITY_DOMAIN);
+  size_t bytes = min<uint64_t>({TRIAD_BYTES,
+                                device_uint(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE),
+                                device_uint(device, CL_DEVICE_GLOBAL_MEM_SIZE) / 8});
+  size_t elements = bytes / sizeof(cl_float4);
+
+  Throughput base, best, t;
+  if (!measure(tag, device, vector<cl_device_id>(1, device), "unpartitioned", elements, base))
+    return;
+  report(tag, "unpartitioned", 1, units, base, base);
+  best = base;
+  string best_scheme = "unpartitioned";
+
+  if (by_domain && (domains & CL_DEVICE_AFFINITY_DOMAIN_NUMA))
+  {
+    cl_device_partition_property numa[] = {
+      CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_AFFINITY_DOMAIN_NUMA, 0};
+    if (partition(tag, device, numa, "NUMA", elements, base, t) && t.bandwidth > best.bandwidth)
+    {
+      best = t;
+      best_scheme = "NUMA";
+    }
+  }
+  for (uint64_t count = 2; equally && count <= max_sub_devices && count <= units; count *= 2)
+  {
+    /* Otherwise units / count per sub-device makes more than count of them. */
+    if (units % count)
+      continue;
+    cl_device_partition_property equal[] = {
+      CL_DEVICE_PARTITION_EQUALLY, (cl_device_partition_property) (units / count), 0};
+    string scheme = "equally/" + to_string(count);
+    if (partition(tag, device, equal, scheme.c_str(), elements, base, t) && t.bandwidth > best.bandwidth)
+    {
+      best = t;
+      best_scheme = scheme;
+    }
+  }
+  cout << tag << ": best aggregate bandwidth: " << best_scheme << endl;
+}
+
+#else
+
+void bench_partition(const string& tag, cl_device_id)
+{
+  cout << tag << ": partitioning requires OpenCL 1.2" << endl;
+}
+
+#endif
@@ -0,0 +1,269 @@
+/**
+ * bench_rect.cpp --
+ *
+ *      Compares the rectangular buffer transfers with the ways around
+ *      them, over tiles of several widths, heights and depths.  Each tile
+ *      runs with tight pitches, with the row and the slice pitch padded
+ *      separately and together, and with a row pitch that is not a power
+ *      of two (slice padding only on tiles deeper than one slice):
+ *
+ *      copy   clEnqueueCopyBufferRect, a naive copy kernel with one
+ *             work-item per byte, and one clEnqueueCopyBuffer per row.
+ *      write  clEnqueueWriteBufferRect and one clEnqueueWriteBuffer per row.
+ *      read   clEnqueueReadBufferRect and one clEnqueueReadBuffer per row.
+ *
+ *      Every method is timed on the host from the first enqueue to the
+ *      end of clFinish, so the per-command overhead the row by row
+ *      methods pay is part of their time.  The bandwidth counts the
+ *      bytes of the tile, not of the padding.  Each direction ends with
+ *      the tile size from which on the rect call is the fastest method,
+ *      or within RECT_TIE of it.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include "bench.h"
+
+using namespace std;
+
+#define RECT_PADDING 2    /* padded pitches are this many times the tight ones */
+#define RECT_ODD_PAD 24   /* bytes added to the row pitch of the odd layout */
+#define RECT_TIE     0.05 /* the rect call still wins this close to the fastest */
+
+static const char* rect_source = R"CLC(
+__kernel void copy_rect(__global const uchar* src, __global uchar* dst, ulong row_pitch, ulong slice_pitch)
+{
+  size_t i = get_global_id(2) * slice_pitch + get_global_id(1) * row_pitch + get_global_id(0);
+  dst[i] = src[i];
+}
+)CLC";
+
+static const size_t widths[] = {64, 256, 1024, 4096};
+static const size_t heights[] = {4, 64, 512};
+static const size_t depths[] = {1, 4};
+
+/* Row and slice pitch layouts: padding factors, and bytes added to the row */
+static struct {const char* name; size_t row, slice, row_add;} pitches[] = {
+  {"",           1,            1,            0           },
+  {"row x2",     RECT_PADDING, 1,            0           },
+  {"slice x2",   1,            RECT_PADDING, 0           },
+  {"both x2",    RECT_PADDING, RECT_PADDING, 0           },
+  {"row +24",    1,            1,            RECT_ODD_PAD}};
+
+enum Direction { COPY, WRITE, READ, NUM_DIRECTIONS };
+enum Method { RECT, KERNEL, ROWS, NUM_METHODS };
+
+static const char* direction_names[] = {"copy", "write", "read"};
+static const char* method_names[] = {"rect", "kernel", "rows"};
+
+namespace {
+
+struct Tile {
+  size_t region[3];
+  size_t row_pitch, slice_pitch;
+  const char* pitch;
+  double bandwidth[NUM_DIRECTIONS][NUM_METHODS]; /* GB/s, 0 if not measured */
+
+  size_t bytes() const { return region[0] * region[1] * region[2]; }
+  string name() const
+  {
+    stringstream ss;
+    ss << region[0] << "x" << region[1] << "x" << region[2] << (*pitch ? " " : "") << pitch;
+    return ss.str();
+  }
+};
+
+}
+
+/**
+ * time_host --
+ *
+ *      Times enqueueing the commands and waiting for them, briefly: the
+ *      sweep runs several hundred of these per device.
+ *
+ * Results:
+ *      true and the statistics if it was measured.
+ */
+static bool time_host(Bench_context& ctx, const function<bool()>& enqueue, Bench_stats& stats)
+{
+  Bench_policy policy;
+  policy.max_runs = 10;
+  policy.budget = 0.05;
+  return bench_measure([&]() -> double
+  {
+    auto start = host_seconds();
+    if (!enqueue() || !ctx.finish())
+      return -1.0;
+    return host_seconds() - start;
+  }, stats, policy);
+}
+
+/**
+ * enqueue_rows --
+ *
+ *      Enqueues one command per row of the tile.
+ *
+ * Results:
+ *      false after the first error.
+ */
+static bool enqueue_rows(const Tile& tile, const function<cl_int(size_t offset)>& enqueue_row)
+{
+  for (size_t z = 0; z < tile.region[2]; ++z)
+    for (size_t y = 0; y < tile.region[1]; ++y)
+      if (CL_SUCCESS != enqueue_row(z * tile.slice_pitch + y * tile.row_pitch))
+        return false;
+  return true;
+}
+
+/**
+ * measure_tile --
+ *
+ *      Times every direction and method on one tile.
+ *
+ * Results:
+ *      void, the bandwidths are in the tile.
+ */
+static void measure_tile(Bench_context& ctx, cl_kernel kernel, cl_mem src, cl_mem dst, char* host, Tile& tile)
+{
+  auto queue = ctx.queue();
+  size_t origin[3] = {0, 0, 0};
+  auto rp = tile.row_pitch, sp = tile.slice_pitch, width = tile.region[0];
+  cl_ulong row_pitch = rp, slice_pitch = sp;
+  for (auto& bandwidth : tile.bandwidth)
+    fill(bandwidth, bandwidth + NUM_METHODS, 0.0);
+  if (!ctx.set_arg(kernel, 0, sizeof src, &src) || !ctx.set_arg(kernel, 1, sizeof dst, &dst)
+      || !ctx.set_arg(kernel, 2, sizeof row_pitch, &row_pitch)
+      || !ctx.set_arg(kernel, 3, sizeof slice_pitch, &slice_pitch))
+    return;
+
+  function<bool()> methods[NUM_DIRECTIONS][NUM_METHODS] = {
+    {
+      [&] { return ctx.check(clEnqueueCopyBufferRect(queue, src, dst, origin, origin, tile.region, rp, sp, rp, sp,
+                                                     0, NULL, NULL), "copy buffer rect"); },
+      [&] { return ctx.enqueue(0, kernel, 3, tile.region); },
+      [&] { return enqueue_rows(tile, [&](size_t offset)
+            { return clEnqueueCopyBuffer(queue, src, dst, offset, offset, width, 0, NULL, NULL); }); }
+    },
+    {
+      [&] { return ctx.check(clEnqueueWriteBufferRect(queue, dst, CL_FALSE, origin, origin, tile.region, rp, sp, rp, sp,
+                                                      host, 0, NULL, NULL), "write buffer rect"); },
+      nullptr,
+      [&] { return enqueue_rows(tile, [&](size_t offset)
+            { return clEnqueueWriteBuffer(queue, dst, CL_FALSE, offset, width, host + offset, 0, NULL, NULL); }); }
+    },
+    {
+      [&] { return ctx.check(clEnqueueReadBufferRect(queue, src, CL_FALSE, origin, origin, tile.region, rp, sp, rp, sp,
+                                                     host, 0, NULL, NULL), "read buffer rect"); },
+      nullptr,
+      [&] { return enqueue_rows(tile, [&](size_t offset)
+            { return clEnqueueReadBuffer(queue, src, CL_FALSE, offset, width, host + offset, 0, NULL, NULL); }); }
+    }};
+
+  for (int direction = 0; direction < NUM_DIRECTIONS; ++direction)
+    for (int method = 0; method < NUM_METHODS; ++method)
+    {
+      Bench_stats stats;
+      if (!methods[direction][method] || !time_host(ctx, methods[direction][method], stats))
+        continue;
+      bench_report(ctx.name(), ctx.device(), string("rect ") + direction_names[direction] + " " + method_names[method]
+                   + " " + tile.name(), stats, tile.bytes() * 1e-9, "GB/s");
+      if (stats.median > 0)
+        tile.bandwidth[direction][method] = tile.bytes() * 1e-9 / stats.median;
+    }
+}
+
+/**
+ * print_direction --
+ *
+ *      Prints every tile of one direction with the fastest method, and
+ *      the tile size from which on the rect call always wins.
+ *
+ * Results:
+ *      void.
+ */
+static void print_direction(const string& tag, int direction, vector<Tile> tiles)
+{
+  auto name = direction_names[direction];
+  printf("%s: rect %-5s %-20s", tag.c_str(), name, "tile");
+  for (int method = 0; method < NUM_METHODS; ++method)
+    if (COPY == direction || KERNEL != method)
+      printf(" %11s", method_names[method]);
+  printf("  fastest\n");
+
+  stable_sort(tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b) { return a.bytes() < b.bytes(); });
+  vector<bool> wins;
+  for (auto& tile : tiles)
+  {
+    auto& bandwidth = tile.bandwidth[direction];
+    printf("%s: rect %-5s %-20s", tag.c_str(), name, tile.name().c_str());
+    for (int method = 0; method < NUM_METHODS; ++method)
+    {
+      if (COPY != direction && KERNEL == method)
+        continue;
+      if (bandwidth[method] > 0)
+        printf(" %6.2f GB/s", bandwidth[method]);
+      else
+        printf(" %11s", "-");
+    }
+    auto best = max_element(bandwidth, bandwidth + NUM_METHODS) - bandwidth;
+    printf("  %s\n", bandwidth[best] > 0 ? method_names[best] : "-");
+    wins.push_back(bandwidth[RECT] > 0 && bandwidth[RECT] >= (1.0 - RECT_TIE) * bandwidth[best]);
+  }
+
+  /* The smallest tile from which on the rect call wins every larger one */
+  auto from = tiles.size();
+  while (from > 0 && wins[from - 1])
+    --from;
+  if (from == tiles.size())
+    printf("%s: rect %s is slower than the alternatives on the largest tile\n", tag.c_str(), name);
+  else if (0 == from)
+    printf("%s: rect %s is as fast as the alternatives on every tile\n", tag.c_str(), name);
+  else
+    printf("%s: rect %s is as fast as the alternatives from %s tiles on\n", tag.c_str(), name,
+           format_bytes(tiles[from].bytes()).c_str());
+}
+
+void bench_rect(const string& tag, cl_device_id device)
+{
+  vector<Tile> tiles;
+  size_t bytes = 0;
+  for (auto width : widths)
+    for (auto height : heights)
+      for (auto depth : depths)
+        for (auto& pitch : pitches)
+        {
+          /* A single slice has no slice pitch to pad */
+          if (1 == depth && pitch.slice > 1)
+            continue;
+          Tile tile;
+          tile.region[0] = width;
+          tile.region[1] = height;
+          tile.region[2] = depth;
+          tile.pitch = pitch.name;
+          tile.row_pitch = width * pitch.row + pitch.row_add;
+          tile.slice_pitch = tile.row_pitch * height * pitch.slice;
+          tiles.push_back(tile);
+          bytes = max(bytes, tile.slice_pitch * depth);
+        }
+  if (bytes > device_uint(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE))
+  {
+    cout << tag << ": rect needs " << format_bytes(bytes) << " buffers" << endl;
+    return;
+  }
+
+  Bench_context ctx(tag, vector<cl_device_id>(1, device));
+  if (!ctx)
+    return;
+  auto program = ctx.build(rect_source);
+  auto kernel = program ? ctx.kernel(program, "copy_rect") : nullptr;
+  auto src = ctx.buffer(CL_MEM_READ_WRITE, bytes);
+  auto dst = ctx.buffer(CL_MEM_READ_WRITE, bytes);
+  if (!kernel || !src || !dst)
+    return;
+  vector<char> host(bytes);
+  for (auto& tile : tiles)
+    measure_tile(ctx, kernel, src, dst, host.data(), tile);
+  for (int direction = 0; direction < NUM_DIRECTIONS; ++direction)
+    print_direction(tag, direction, tiles);
+}
@@ -0,0 +1,367 @@
+/**
+ * bench_svm.cpp --
+ *
+ *      Compares shared virtual memory with classic buffers on two
+ *      pointer-heavy workloads:
+ *
+ *      linked-list  the host rewrites the payload of many linked lists
+ *                   and the device walks them; buffers have to use
+ *                   indices instead of pointers and copy the nodes over.
+ *      ping-pong    a single counter bounces between host and device.
+ *
+ *      Each workload runs with a classic buffer and with every SVM flavour
+ *      the device supports: coarse-grain buffers (map/unmap around host
+ *      access), fine-grain buffers and fine-grain system allocations
+ *      (direct host access).
+ */
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include "bench.h"
+#include "icd.h"
+
+using namespace std;
+
+#ifdef CL_VERSION_2_0
+
+#define LIST_NODES  (1 << 20)
+#define LIST_CHAINS 1024
+#define PING_ROUNDS 200
+
+static const char* svm_source = R"CLC(
+typedef struct node { __global struct node* next; int value; } node_t;
+typedef struct inode { int next; int value; } inode_t;
+
+__kernel void chase_pointer(__global node_t* nodes, __global int* out)
+{
+  __global node_t* p = nodes + get_global_id(0);
+  int sum = 0;
+  while (p)
+  {
+    sum += p->value;
+    p = p->next;
+  }
+  out[get_global_id(0)] = sum;
+}
+
+__kernel void chase_index(__global const inode_t* nodes, __global int* out)
+{
+  int i = get_global_id(0);
+  int sum = 0;
+  while (i >= 0)
+  {
+    sum += nodes[i].value;
+    i = nodes[i].next;
+  }
+  out[get_global_id(0)] = sum;
+}
+
+__kernel void bump(__global int* counter)
+{
+  counter[0] += 1;
+}
+)CLC";
+
+enum Variant { BUFFER, COARSE_GRAIN, FINE_GRAIN_BUFFER, FINE_GRAIN_SYSTEM, NUM_VARIANTS };
+
+static const char* variant_names[] = {"buffer", "coarse-grain", "fine-grain", "fine-system"};
+
+struct Svm_node { Svm_node* next; cl_int value; };
+struct Index_node { cl_int next; cl_int value; };
+
+/**
+ * make_chains --
+ *
+ *      Links LIST_NODES nodes into LIST_CHAINS lists headed by the first
+ *      LIST_CHAINS nodes, visiting the rest in random order so the walk
+ *      defeats caches and prefetchers.
+ *
+ * Results:
+ *      the index of the successor of every node, -1 at the end of a list.
+ */
+static vector<cl_int> make_chains()
+{
+  vector<cl_int> order(LIST_NODES - LIST_CHAINS);
+  for (size_t ii = 0; ii < order.size(); ++ii)
+    order[ii] = LIST_CHAINS + ii;
+  shuffle(order.begin(), order.end(), mt19937(42));
+  vector<cl_int> next(LIST_NODES, -1);
+  size_t per_chain = order.size() / LIST_CHAINS;
+  for (size_t chain = 0; chain < LIST_CHAINS; ++chain)
+  {
+    cl_int prev = chain;
+    for (size_t ii = chain * per_chain; ii < (chain + 1) * per_chain; ++ii)
+      prev = next[prev] = order[ii];
+  }
+  return next;
+}
+
+static_assert(LIST_NODES % LIST_CHAINS == 0, "every node must be on a list");
+
+static bool verify(const Bench_context& ctx, const cl_int* out, cl_int iteration)
+{
+  int64_t sum = 0;
+  for (size_t ii = 0; ii < LIST_CHAINS; ++ii)
+    sum += out[ii];
+  if (sum == (int64_t) iteration * LIST_NODES)
+    return true;
+  cerr << ctx.name() << ": linked-list checksum mismatch!" << endl;
+  return false;
+}
+
+/**
+ * linked_list --
+ *
+ *      Times rounds of host update followed by the device walk.
+ *
+ * Results:
+ *      true and the time per round if it was measured.
+ */
+static bool linked_list(Bench_context& ctx, cl_program program, Variant variant, const vector<cl_int>& next,
+                        Bench_stats& stats)
+{
+  auto queue = ctx.queue();
+  size_t chains = LIST_CHAINS;
+  cl_int err;
+
+  if (BUFFER == variant)
+  {
+    auto kernel = ctx.kernel(program, "chase_index");
+    auto nodes_mem = ctx.buffer(CL_MEM_READ_ONLY, LIST_NODES * sizeof(Index_node));
+    auto out_mem = ctx.buffer(CL_MEM_WRITE_ONLY, LIST_CHAINS * sizeof(cl_int));
+    if (!kernel || !nodes_mem || !out_mem)
+      return false;
+    if (!ctx.set_arg(kernel, 0, sizeof nodes_mem, &nodes_mem) || !ctx.set_arg(kernel, 1, sizeof out_mem, &out_mem))
+      return false;
+    vector<Index_node> nodes(LIST_NODES);
+    vector<cl_int> out(LIST_CHAINS);
+    for (size_t ii = 0; ii < nodes.size(); ++ii)
+      nodes[ii].next = next[ii];
+    cl_int iteration = 0;
+    return bench_measure([&]() -> double
+    {
+      ++iteration;
+      auto start = host_seconds();
+      for (auto& node : nodes)
+        node.value = iteration;
+      if (!ctx.check(clEnqueueWriteBuffer(queue, nodes_mem, CL_FALSE, 0, LIST_NODES * sizeof(Index_node), nodes.data(), 0, NULL, NULL), "write buffer")
+          || !ctx.enqueue(0, kernel, 1, &chains)
+          || !ctx.check(clEnqueueReadBuffer(queue, out_mem, CL_TRUE, 0, LIST_CHAINS * sizeof(cl_int), out.data(), 0, NULL, NULL), "read buffer"))
+        return -1.0;
+      auto t = host_seconds() - start;
+      return verify(ctx, out.data(), iteration) ? t : -1.0;
+    }, stats);
+  }
+
+  auto kernel = ctx.kernel(program, "chase_pointer");
+  if (!kernel)
+    return false;
+  Svm_node* nodes;
+  cl_int* out;
+  vector<Svm_node> system_nodes;
+  vector<cl_int> system_out;
+  if (FINE_GRAIN_SYSTEM == variant)
+  {
+    system_nodes.resize(LIST_NODES);
+    system_out.resize(LIST_CHAINS);
+    nodes = system_nodes.data();
+    out = system_out.data();
+  }
+  else
+  {
+    cl_svm_mem_flags flags = CL_MEM_READ_WRITE | (FINE_GRAIN_BUFFER == variant ? CL_MEM_SVM_FINE_GRAIN_BUFFER : 0);
+    nodes = (Svm_node*) ctx.svm_alloc(flags, LIST_NODES * sizeof(Svm_node));
+    out = (cl_int*) ctx.svm_alloc(flags, LIST_CHAINS * sizeof(cl_int));
+    if (!nodes || !out)
+      return false;
+  }
+  if (!ctx.check(clSetKernelArgSVMPointer(kernel, 0, nodes), "set SVM argument 0 of chase_pointer")
+      || !ctx.check(clSetKernelArgSVMPointer(kernel, 1, out), "set SVM argument 1 of chase_pointer"))
+    return false;
+
+  auto coarse = COARSE_GRAIN == variant;
+  if (coarse && !ctx.check(clEnqueueSVMMap(queue, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, nodes, LIST_NODES * sizeof(Svm_node), 0, NULL, NULL), "map SVM"))
+    return false;
+  for (size_t ii = 0; ii < LIST_NODES; ++ii)
+    nodes[ii].next = next[ii] < 0 ? nullptr : nodes + next[ii];
+  if (coarse && !ctx.check(clEnqueueSVMUnmap(queue, nodes, 0, NULL, NULL), "unmap SVM"))
+    return false;
+
+  cl_int iteration = 0;
+  return bench_measure([&]() -> double
+  {
+    ++iteration;
+    auto start = host_seconds();
+    if (coarse && !ctx.check(clEnqueueSVMMap(queue, CL_TRUE, CL_MAP_WRITE, nodes, LIST_NODES * sizeof(Svm_node), 0, NULL, NULL), "map SVM"))
+      return -1.0;
+    for (size_t ii = 0; ii < LIST_NODES; ++ii)
+      nodes[ii].value = iteration;
+    if (coarse && !ctx.check(clEnqueueSVMUnmap(queue, nodes, 0, NULL, NULL), "unmap SVM"))
+      return -1.0;
+    if (!ctx.enqueue(0, kernel, 1, &chains))
+      return -1.0;
+    if (coarse)
+      err = clEnqueueSVMMap(queue, CL_TRUE, CL_MAP_READ, out, LIST_CHAINS * sizeof(cl_int), 0, NULL, NULL);
+    else
+      err = clFinish(queue);
+    if (!ctx.check(err, "wait for kernel"))
+      return -1.0;
+    auto t = host_seconds() - start;
+    if (!verify(ctx, out, iteration))
+      return -1.0;
+    if (coarse && !ctx.check(clEnqueueSVMUnmap(queue, out, 0, NULL, NULL), "unmap SVM"))
+      return -1.0;
+    return t;
+  }, stats);
+}
+
+/**
+ * ping_pong --
+ *
+ *      Hands a counter back and forth: the host increments it, the device
+ *      increments it, the host checks it.
+ *
+ * Results:
+ *      true and the time per round trip if it was measured.
+ */
+static bool ping_pong(Bench_context& ctx, cl_program program, Variant variant, Bench_stats& stats)
+{
+  auto queue = ctx.queue();
+  auto kernel = ctx.kernel(program, "bump");
+  size_t one = 1;
+  cl_int err;
+  if (!kernel)
+    return false;
+
+  cl_mem counter_mem = nullptr;
+  cl_int* counter = nullptr;
+  cl_int system_counter = 0;
+  if (BUFFER == variant)
+  {
+    counter_mem = ctx.buffer(CL_MEM_READ_WRITE, sizeof(cl_int));
+    if (!counter_mem)
+      return false;
+    err = clSetKernelArg(kernel, 0, sizeof counter_mem, &counter_mem);
+  }
+  else
+  {
+    if (FINE_GRAIN_SYSTEM == variant)
+      counter = &system_counter;
+    else
+      counter = (cl_int*) ctx.svm_alloc(CL_MEM_READ_WRITE | (FINE_GRAIN_BUFFER == variant ? CL_MEM_SVM_FINE_GRAIN_BUFFER : 0), sizeof(cl_int));
+    if (!counter)
+      return false;
+    err = clSetKernelArgSVMPointer(kernel, 0, counter);
+  }
+  if (!ctx.check(err, "set kernel arguments"))
+    return false;
+
+  return bench_measure([&]() -> double
+  {
+    auto start = host_seconds();
+    for (cl_int round = 0; round < PING_ROUNDS; ++round)
+    {
+      cl_int value = 2 * round, result = 0;
+      bool ok;
+      switch (variant)
+      {
+      case BUFFER:
+        ok = ctx.check(clEnqueueWriteBuffer(queue, counter_mem, CL_FALSE, 0, sizeof value, &value, 0, NULL, NULL), "write buffer")
+          && ctx.enqueue(0, kernel, 1, &one)
+          && ctx.check(clEnqueueReadBuffer(queue, counter_mem, CL_TRUE, 0, sizeof result, &result, 0, NULL, NULL), "read buffer");
+        break;
+      case COARSE_GRAIN:
+        ok = ctx.check(clEnqueueSVMMap(queue, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, counter, sizeof value, 0, NULL, NULL), "map SVM");
+        if (ok)
+        {
+          *counter = value;
+          ok = ctx.check(clEnqueueSVMUnmap(queue, counter, 0, NULL, NULL), "unmap SVM")
+            && ctx.enqueue(0, kernel, 1, &one)
+            && ctx.check(clEnqueueSVMMap(queue, CL_TRUE, CL_MAP_READ, counter, sizeof result, 0, NULL, NULL), "map SVM");
+        }
+        if (ok)
+        {
+          result = *counter;
+          ok = ctx.check(clEnqueueSVMUnmap(queue, counter, 0, NULL, NULL), "unmap SVM");
+        }
+        break;
+      default:
+        *counter = value;
+        ok = ctx.enqueue(0, kernel, 1, &one) && ctx.check(clFinish(queue), "finish command queue");
+        result = *counter;
+      }
+      if (!ok)
+        return -1.0;
+      if (result != value + 1)
+      {
+        cerr << ctx.name() << ": ping-pong counter mismatch!" << endl;
+        return -1.0;
+      }
+    }
+    return (host_seconds() - start) / PING_ROUNDS;
+  }, stats);
+}
+
+void bench_svm(const string& tag, cl_device_id device)
+{
+  cl_device_svm_capabilities caps;
+  auto err = icd_get_device_info(device, CL_DEVICE_SVM_CAPABILITIES, sizeof caps, &caps, NULL);
+  if (CL_SUCCESS != err)
+  {
+    cerr << tag << ": Unable to get SVM_CAPABILITIES: " << cl_error_str(err) << "!" << endl;
+    return;
+  }
+  bool supported[NUM_VARIANTS] = {
+    true,
+    0 != (caps & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER),
+    0 != (caps & CL_DEVICE_SVM_FINE_GRAIN_BUFFER),
+    0 != (caps & CL_DEVICE_SVM_FINE_GRAIN_SYSTEM)};
+
+  /* The device walks host pointers in the SVM lists, so they must be the same width. */
+  auto address_bits = device_uint(device, CL_DEVICE_ADDRESS_BITS);
+  auto same_pointers = sizeof(void*) * 8 == address_bits;
+  if (!same_pointers)
+    printf("%s: SVM linked-list runs with buffers only: %u bit device pointers, %zu bit host pointers\n",
+           tag.c_str(), (unsigned) address_bits, sizeof(void*) * 8);
+
+  static const char* workloads[] = {"linked-list", "ping-pong"};
+  auto next = make_chains();
+  for (int workload = 0; workload < 2; ++workload)
+  {
+    double base = -1.0;
+    for (int variant = BUFFER; variant < NUM_VARIANTS; ++variant)
+    {
+      if (!supported[variant] || (0 == workload && BUFFER != variant && !same_pointers))
+        continue;
+      /* A fresh context per run keeps allocations of earlier runs out of the way */
+      Bench_context ctx(tag, vector<cl_device_id>(1, device));
+      if (!ctx)
+        return;
+      auto program = ctx.build(svm_source, "-cl-std=CL2.0");
+      if (nullptr == program)
+        return;
+      Bench_stats stats;
+      auto ok = 0 == workload ? linked_list(ctx, program, (Variant) variant, next, stats)
+                              : ping_pong(ctx, program, (Variant) variant, stats);
+      if (!ok)
+        continue;
+      bench_report(tag, device, string("SVM ") + workloads[workload] + " " + variant_names[variant], stats);
+      auto t = stats.median;
+      if (BUFFER == variant)
+        base = t;
+      else if (base > 0)
+        printf("%s: SVM %s %s: %.2fx the buffer time, %s\n", tag.c_str(), workloads[workload],
+               variant_names[variant], t / base, t > base * 1.05 ? "slower" : "not slower");
+    }
+  }
+}
+
+#else
+
+void bench_svm(const string& tag, cl_device_id)
+{
+  printf("%s: shared virtual memory requires OpenCL 2.0\n", tag.c_str());
+}
+
+#endif
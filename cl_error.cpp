@@ -0,0 +1,96 @@
+/**
+ * cl_error.cpp --
+ *
+ *      The OpenCL error code table.
+ */
+#include <cstdio>
+#include "clinfo.h"
+
+const char* cl_error_str(cl_int error)
+{
+  static struct {cl_int code; const char *msg;} error_table[] = {
+    {CL_SUCCESS,                         "no error"                       },
+    {CL_DEVICE_NOT_FOUND,                "device not found"               },
+    {CL_DEVICE_NOT_AVAILABLE,            "device not available"           },
+    {CL_COMPILER_NOT_AVAILABLE,          "compiler not available"         },
+    {CL_MEM_OBJECT_ALLOCATION_FAILURE,   "mem object allocation failure"  },
+    {CL_OUT_OF_RESOURCES,                "out of resources"               },
+    {CL_OUT_OF_HOST_MEMORY,              "out of host memory"             },
+    {CL_PROFILING_INFO_NOT_AVAILABLE,    "profiling not available"        },
+    {CL_MEM_COPY_OVERLAP,                "memcopy overlaps"               },
+    {CL_IMAGE_FORMAT_MISMATCH,           "image format mismatch"          },
+    {CL_IMAGE_FORMAT_NOT_SUPPORTED,      "image format not supported"     },
+    {CL_BUILD_PROGRAM_FAILURE,           "build program failed"           },
+    {CL_MAP_FAILURE,                     "map failed"                     },
+#ifdef CL_VERSION_1_1
+    {CL_MISALIGNED_SUB_BUFFER_OFFSET,    "misaligned sub-buffer offset"   },
+    {CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST,
+                                         "error status for events in wait list"},
+#endif
+#ifdef CL_VERSION_1_2
+    {CL_COMPILE_PROGRAM_FAILURE,         "compile program failed"         },
+    {CL_LINKER_NOT_AVAILABLE,            "linker not available"           },
+    {CL_LINK_PROGRAM_FAILURE,            "link program failed"            },
+    {CL_DEVICE_PARTITION_FAILED,         "device partition failed"        },
+    {CL_KERNEL_ARG_INFO_NOT_AVAILABLE,   "kernel arg info not available"  },
+#endif
+    {CL_INVALID_VALUE,                   "invalid value"                  },
+    {CL_INVALID_DEVICE_TYPE,             "invalid device type"            },
+    {CL_INVALID_PLATFORM,                "invalid platform"               },
+    {CL_INVALID_DEVICE,                  "invalid device"                 },
+    {CL_INVALID_CONTEXT,                 "invalid context"                },
+    {CL_INVALID_QUEUE_PROPERTIES,        "invalid queue properties"       },
+    {CL_INVALID_COMMAND_QUEUE,           "invalid command queue"          },
+    {CL_INVALID_HOST_PTR,                "invalid host pointer"           },
+    {CL_INVALID_MEM_OBJECT,              "invalid mem object"             },
+    {CL_INVALID_IMAGE_FORMAT_DESCRIPTOR, "invalid image format descriptor"},
+    {CL_INVALID_IMAGE_SIZE,              "invalid image size"             },
+    {CL_INVALID_SAMPLER,                 "invalid sampler"                },
+    {CL_INVALID_BINARY,                  "invalid binary"                 },
+    {CL_INVALID_BUILD_OPTIONS,           "invalid build options"          },
+    {CL_INVALID_PROGRAM,                 "invalid program"                },
+    {CL_INVALID_PROGRAM_EXECUTABLE,      "invalid program executable"     },
+    {CL_INVALID_KERNEL_NAME,             "invalid kernel name"            },
+    {CL_INVALID_KERNEL_DEFINITION,       "invalid kernel definition"      },
+    {CL_INVALID_KERNEL,                  "invalid kernel"                 },
+    {CL_INVALID_ARG_INDEX,               "invalid argument index"         },
+    {CL_INVALID_ARG_VALUE,               "invalid argument value"         },
+    {CL_INVALID_ARG_SIZE,                "invalid argument size"          },
+    {CL_INVALID_KERNEL_ARGS,             "invalid kernel arguments"       },
+    {CL_INVALID_WORK_DIMENSION,          "invalid work dimension"         },
+    {CL_INVALID_WORK_GROUP_SIZE,         "invalid work group size"        },
+    {CL_INVALID_WORK_ITEM_SIZE,          "invalid work item size"         },
+    {CL_INVALID_GLOBAL_OFFSET,           "invalid global offset"          },
+    {CL_INVALID_EVENT_WAIT_LIST,         "invalid event wait list"        },
+    {CL_INVALID_EVENT,                   "invalid event"                  },
+    {CL_INVALID_OPERATION,               "invalid operation"              },
+    {CL_INVALID_GL_OBJECT,               "invalid GL object"              },
+    {CL_INVALID_BUFFER_SIZE,             "invalid buffer size"            },
+    {CL_INVALID_MIP_LEVEL,               "invalid mip level"              },
+#ifdef CL_VERSION_1_1
+    {CL_INVALID_GLOBAL_WORK_SIZE,        "invalid global work size"       },
+    {CL_INVALID_PROPERTY,                "invalid property"               },
+#endif
+#ifdef CL_VERSION_1_2
+    {CL_INVALID_IMAGE_DESCRIPTOR,        "invalid image descriptor"       },
+    {CL_INVALID_COMPILER_OPTIONS,        "invalid compiler options"       },
+    {CL_INVALID_LINKER_OPTIONS,          "invalid linker options"         },
+    {CL_INVALID_DEVICE_PARTITION_COUNT,  "invalid device partition count" },
+#endif
+#ifdef CL_VERSION_2_0
+    {CL_INVALID_PIPE_SIZE,               "invalid pipe size"              },
+    {CL_INVALID_DEVICE_QUEUE,            "invalid device queue"           },
+#endif
+    {CLINFO_TIMED_OUT,                   "timed out"                      },
+    {CLINFO_SKIPPED,                     "skipped after a timeout"        },
+    {CLINFO_CRASHED,                     "crashed in a child process"     },
+    {0, nullptr}};
+  static thread_local char unknown[25]; /* also used by libcltrace.so */
+
+  for (int ii = 0; error_table[ii].msg != NULL; ++ii)
+    if (error_table[ii].code == error)
+      return error_table[ii].msg;
+
+  snprintf(unknown, sizeof unknown, "unknown error %d", error);
+  return unknown;
+}
@@ -0,0 +1,37 @@
+/**
+ * clinfo.h --
+ *
+ *      Declarations shared by the clinfo translation units.
+ */
+#ifndef CLINFO_H
+#define CLINFO_H
+
+#ifndef CL_TARGET_OPENCL_VERSION
+#define CL_TARGET_OPENCL_VERSION 300
+#endif
+/* clCreateCommandQueue is still the only portable way to get a queue */
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include "CL/cl.h"
+#endif
+
+/**
+ * cl_error_str --
+ *
+ *      Utility function that converts an OpenCL error into a human
+ *      readable string.
+ *
+ * Results:
+ *      const char * pointer to a static string.
+ */
+const char* cl_error_str(cl_int error);
+
+/* Statuses of clinfo's own, for calls it did not let the driver finish. */
+#define CLINFO_TIMED_OUT -10000 /* missed the --timeout deadline */
+#define CLINFO_SKIPPED   -10001 /* not made, an earlier call timed out */
+#define CLINFO_CRASHED   -10002 /* the --isolate child making it died */
+
+#endif
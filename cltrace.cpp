@@ -0,0 +1,857 @@
+/**
+ * cltrace.cpp --
+ *
+ *      libcltrace.so, an LD_PRELOAD library that interposes the OpenCL
+ *      calls listed in cltrace.h and logs each with its first arguments,
+ *      status and duration:
+ *
+ *          LD_PRELOAD=./libcltrace.so CLTRACE_FILE=app.trace ./app
+ *          clinfo --trace-report app.trace
+ *
+ *      Each thread appends records to its own single-producer ring buffer
+ *      without taking a lock.  A flusher thread moves the rings into a
+ *      batch every few milliseconds and once more at exit, and writes the
+ *      batch to the log after releasing the lock.  When a ring is full
+ *      the record is dropped and counted rather than blocking the
+ *      application.  The ring of a thread that exits is freed once it has
+ *      been drained.  A forked child starts with empty rings and its own
+ *      log and flusher.
+ *
+ *      Environment:
+ *          CLTRACE_FILE    log path, default cltrace.<pid>.bin; forked
+ *                          children append .<pid> to it
+ *          CLTRACE_ERRORS  if set, print every failing call to stderr
+ */
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+/* The deprecated entry points are traced like the others. */
+#define CL_USE_DEPRECATED_OPENCL_1_1_APIS
+#define CL_USE_DEPRECATED_OPENCL_2_2_APIS
+#include "clinfo.h"
+#include "cltrace.h"
+
+using namespace std;
+
+namespace {
+
+#define RING_CAPACITY  (1 << 14)
+#define FLUSH_INTERVAL chrono::milliseconds(10)
+
+struct Ring {
+  atomic<uint64_t> head;    /* next slot the producer writes */
+  atomic<uint64_t> tail;    /* next slot the flusher reads */
+  atomic<uint64_t> dropped;
+  atomic<bool> retired;     /* the producer thread has exited */
+  uint32_t thread;
+  Cltrace_record records[RING_CAPACITY];
+};
+
+uint64_t now()
+{
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Tracer {
+
+public:
+
+  static Tracer& get()
+  {
+    /* Never destroyed: OpenCL calls may still arrive from other atexit handlers */
+    static Tracer* tracer = new Tracer;
+    return *tracer;
+  }
+
+  void push(const Cltrace_record& record)
+  {
+    auto ring = static_cast<Ring*>(pthread_getspecific(key));
+    if (nullptr == ring)
+      ring = add_ring();
+    auto head = ring->head.load(memory_order_relaxed);
+    if (head - ring->tail.load(memory_order_acquire) >= RING_CAPACITY)
+    {
+      ring->dropped.fetch_add(1, memory_order_relaxed);
+      return;
+    }
+    auto& slot = ring->records[head % RING_CAPACITY];
+    slot = record;
+    slot.thread = ring->thread;
+    ring->head.store(head + 1, memory_order_release);
+  }
+
+  bool report_errors() const { return errors; }
+
+private:
+  int fd;
+  bool errors;
+  pthread_key_t key;         /* the Ring of the calling thread */
+  mutex lock;                /* rings and next_thread */
+  vector<Ring*> rings;
+  uint32_t next_thread;
+  vector<Cltrace_record> batch; /* only touched by the thread draining */
+  condition_variable wakeup;
+  bool stopping;
+  unique_ptr<thread> flusher;
+
+  Tracer() : fd(-1), errors(nullptr != getenv("CLTRACE_ERRORS")), next_thread(0), stopping(false)
+  {
+    /* Runs when a thread that called OpenCL exits; the flusher frees the ring */
+    pthread_key_create(&key, [](void* ring)
+    {
+      static_cast<Ring*>(ring)->retired.store(true, memory_order_release);
+    });
+    if (!open_log(false))
+      return;
+    flusher.reset(new thread([this] { run(); }));
+    atexit([] { get().stop(); });
+    pthread_atfork([] { get().lock.lock(); }, [] { get().lock.unlock(); }, [] { get().restart(); });
+  }
+
+  /**
+   * open_log --
+   *
+   *      Creates the log of this process and writes its header.
+   *
+   * Results:
+   *      false if the log could not be created.
+   */
+  bool open_log(bool child)
+  {
+    string path;
+    if (getenv("CLTRACE_FILE"))
+      path = string(getenv("CLTRACE_FILE")) + (child ? "." + to_string(getpid()) : "");
+    else
+      path = "cltrace." + to_string(getpid()) + ".bin";
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+      fprintf(stderr, "cltrace: Unable to open %s: %s!\n", path.c_str(), strerror(errno));
+      return false;
+    }
+    Cltrace_header header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, CLTRACE_MAGIC, sizeof CLTRACE_MAGIC);
+    header.version = CLTRACE_VERSION;
+    header.record_size = sizeof(Cltrace_record);
+    header.pid = getpid();
+    write_all(&header, sizeof header);
+    return fd >= 0;
+  }
+
+  Ring* add_ring()
+  {
+    auto ring = new Ring;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+    ring->retired = false;
+    {
+      lock_guard<mutex> guard(lock);
+      ring->thread = next_thread++;
+      rings.push_back(ring);
+    }
+    pthread_setspecific(key, ring);
+    return ring;
+  }
+
+  /**
+   * restart --
+   *
+   *      The pthread_atfork child handler, called with the lock the
+   *      prepare handler took.  Only the forking thread exists in the
+   *      child: frees the rings of the others, forgets what the parent
+   *      had not written yet, and opens a log and starts a flusher of the
+   *      child's own.
+   */
+  void restart()
+  {
+    auto own = static_cast<Ring*>(pthread_getspecific(key));
+    for (auto ring : rings)
+      if (ring != own)
+        delete ring;
+    rings.clear();
+    next_thread = 0;
+    if (own)
+    {
+      own->tail.store(own->head.load(memory_order_relaxed), memory_order_relaxed);
+      own->dropped = 0;
+      own->thread = next_thread++;
+      rings.push_back(own);
+    }
+    batch.clear();
+    if (fd >= 0)
+      close(fd);
+    /* Deliberately leaked: the thread it names does not exist in the child */
+    flusher.release();
+    if (open_log(true))
+      flusher.reset(new thread([this] { run(); }));
+    lock.unlock();
+  }
+
+  void run()
+  {
+    unique_lock<mutex> guard(lock);
+    while (!stopping)
+    {
+      wakeup.wait_for(guard, FLUSH_INTERVAL);
+      guard.unlock();
+      drain();
+      guard.lock();
+    }
+  }
+
+  void stop()
+  {
+    {
+      lock_guard<mutex> guard(lock);
+      stopping = true;
+    }
+    wakeup.notify_one();
+    if (flusher && flusher->joinable())
+      flusher->join();
+    drain();
+  }
+
+  /**
+   * drain --
+   *
+   *      Moves the records of every ring into the batch under the lock,
+   *      frees the rings of exited threads, and writes the batch after
+   *      releasing the lock so producers starting up never wait on the
+   *      file.
+   */
+  void drain()
+  {
+    {
+      lock_guard<mutex> guard(lock);
+      for (size_t ii = 0; ii < rings.size(); )
+      {
+        auto ring = rings[ii];
+        /* Read before head: everything pushed before the thread exited is seen */
+        auto retired = ring->retired.load(memory_order_acquire);
+        auto tail = ring->tail.load(memory_order_relaxed);
+        auto head = ring->head.load(memory_order_acquire);
+        while (tail != head)
+        {
+          auto first = tail % RING_CAPACITY;
+          auto count = min<uint64_t>(head - tail, RING_CAPACITY - first);
+          batch.insert(batch.end(), &ring->records[first], &ring->records[first] + count);
+          tail += count;
+        }
+        ring->tail.store(tail, memory_order_release);
+        auto dropped = ring->dropped.exchange(0, memory_order_relaxed);
+        if (dropped)
+        {
+          Cltrace_record record;
+          memset(&record, 0, sizeof record);
+          record.start = now();
+          record.thread = ring->thread;
+          record.function = CLTRACE_DROPPED;
+          record.args[0] = dropped;
+          batch.push_back(record);
+        }
+        if (retired)
+        {
+          delete ring;
+          rings.erase(rings.begin() + ii);
+        }
+        else
+          ++ii;
+      }
+    }
+    if (!batch.empty())
+      write_all(batch.data(), batch.size() * sizeof(Cltrace_record));
+    batch.clear();
+  }
+
+  void write_all(const void* data, size_t size)
+  {
+    auto p = static_cast<const char*>(data);
+    while (fd >= 0 && size > 0)
+    {
+      auto n = ::write(fd, p, size);
+      if (n < 0 && EINTR == errno)
+        continue;
+      if (n <= 0)
+      {
+        fprintf(stderr, "cltrace: Unable to write the log: %s!\n", strerror(errno));
+        close(fd);
+        fd = -1;
+        return;
+      }
+      p += n;
+      size -= n;
+    }
+  }
+};
+
+template <typename T> uint64_t arg_value(T* arg) { return (uintptr_t) arg; }
+template <typename T> uint64_t arg_value(T arg) { return (uint64_t) arg; }
+
+void fill_args(Cltrace_record&, unsigned) {}
+
+template <typename T, typename... Rest>
+void fill_args(Cltrace_record& record, unsigned index, T arg, Rest... rest)
+{
+  if (index < CLTRACE_ARGS)
+    record.args[index] = arg_value(arg);
+  fill_args(record, index + 1, rest...);
+}
+
+/**
+ * Call --
+ *
+ *      Times one intercepted call and hands its record to the tracer.
+ */
+class Call {
+
+public:
+
+  template <typename... Args>
+  Call(Cltrace_function function, Args... args)
+  {
+    memset(&record, 0, sizeof record);
+    record.function = function;
+    record.num_args = sizeof...(args);
+    fill_args(record, 0, args...);
+    record.start = now();
+  }
+
+  void finish(cl_int status)
+  {
+    record.duration = now() - record.start;
+    record.status = status;
+    auto& tracer = Tracer::get();
+    tracer.push(record);
+    if (CL_SUCCESS != status && tracer.report_errors())
+      fprintf(stderr, "cltrace: %s: %s\n", cltrace_function_name(record.function), cl_error_str(status));
+  }
+
+private:
+  Cltrace_record record;
+};
+
+void* resolve(const char* name)
+{
+  auto real = dlsym(RTLD_NEXT, name);
+  if (nullptr == real)
+  {
+    fprintf(stderr, "cltrace: Unable to find the real %s!\n", name);
+    abort();
+  }
+  return real;
+}
+
+}
+
+/* Functions that return their status. */
+#define TRACE_STATUS(name, params, ...)                                 \
+  CL_API_ENTRY cl_int CL_API_CALL name params                           \
+  {                                                                     \
+    static auto real = (decltype(&name)) resolve(#name);                \
+    Call call(CLTRACE_##name, __VA_ARGS__);                             \
+    auto status = real(__VA_ARGS__);                                    \
+    call.finish(status);                                                \
+    return status;                                                      \
+  }
+
+/* Functions that return an object and their status in errcode_ret. */
+#define TRACE_OBJECT(type, name, params, ...)                           \
+  CL_API_ENTRY type CL_API_CALL name params                             \
+  {                                                                     \
+    static auto real = (decltype(&name)) resolve(#name);                \
+    Call call(CLTRACE_##name, __VA_ARGS__);                             \
+    cl_int status;                                                      \
+    if (nullptr == errcode_ret)                                         \
+      errcode_ret = &status;                                            \
+    auto object = real(__VA_ARGS__);                                    \
+    call.finish(*errcode_ret);                                          \
+    return object;                                                      \
+  }
+
+TRACE_STATUS(clGetPlatformIDs,
+             (cl_uint num_entries, cl_platform_id* platforms, cl_uint* num_platforms),
+             num_entries, platforms, num_platforms)
+TRACE_STATUS(clGetPlatformInfo,
+             (cl_platform_id platform, cl_platform_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             platform, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_STATUS(clGetDeviceIDs,
+             (cl_platform_id platform, cl_device_type device_type, cl_uint num_entries,
+              cl_device_id* devices, cl_uint* num_devices),
+             platform, device_type, num_entries, devices, num_devices)
+TRACE_STATUS(clGetDeviceInfo,
+             (cl_device_id device, cl_device_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             device, param_name, param_value_size, param_value, param_value_size_ret)
+#ifdef CL_VERSION_1_2
+TRACE_STATUS(clCreateSubDevices,
+             (cl_device_id in_device, const cl_device_partition_property* properties,
+              cl_uint num_devices, cl_device_id* out_devices, cl_uint* num_devices_ret),
+             in_device, properties, num_devices, out_devices, num_devices_ret)
+TRACE_STATUS(clRetainDevice, (cl_device_id device), device)
+TRACE_STATUS(clReleaseDevice, (cl_device_id device), device)
+#endif
+TRACE_OBJECT(cl_context, clCreateContext,
+             (const cl_context_properties* properties, cl_uint num_devices, const cl_device_id* devices,
+              void (CL_CALLBACK* pfn_notify)(const char*, const void*, size_t, void*),
+              void* user_data, cl_int* errcode_ret),
+             properties, num_devices, devices, pfn_notify, user_data, errcode_ret)
+TRACE_OBJECT(cl_context, clCreateContextFromType,
+             (const cl_context_properties* properties, cl_device_type device_type,
+              void (CL_CALLBACK* pfn_notify)(const char*, const void*, size_t, void*),
+              void* user_data, cl_int* errcode_ret),
+             properties, device_type, pfn_notify, user_data, errcode_ret)
+TRACE_STATUS(clRetainContext, (cl_context context), context)
+TRACE_STATUS(clReleaseContext, (cl_context context), context)
+TRACE_STATUS(clGetContextInfo,
+             (cl_context context, cl_context_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             context, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_OBJECT(cl_command_queue, clCreateCommandQueue,
+             (cl_context context, cl_device_id device, cl_command_queue_properties properties,
+              cl_int* errcode_ret),
+             context, device, properties, errcode_ret)
+#ifdef CL_VERSION_2_0
+TRACE_OBJECT(cl_command_queue, clCreateCommandQueueWithProperties,
+             (cl_context context, cl_device_id device, const cl_queue_properties* properties,
+              cl_int* errcode_ret),
+             context, device, properties, errcode_ret)
+#endif
+TRACE_STATUS(clRetainCommandQueue, (cl_command_queue command_queue), command_queue)
+TRACE_STATUS(clReleaseCommandQueue, (cl_command_queue command_queue), command_queue)
+TRACE_STATUS(clGetCommandQueueInfo,
+             (cl_command_queue command_queue, cl_command_queue_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             command_queue, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_OBJECT(cl_mem, clCreateBuffer,
+             (cl_context context, cl_mem_flags flags, size_t size, void* host_ptr, cl_int* errcode_ret),
+             context, flags, size, host_ptr, errcode_ret)
+#ifdef CL_VERSION_1_1
+TRACE_OBJECT(cl_mem, clCreateSubBuffer,
+             (cl_mem buffer, cl_mem_flags flags, cl_buffer_create_type buffer_create_type,
+              const void* buffer_create_info, cl_int* errcode_ret),
+             buffer, flags, buffer_create_type, buffer_create_info, errcode_ret)
+#endif
+#ifdef CL_VERSION_1_2
+TRACE_OBJECT(cl_mem, clCreateImage,
+             (cl_context context, cl_mem_flags flags, const cl_image_format* image_format,
+              const cl_image_desc* image_desc, void* host_ptr, cl_int* errcode_ret),
+             context, flags, image_format, image_desc, host_ptr, errcode_ret)
+#endif
+TRACE_STATUS(clRetainMemObject, (cl_mem memobj), memobj)
+TRACE_STATUS(clReleaseMemObject, (cl_mem memobj), memobj)
+TRACE_STATUS(clGetSupportedImageFormats,
+             (cl_context context, cl_mem_flags flags, cl_mem_object_type image_type, cl_uint num_entries,
+              cl_image_format* image_formats, cl_uint* num_image_formats),
+             context, flags, image_type, num_entries, image_formats, num_image_formats)
+TRACE_STATUS(clGetMemObjectInfo,
+             (cl_mem memobj, cl_mem_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             memobj, param_name, param_value_size, param_value, param_value_size_ret)
+#ifdef CL_VERSION_2_0
+CL_API_ENTRY void* CL_API_CALL clSVMAlloc(cl_context context, cl_svm_mem_flags flags, size_t size, cl_uint alignment)
+{
+  static auto real = (decltype(&clSVMAlloc)) resolve("clSVMAlloc");
+  Call call(CLTRACE_clSVMAlloc, context, flags, size, alignment);
+  auto ptr = real(context, flags, size, alignment);
+  call.finish(nullptr == ptr ? CL_MEM_OBJECT_ALLOCATION_FAILURE : CL_SUCCESS);
+  return ptr;
+}
+
+CL_API_ENTRY void CL_API_CALL clSVMFree(cl_context context, void* svm_pointer)
+{
+  static auto real = (decltype(&clSVMFree)) resolve("clSVMFree");
+  Call call(CLTRACE_clSVMFree, context, svm_pointer);
+  real(context, svm_pointer);
+  call.finish(CL_SUCCESS);
+}
+#endif
+TRACE_OBJECT(cl_program, clCreateProgramWithSource,
+             (cl_context context, cl_uint count, const char** strings, const size_t* lengths,
+              cl_int* errcode_ret),
+             context, count, strings, lengths, errcode_ret)
+TRACE_OBJECT(cl_program, clCreateProgramWithBinary,
+             (cl_context context, cl_uint num_devices, const cl_device_id* device_list,
+              const size_t* lengths, const unsigned char** binaries, cl_int* binary_status,
+              cl_int* errcode_ret),
+             context, num_devices, device_list, lengths, binaries, binary_status, errcode_ret)
+TRACE_STATUS(clRetainProgram, (cl_program program), program)
+TRACE_STATUS(clReleaseProgram, (cl_program program), program)
+TRACE_STATUS(clBuildProgram,
+             (cl_program program, cl_uint num_devices, const cl_device_id* device_list, const char* options,
+              void (CL_CALLBACK* pfn_notify)(cl_program, void*), void* user_data),
+             program, num_devices, device_list, options, pfn_notify, user_data)
+TRACE_STATUS(clGetProgramInfo,
+             (cl_program program, cl_program_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             program, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_STATUS(clGetProgramBuildInfo,
+             (cl_program program, cl_device_id device, cl_program_build_info param_name,
+              size_t param_value_size, void* param_value, size_t* param_value_size_ret),
+             program, device, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_OBJECT(cl_kernel, clCreateKernel,
+             (cl_program program, const char* kernel_name, cl_int* errcode_ret),
+             program, kernel_name, errcode_ret)
+TRACE_STATUS(clCreateKernelsInProgram,
+             (cl_program program, cl_uint num_kernels, cl_kernel* kernels, cl_uint* num_kernels_ret),
+             program, num_kernels, kernels, num_kernels_ret)
+TRACE_STATUS(clRetainKernel, (cl_kernel kernel), kernel)
+TRACE_STATUS(clReleaseKernel, (cl_kernel kernel), kernel)
+TRACE_STATUS(clSetKernelArg,
+             (cl_kernel kernel, cl_uint arg_index, size_t arg_size, const void* arg_value),
+             kernel, arg_index, arg_size, arg_value)
+#ifdef CL_VERSION_2_0
+TRACE_STATUS(clSetKernelArgSVMPointer,
+             (cl_kernel kernel, cl_uint arg_index, const void* arg_value),
+             kernel, arg_index, arg_value)
+#endif
+TRACE_STATUS(clGetKernelInfo,
+             (cl_kernel kernel, cl_kernel_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             kernel, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_STATUS(clGetKernelWorkGroupInfo,
+             (cl_kernel kernel, cl_device_id device, cl_kernel_work_group_info param_name,
+              size_t param_value_size, void* param_value, size_t* param_value_size_ret),
+             kernel, device, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_STATUS(clWaitForEvents, (cl_uint num_events, const cl_event* event_list), num_events, event_list)
+TRACE_STATUS(clGetEventInfo,
+             (cl_event event, cl_event_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             event, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_STATUS(clRetainEvent, (cl_event event), event)
+TRACE_STATUS(clReleaseEvent, (cl_event event), event)
+TRACE_STATUS(clGetEventProfilingInfo,
+             (cl_event event, cl_profiling_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             event, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_STATUS(clFlush, (cl_command_queue command_queue), command_queue)
+TRACE_STATUS(clFinish, (cl_command_queue command_queue), command_queue)
+TRACE_STATUS(clEnqueueReadBuffer,
+             (cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_read, size_t offset,
+              size_t size, void* ptr, cl_uint num_events_in_wait_list, const cl_event* event_wait_list,
+              cl_event* event),
+             command_queue, buffer, blocking_read, offset, size, ptr, num_events_in_wait_list,
+             event_wait_list, event)
+TRACE_STATUS(clEnqueueWriteBuffer,
+             (cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_write, size_t offset,
+              size_t size, const void* ptr, cl_uint num_events_in_wait_list, const cl_event* event_wait_list,
+              cl_event* event),
+             command_queue, buffer, blocking_write, offset, size, ptr, num_events_in_wait_list,
+             event_wait_list, event)
+#ifdef CL_VERSION_1_1
+TRACE_STATUS(clEnqueueReadBufferRect,
+             (cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_read,
+              const size_t* buffer_origin, const size_t* host_origin, const size_t* region,
+              size_t buffer_row_pitch, size_t buffer_slice_pitch, size_t host_row_pitch,
+              size_t host_slice_pitch, void* ptr, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, buffer, blocking_read, buffer_origin, host_origin, region,
+             buffer_row_pitch, buffer_slice_pitch, host_row_pitch, host_slice_pitch, ptr,
+             num_events_in_wait_list, event_wait_list, event)
+TRACE_STATUS(clEnqueueWriteBufferRect,
+             (cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_write,
+              const size_t* buffer_origin, const size_t* host_origin, const size_t* region,
+              size_t buffer_row_pitch, size_t buffer_slice_pitch, size_t host_row_pitch,
+              size_t host_slice_pitch, const void* ptr, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, buffer, blocking_write, buffer_origin, host_origin, region,
+             buffer_row_pitch, buffer_slice_pitch, host_row_pitch, host_slice_pitch, ptr,
+             num_events_in_wait_list, event_wait_list, event)
+TRACE_STATUS(clEnqueueCopyBufferRect,
+             (cl_command_queue command_queue, cl_mem src_buffer, cl_mem dst_buffer,
+              const size_t* src_origin, const size_t* dst_origin, const size_t* region,
+              size_t src_row_pitch, size_t src_slice_pitch, size_t dst_row_pitch,
+              size_t dst_slice_pitch, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, src_buffer, dst_buffer, src_origin, dst_origin, region,
+             src_row_pitch, src_slice_pitch, dst_row_pitch, dst_slice_pitch,
+             num_events_in_wait_list, event_wait_list, event)
+#endif
+#ifdef CL_VERSION_1_2
+TRACE_STATUS(clEnqueueFillBuffer,
+             (cl_command_queue command_queue, cl_mem buffer, const void* pattern, size_t pattern_size,
+              size_t offset, size_t size, cl_uint num_events_in_wait_list, const cl_event* event_wait_list,
+              cl_event* event),
+             command_queue, buffer, pattern, pattern_size, offset, size, num_events_in_wait_list,
+             event_wait_list, event)
+#endif
+TRACE_STATUS(clEnqueueCopyBuffer,
+             (cl_command_queue command_queue, cl_mem src_buffer, cl_mem dst_buffer, size_t src_offset,
+              size_t dst_offset, size_t size, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, src_buffer, dst_buffer, src_offset, dst_offset, size,
+             num_events_in_wait_list, event_wait_list, event)
+TRACE_OBJECT(void*, clEnqueueMapBuffer,
+             (cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_map, cl_map_flags map_flags,
+              size_t offset, size_t size, cl_uint num_events_in_wait_list, const cl_event* event_wait_list,
+              cl_event* event, cl_int* errcode_ret),
+             command_queue, buffer, blocking_map, map_flags, offset, size, num_events_in_wait_list,
+             event_wait_list, event, errcode_ret)
+TRACE_STATUS(clEnqueueUnmapMemObject,
+             (cl_command_queue command_queue, cl_mem memobj, void* mapped_ptr,
+              cl_uint num_events_in_wait_list, const cl_event* event_wait_list, cl_event* event),
+             command_queue, memobj, mapped_ptr, num_events_in_wait_list, event_wait_list, event)
+TRACE_STATUS(clEnqueueNDRangeKernel,
+             (cl_command_queue command_queue, cl_kernel kernel, cl_uint work_dim,
+              const size_t* global_work_offset, const size_t* global_work_size,
+              const size_t* local_work_size, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, kernel, work_dim, global_work_offset, global_work_size, local_work_size,
+             num_events_in_wait_list, event_wait_list, event)
+#ifdef CL_VERSION_1_2
+TRACE_STATUS(clEnqueueMarkerWithWaitList,
+             (cl_command_queue command_queue, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, num_events_in_wait_list, event_wait_list, event)
+TRACE_STATUS(clEnqueueBarrierWithWaitList,
+             (cl_command_queue command_queue, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, num_events_in_wait_list, event_wait_list, event)
+#endif
+#ifdef CL_VERSION_2_0
+TRACE_STATUS(clEnqueueSVMMemcpy,
+             (cl_command_queue command_queue, cl_bool blocking_copy, void* dst_ptr, const void* src_ptr,
+              size_t size, cl_uint num_events_in_wait_list, const cl_event* event_wait_list,
+              cl_event* event),
+             command_queue, blocking_copy, dst_ptr, src_ptr, size, num_events_in_wait_list,
+             event_wait_list, event)
+TRACE_STATUS(clEnqueueSVMMemFill,
+             (cl_command_queue command_queue, void* svm_ptr, const void* pattern, size_t pattern_size,
+              size_t size, cl_uint num_events_in_wait_list, const cl_event* event_wait_list,
+              cl_event* event),
+             command_queue, svm_ptr, pattern, pattern_size, size, num_events_in_wait_list,
+             event_wait_list, event)
+TRACE_STATUS(clEnqueueSVMMap,
+             (cl_command_queue command_queue, cl_bool blocking_map, cl_map_flags flags, void* svm_ptr,
+              size_t size, cl_uint num_events_in_wait_list, const cl_event* event_wait_list,
+              cl_event* event),
+             command_queue, blocking_map, flags, svm_ptr, size, num_events_in_wait_list,
+             event_wait_list, event)
+TRACE_STATUS(clEnqueueSVMUnmap,
+             (cl_command_queue command_queue, void* svm_ptr, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, svm_ptr, num_events_in_wait_list, event_wait_list, event)
+#endif
+TRACE_OBJECT(cl_mem, clCreateImage2D,
+             (cl_context context, cl_mem_flags flags, const cl_image_format* image_format,
+              size_t image_width, size_t image_height, size_t image_row_pitch, void* host_ptr,
+              cl_int* errcode_ret),
+             context, flags, image_format, image_width, image_height, image_row_pitch, host_ptr,
+             errcode_ret)
+TRACE_OBJECT(cl_mem, clCreateImage3D,
+             (cl_context context, cl_mem_flags flags, const cl_image_format* image_format,
+              size_t image_width, size_t image_height, size_t image_depth, size_t image_row_pitch,
+              size_t image_slice_pitch, void* host_ptr, cl_int* errcode_ret),
+             context, flags, image_format, image_width, image_height, image_depth, image_row_pitch,
+             image_slice_pitch, host_ptr, errcode_ret)
+TRACE_STATUS(clGetImageInfo,
+             (cl_mem image, cl_image_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             image, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_OBJECT(cl_sampler, clCreateSampler,
+             (cl_context context, cl_bool normalized_coords, cl_addressing_mode addressing_mode,
+              cl_filter_mode filter_mode, cl_int* errcode_ret),
+             context, normalized_coords, addressing_mode, filter_mode, errcode_ret)
+TRACE_STATUS(clRetainSampler, (cl_sampler sampler), sampler)
+TRACE_STATUS(clReleaseSampler, (cl_sampler sampler), sampler)
+TRACE_STATUS(clGetSamplerInfo,
+             (cl_sampler sampler, cl_sampler_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             sampler, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_STATUS(clEnqueueReadImage,
+             (cl_command_queue command_queue, cl_mem image, cl_bool blocking_read, const size_t* origin,
+              const size_t* region, size_t row_pitch, size_t slice_pitch, void* ptr,
+              cl_uint num_events_in_wait_list, const cl_event* event_wait_list, cl_event* event),
+             command_queue, image, blocking_read, origin, region, row_pitch, slice_pitch, ptr,
+             num_events_in_wait_list, event_wait_list, event)
+TRACE_STATUS(clEnqueueWriteImage,
+             (cl_command_queue command_queue, cl_mem image, cl_bool blocking_write, const size_t* origin,
+              const size_t* region, size_t input_row_pitch, size_t input_slice_pitch, const void* ptr,
+              cl_uint num_events_in_wait_list, const cl_event* event_wait_list, cl_event* event),
+             command_queue, image, blocking_write, origin, region, input_row_pitch, input_slice_pitch,
+             ptr, num_events_in_wait_list, event_wait_list, event)
+TRACE_STATUS(clEnqueueCopyImage,
+             (cl_command_queue command_queue, cl_mem src_image, cl_mem dst_image,
+              const size_t* src_origin, const size_t* dst_origin, const size_t* region,
+              cl_uint num_events_in_wait_list, const cl_event* event_wait_list, cl_event* event),
+             command_queue, src_image, dst_image, src_origin, dst_origin, region,
+             num_events_in_wait_list, event_wait_list, event)
+TRACE_STATUS(clEnqueueCopyImageToBuffer,
+             (cl_command_queue command_queue, cl_mem src_image, cl_mem dst_buffer,
+              const size_t* src_origin, const size_t* region, size_t dst_offset,
+              cl_uint num_events_in_wait_list, const cl_event* event_wait_list, cl_event* event),
+             command_queue, src_image, dst_buffer, src_origin, region, dst_offset,
+             num_events_in_wait_list, event_wait_list, event)
+TRACE_STATUS(clEnqueueCopyBufferToImage,
+             (cl_command_queue command_queue, cl_mem src_buffer, cl_mem dst_image, size_t src_offset,
+              const size_t* dst_origin, const size_t* region,
+              cl_uint num_events_in_wait_list, const cl_event* event_wait_list, cl_event* event),
+             command_queue, src_buffer, dst_image, src_offset, dst_origin, region,
+             num_events_in_wait_list, event_wait_list, event)
+TRACE_OBJECT(void*, clEnqueueMapImage,
+             (cl_command_queue command_queue, cl_mem image, cl_bool blocking_map, cl_map_flags map_flags,
+              const size_t* origin, const size_t* region, size_t* image_row_pitch,
+              size_t* image_slice_pitch, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event, cl_int* errcode_ret),
+             command_queue, image, blocking_map, map_flags, origin, region, image_row_pitch,
+             image_slice_pitch, num_events_in_wait_list, event_wait_list, event, errcode_ret)
+TRACE_STATUS(clEnqueueTask,
+             (cl_command_queue command_queue, cl_kernel kernel, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, kernel, num_events_in_wait_list, event_wait_list, event)
+TRACE_STATUS(clEnqueueNativeKernel,
+             (cl_command_queue command_queue, void (CL_CALLBACK* user_func)(void*), void* args,
+              size_t cb_args, cl_uint num_mem_objects, const cl_mem* mem_list,
+              const void** args_mem_loc, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, user_func, args, cb_args, num_mem_objects, mem_list, args_mem_loc,
+             num_events_in_wait_list, event_wait_list, event)
+TRACE_STATUS(clEnqueueMarker, (cl_command_queue command_queue, cl_event* event), command_queue, event)
+TRACE_STATUS(clEnqueueWaitForEvents,
+             (cl_command_queue command_queue, cl_uint num_events, const cl_event* event_list),
+             command_queue, num_events, event_list)
+TRACE_STATUS(clEnqueueBarrier, (cl_command_queue command_queue), command_queue)
+
+/* No arguments, so not one of the macros. */
+CL_API_ENTRY cl_int CL_API_CALL clUnloadCompiler(void)
+{
+  static auto real = (decltype(&clUnloadCompiler)) resolve("clUnloadCompiler");
+  Call call(CLTRACE_clUnloadCompiler);
+  auto status = real();
+  call.finish(status);
+  return status;
+}
+
+#ifdef CL_VERSION_1_1
+TRACE_STATUS(clSetMemObjectDestructorCallback,
+             (cl_mem memobj, void (CL_CALLBACK* pfn_notify)(cl_mem, void*), void* user_data),
+             memobj, pfn_notify, user_data)
+TRACE_OBJECT(cl_event, clCreateUserEvent, (cl_context context, cl_int* errcode_ret), context, errcode_ret)
+TRACE_STATUS(clSetUserEventStatus, (cl_event event, cl_int execution_status), event, execution_status)
+TRACE_STATUS(clSetEventCallback,
+             (cl_event event, cl_int command_exec_callback_type,
+              void (CL_CALLBACK* pfn_notify)(cl_event, cl_int, void*), void* user_data),
+             event, command_exec_callback_type, pfn_notify, user_data)
+#endif
+#ifdef CL_VERSION_1_2
+TRACE_OBJECT(cl_program, clCreateProgramWithBuiltInKernels,
+             (cl_context context, cl_uint num_devices, const cl_device_id* device_list,
+              const char* kernel_names, cl_int* errcode_ret),
+             context, num_devices, device_list, kernel_names, errcode_ret)
+TRACE_STATUS(clCompileProgram,
+             (cl_program program, cl_uint num_devices, const cl_device_id* device_list,
+              const char* options, cl_uint num_input_headers, const cl_program* input_headers,
+              const char** header_include_names,
+              void (CL_CALLBACK* pfn_notify)(cl_program, void*), void* user_data),
+             program, num_devices, device_list, options, num_input_headers, input_headers,
+             header_include_names, pfn_notify, user_data)
+TRACE_OBJECT(cl_program, clLinkProgram,
+             (cl_context context, cl_uint num_devices, const cl_device_id* device_list,
+              const char* options, cl_uint num_input_programs, const cl_program* input_programs,
+              void (CL_CALLBACK* pfn_notify)(cl_program, void*), void* user_data,
+              cl_int* errcode_ret),
+             context, num_devices, device_list, options, num_input_programs, input_programs,
+             pfn_notify, user_data, errcode_ret)
+TRACE_STATUS(clUnloadPlatformCompiler, (cl_platform_id platform), platform)
+TRACE_STATUS(clGetKernelArgInfo,
+             (cl_kernel kernel, cl_uint arg_index, cl_kernel_arg_info param_name,
+              size_t param_value_size, void* param_value, size_t* param_value_size_ret),
+             kernel, arg_index, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_STATUS(clEnqueueFillImage,
+             (cl_command_queue command_queue, cl_mem image, const void* fill_color,
+              const size_t* origin, const size_t* region, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, image, fill_color, origin, region, num_events_in_wait_list,
+             event_wait_list, event)
+TRACE_STATUS(clEnqueueMigrateMemObjects,
+             (cl_command_queue command_queue, cl_uint num_mem_objects, const cl_mem* mem_objects,
+              cl_mem_migration_flags flags, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, num_mem_objects, mem_objects, flags, num_events_in_wait_list,
+             event_wait_list, event)
+#endif
+#ifdef CL_VERSION_2_0
+TRACE_OBJECT(cl_mem, clCreatePipe,
+             (cl_context context, cl_mem_flags flags, cl_uint pipe_packet_size,
+              cl_uint pipe_max_packets, const cl_pipe_properties* properties, cl_int* errcode_ret),
+             context, flags, pipe_packet_size, pipe_max_packets, properties, errcode_ret)
+TRACE_STATUS(clGetPipeInfo,
+             (cl_mem pipe, cl_pipe_info param_name, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             pipe, param_name, param_value_size, param_value, param_value_size_ret)
+TRACE_OBJECT(cl_sampler, clCreateSamplerWithProperties,
+             (cl_context context, const cl_sampler_properties* sampler_properties, cl_int* errcode_ret),
+             context, sampler_properties, errcode_ret)
+TRACE_STATUS(clSetKernelExecInfo,
+             (cl_kernel kernel, cl_kernel_exec_info param_name, size_t param_value_size,
+              const void* param_value),
+             kernel, param_name, param_value_size, param_value)
+TRACE_STATUS(clEnqueueSVMFree,
+             (cl_command_queue command_queue, cl_uint num_svm_pointers, void* svm_pointers[],
+              void (CL_CALLBACK* pfn_free_func)(cl_command_queue, cl_uint, void*[], void*),
+              void* user_data, cl_uint num_events_in_wait_list, const cl_event* event_wait_list,
+              cl_event* event),
+             command_queue, num_svm_pointers, svm_pointers, pfn_free_func, user_data,
+             num_events_in_wait_list, event_wait_list, event)
+#endif
+#ifdef CL_VERSION_2_1
+TRACE_OBJECT(cl_program, clCreateProgramWithIL,
+             (cl_context context, const void* il, size_t length, cl_int* errcode_ret),
+             context, il, length, errcode_ret)
+TRACE_OBJECT(cl_kernel, clCloneKernel, (cl_kernel source_kernel, cl_int* errcode_ret), source_kernel, errcode_ret)
+TRACE_STATUS(clGetKernelSubGroupInfo,
+             (cl_kernel kernel, cl_device_id device, cl_kernel_sub_group_info param_name,
+              size_t input_value_size, const void* input_value, size_t param_value_size,
+              void* param_value, size_t* param_value_size_ret),
+             kernel, device, param_name, input_value_size, input_value, param_value_size, param_value,
+             param_value_size_ret)
+TRACE_STATUS(clEnqueueSVMMigrateMem,
+             (cl_command_queue command_queue, cl_uint num_svm_pointers, const void** svm_pointers,
+              const size_t* sizes, cl_mem_migration_flags flags, cl_uint num_events_in_wait_list,
+              const cl_event* event_wait_list, cl_event* event),
+             command_queue, num_svm_pointers, svm_pointers, sizes, flags, num_events_in_wait_list,
+             event_wait_list, event)
+TRACE_STATUS(clGetDeviceAndHostTimer,
+             (cl_device_id device, cl_ulong* device_timestamp, cl_ulong* host_timestamp),
+             device, device_timestamp, host_timestamp)
+TRACE_STATUS(clGetHostTimer, (cl_device_id device, cl_ulong* host_timestamp), device, host_timestamp)
+TRACE_STATUS(clSetDefaultDeviceCommandQueue,
+             (cl_context context, cl_device_id device, cl_command_queue command_queue),
+             context, device, command_queue)
+#endif
+#ifdef CL_VERSION_2_2
+TRACE_STATUS(clSetProgramReleaseCallback,
+             (cl_program program, void (CL_CALLBACK* pfn_notify)(cl_program, void*), void* user_data),
+             program, pfn_notify, user_data)
+TRACE_STATUS(clSetProgramSpecializationConstant,
+             (cl_program program, cl_uint spec_id, size_t spec_size, const void* spec_value),
+             program, spec_id, spec_size, spec_value)
+#endif
+#ifdef CL_VERSION_3_0
+TRACE_STATUS(clSetContextDestructorCallback,
+             (cl_context context, void (CL_CALLBACK* pfn_notify)(cl_context, void*), void* user_data),
+             context, pfn_notify, user_data)
+TRACE_OBJECT(cl_mem, clCreateBufferWithProperties,
+             (cl_context context, const cl_mem_properties* properties, cl_mem_flags flags, size_t size,
+              void* host_ptr, cl_int* errcode_ret),
+             context, properties, flags, size, host_ptr, errcode_ret)
+TRACE_OBJECT(cl_mem, clCreateImageWithProperties,
+             (cl_context context, const cl_mem_properties* properties, cl_mem_flags flags,
+              const cl_image_format* image_format, const cl_image_desc* image_desc, void* host_ptr,
+              cl_int* errcode_ret),
+             context, properties, flags, image_format, image_desc, host_ptr, errcode_ret)
+#endif
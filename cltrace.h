@@ -0,0 +1,191 @@
+/**
+ * cltrace.h --
+ *
+ *      Binary log format written by libcltrace.so and read back by
+ *      clinfo --trace-report.
+ *
+ *      A log is a Cltrace_header followed by fixed size Cltrace_record
+ *      entries in the order the per-thread ring buffers were flushed, so
+ *      records are ordered within a thread but not across threads.
+ *
+ *      The functions traced are the core host API up to OpenCL 3.0, less
+ *      clGetExtensionFunctionAddress[ForPlatform]() and the 1.0-only
+ *      clSetCommandQueueProperty().  Extension functions are called
+ *      through the pointers those return, so they are not logged.
+ */
+#ifndef CLINFO_CLTRACE_H
+#define CLINFO_CLTRACE_H
+
+#include <cstdint>
+#include <string>
+
+#define CLTRACE_MAGIC   "CLTRACE"
+#define CLTRACE_VERSION 1
+#define CLTRACE_ARGS    4
+
+/* Append only: the position in this list is the id stored in the log. */
+#define CLTRACE_FUNCTIONS                    \
+    def(clGetPlatformIDs),                   \
+    def(clGetPlatformInfo),                  \
+    def(clGetDeviceIDs),                     \
+    def(clGetDeviceInfo),                    \
+    def(clCreateSubDevices),                 \
+    def(clRetainDevice),                     \
+    def(clReleaseDevice),                    \
+    def(clCreateContext),                    \
+    def(clCreateContextFromType),            \
+    def(clRetainContext),                    \
+    def(clReleaseContext),                   \
+    def(clGetContextInfo),                   \
+    def(clCreateCommandQueue),               \
+    def(clCreateCommandQueueWithProperties), \
+    def(clRetainCommandQueue),               \
+    def(clReleaseCommandQueue),              \
+    def(clGetCommandQueueInfo),              \
+    def(clCreateBuffer),                     \
+    def(clCreateSubBuffer),                  \
+    def(clCreateImage),                      \
+    def(clRetainMemObject),                  \
+    def(clReleaseMemObject),                 \
+    def(clGetSupportedImageFormats),         \
+    def(clGetMemObjectInfo),                 \
+    def(clSVMAlloc),                         \
+    def(clSVMFree),                          \
+    def(clCreateProgramWithSource),          \
+    def(clCreateProgramWithBinary),          \
+    def(clRetainProgram),                    \
+    def(clReleaseProgram),                   \
+    def(clBuildProgram),                     \
+    def(clGetProgramInfo),                   \
+    def(clGetProgramBuildInfo),              \
+    def(clCreateKernel),                     \
+    def(clCreateKernelsInProgram),           \
+    def(clRetainKernel),                     \
+    def(clReleaseKernel),                    \
+    def(clSetKernelArg),                     \
+    def(clSetKernelArgSVMPointer),           \
+    def(clGetKernelInfo),                    \
+    def(clGetKernelWorkGroupInfo),           \
+    def(clWaitForEvents),                    \
+    def(clGetEventInfo),                     \
+    def(clRetainEvent),                      \
+    def(clReleaseEvent),                     \
+    def(clGetEventProfilingInfo),            \
+    def(clFlush),                            \
+    def(clFinish),                           \
+    def(clEnqueueReadBuffer),                \
+    def(clEnqueueReadBufferRect),            \
+    def(clEnqueueWriteBuffer),               \
+    def(clEnqueueWriteBufferRect),           \
+    def(clEnqueueFillBuffer),                \
+    def(clEnqueueCopyBuffer),                \
+    def(clEnqueueCopyBufferRect),            \
+    def(clEnqueueMapBuffer),                 \
+    def(clEnqueueUnmapMemObject),            \
+    def(clEnqueueNDRangeKernel),             \
+    def(clEnqueueMarkerWithWaitList),        \
+    def(clEnqueueBarrierWithWaitList),       \
+    def(clEnqueueSVMMemcpy),                 \
+    def(clEnqueueSVMMemFill),                \
+    def(clEnqueueSVMMap),                    \
+    def(clEnqueueSVMUnmap),                  \
+    def(clCreateImage2D),                    \
+    def(clCreateImage3D),                    \
+    def(clGetImageInfo),                     \
+    def(clCreateSampler),                    \
+    def(clRetainSampler),                    \
+    def(clReleaseSampler),                   \
+    def(clGetSamplerInfo),                   \
+    def(clEnqueueReadImage),                 \
+    def(clEnqueueWriteImage),                \
+    def(clEnqueueCopyImage),                 \
+    def(clEnqueueCopyImageToBuffer),         \
+    def(clEnqueueCopyBufferToImage),         \
+    def(clEnqueueMapImage),                  \
+    def(clEnqueueTask),                      \
+    def(clEnqueueNativeKernel),              \
+    def(clEnqueueMarker),                    \
+    def(clEnqueueWaitForEvents),             \
+    def(clEnqueueBarrier),                   \
+    def(clUnloadCompiler),                   \
+    def(clSetMemObjectDestructorCallback),   \
+    def(clCreateUserEvent),                  \
+    def(clSetUserEventStatus),               \
+    def(clSetEventCallback),                 \
+    def(clCreateProgramWithBuiltInKernels),  \
+    def(clCompileProgram),                   \
+    def(clLinkProgram),                      \
+    def(clUnloadPlatformCompiler),           \
+    def(clGetKernelArgInfo),                 \
+    def(clEnqueueFillImage),                 \
+    def(clEnqueueMigrateMemObjects),         \
+    def(clCreatePipe),                       \
+    def(clGetPipeInfo),                      \
+    def(clCreateSamplerWithProperties),      \
+    def(clSetKernelExecInfo),                \
+    def(clEnqueueSVMFree),                   \
+    def(clCreateProgramWithIL),              \
+    def(clCloneKernel),                      \
+    def(clGetKernelSubGroupInfo),            \
+    def(clEnqueueSVMMigrateMem),             \
+    def(clGetDeviceAndHostTimer),            \
+    def(clGetHostTimer),                     \
+    def(clSetDefaultDeviceCommandQueue),     \
+    def(clSetProgramReleaseCallback),        \
+    def(clSetProgramSpecializationConstant), \
+    def(clSetContextDestructorCallback),     \
+    def(clCreateBufferWithProperties),       \
+    def(clCreateImageWithProperties),
+
+enum Cltrace_function {
+#define def(X) CLTRACE_##X
+  CLTRACE_FUNCTIONS
+#undef def
+  CLTRACE_NUM_FUNCTIONS,
+  CLTRACE_DROPPED = 0xffff /* pseudo call: args[0] records were lost */
+};
+
+static inline const char* cltrace_function_name(unsigned function)
+{
+  static const char* names[] = {
+#define def(X) #X
+    CLTRACE_FUNCTIONS
+#undef def
+  };
+  if (CLTRACE_DROPPED == function)
+    return "(dropped records)";
+  return function < CLTRACE_NUM_FUNCTIONS ? names[function] : "(unknown)";
+}
+
+struct Cltrace_header {
+  char     magic[8];    /* CLTRACE_MAGIC */
+  uint32_t version;     /* CLTRACE_VERSION */
+  uint32_t record_size; /* sizeof(Cltrace_record) */
+  uint64_t pid;
+};
+
+struct Cltrace_record {
+  uint64_t start;       /* ns on the monotonic clock */
+  uint64_t duration;    /* ns */
+  uint32_t thread;      /* sequential id of the calling thread */
+  uint16_t function;    /* Cltrace_function */
+  uint16_t num_args;    /* arguments of the call, at most CLTRACE_ARGS kept */
+  int32_t  status;      /* return or errcode_ret value */
+  uint32_t reserved;
+  uint64_t args[CLTRACE_ARGS];
+};
+
+static_assert(sizeof(Cltrace_record) == 64, "keep trace records compact");
+
+/**
+ * trace_report --
+ *
+ *      Summarises a libcltrace.so log: call counts, time distribution
+ *      and errors per function.
+ *
+ * Results:
+ *      the process exit status.
+ */
+int trace_report(const std::string& path);
+
+#endif
@@ -0,0 +1,256 @@
+/**
+ * compile_farm.cpp --
+ *
+ *      Builds every .cl file of a directory with every option set for
+ *      every device, concurrently, and reports the outcome, build log,
+ *      binary size and compile time of each build.
+ *
+ *      A pool of host threads submits the builds, one device per
+ *      clBuildProgram call so each device gets its own status and time.
+ *      The builds pass a pfn_notify callback: drivers that build
+ *      asynchronously return at once and the submitting thread moves on
+ *      to the next build, while at most `jobs` builds are in flight; a
+ *      synchronous driver simply calls back before returning, and the
+ *      threads provide the parallelism.
+ */
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+#include "bench.h"
+#include "inventory.h"
+
+using namespace std;
+
+namespace {
+
+struct Build {
+  size_t file, options;    /* indices */
+  size_t platform, device; /* indices, for the tag */
+  cl_context context;
+  cl_device_id device_id;
+  cl_program program;
+  cl_int err;
+  bool done;
+  double start, seconds;
+};
+
+mutex builds_lock;
+condition_variable builds_done;
+unsigned in_flight;
+
+}
+
+/**
+ * finish --
+ *
+ *      Marks a build done, from the callback or from the submitting
+ *      thread when clBuildProgram failed before calling back.
+ *
+ * Results:
+ *      void.
+ */
+static void finish(Build* build, cl_int err)
+{
+  auto now = host_seconds();
+  lock_guard<mutex> guard(builds_lock);
+  if (build->done)
+    return;
+  build->done = true;
+  build->err = err;
+  build->seconds = now - build->start;
+  --in_flight;
+  builds_done.notify_all();
+}
+
+static void CL_CALLBACK notify(cl_program, void* user_data)
+{
+  finish(static_cast<Build*>(user_data), CL_SUCCESS);
+}
+
+/**
+ * submit --
+ *
+ *      Starts one build once fewer than jobs builds are in flight.
+ *
+ * Results:
+ *      void.
+ */
+static void submit(Build& build, const string& source, const string& options, unsigned jobs)
+{
+  {
+    unique_lock<mutex> guard(builds_lock);
+    builds_done.wait(guard, [&] { return in_flight < jobs; });
+    ++in_flight;
+  }
+  auto text = source.c_str();
+  build.start = host_seconds();
+  cl_int err;
+  build.program = clCreateProgramWithSource(build.context, 1, &text, NULL, &err);
+  if (CL_SUCCESS == err)
+    err = clBuildProgram(build.program, 1, &build.device_id, options.c_str(), notify, &build);
+  if (CL_SUCCESS != err)
+    finish(&build, err);
+}
+
+/**
+ * list_sources --
+ *
+ *      Finds the .cl files of a directory, leaving out directories.
+ *
+ * Results:
+ *      the sorted paths, empty if the directory cannot be read.
+ */
+static vector<string> list_sources(const string& dir)
+{
+  vector<string> paths;
+  auto d = opendir(dir.c_str());
+  if (nullptr == d)
+    return paths;
+  while (auto entry = readdir(d))
+  {
+    string name = entry->d_name;
+    struct stat st;
+    /* A dangling link is kept, so that it is reported as unreadable. */
+    if (name.size() > 3 && 0 == name.compare(name.size() - 3, 3, ".cl")
+        && (0 != stat((dir + "/" + name).c_str(), &st) || !S_ISDIR(st.st_mode)))
+      paths.push_back(dir + "/" + name);
+  }
+  closedir(d);
+  sort(paths.begin(), paths.end());
+  return paths;
+}
+
+int compile_farm(const string& dir, const vector<string>& option_sets, unsigned jobs)
+{
+  auto paths = list_sources(dir);
+  if (paths.empty())
+  {
+    cerr << "No .cl files in " << dir << "!" << endl;
+    return EXIT_FAILURE;
+  }
+  vector<string> sources;
+  vector<bool> readable;
+  auto unreadable = 0;
+  for (auto& path : paths)
+  {
+    ifstream in(path);
+    sources.push_back(string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>()));
+    readable.push_back(!in.fail());
+    if (!readable.back())
+    {
+      cerr << "Unable to read " << path << "!" << endl;
+      ++unreadable;
+    }
+  }
+  vector<string> options = option_sets.empty() ? vector<string>(1) : option_sets;
+  if (0 == jobs)
+    jobs = max(1u, thread::hardware_concurrency());
+
+  /* One context per platform, shared by the builds for its devices */
+  auto enumeration = enumerate_devices();
+  report_enumeration(enumeration);
+  if (CL_SUCCESS != enumeration.status)
+    return EXIT_FAILURE;
+  vector<cl_context> contexts;
+  vector<Build> builds;
+  for (size_t ii = 0; ii < enumeration.platforms.size(); ++ii)
+  {
+    auto& devices = enumeration.platforms[ii].devices;
+    if (devices.empty())
+      continue;
+    cl_int err;
+    auto context = clCreateContext(NULL, devices.size(), devices.data(), NULL, NULL, &err);
+    if (CL_SUCCESS != err)
+    {
+      cerr << "platform[" << ii << "]: Unable to create context: " << cl_error_str(err) << "!" << endl;
+      continue;
+    }
+    contexts.push_back(context);
+    for (size_t file = 0; file < paths.size(); ++file)
+      for (size_t opt = 0; readable[file] && opt < options.size(); ++opt)
+        for (size_t jj = 0; jj < devices.size(); ++jj)
+          builds.push_back(Build{file, opt, ii, jj, context, devices[jj], nullptr, CL_SUCCESS, false, 0, 0});
+  }
+
+  auto start = host_seconds();
+  atomic<size_t> next(0);
+  vector<thread> pool;
+  for (unsigned ii = 0; ii < min<size_t>(jobs, builds.size()); ++ii)
+    pool.push_back(thread([&]
+    {
+      for (size_t job; (job = next++) < builds.size(); )
+        submit(builds[job], sources[builds[job].file], options[builds[job].options], jobs);
+    }));
+  for (auto& t : pool)
+    t.join();
+  {
+    unique_lock<mutex> guard(builds_lock);
+    builds_done.wait(guard, [] { return 0 == in_flight; });
+  }
+  auto wall = host_seconds() - start;
+
+  auto failures = 0;
+  double total = 0;
+  sort(builds.begin(), builds.end(), [](const Build& a, const Build& b)
+  {
+    return a.file != b.file ? a.file < b.file : a.options != b.options ? a.options < b.options
+         : a.platform != b.platform ? a.platform < b.platform : a.device < b.device;
+  });
+  for (auto& build : builds)
+  {
+    total += build.seconds;
+    cl_build_status status = CL_BUILD_ERROR;
+    if (build.program)
+      clGetProgramBuildInfo(build.program, build.device_id, CL_PROGRAM_BUILD_STATUS, sizeof status, &status, NULL);
+    if (CL_SUCCESS == build.err && CL_BUILD_SUCCESS != status)
+      build.err = CL_BUILD_PROGRAM_FAILURE; /* reported through the callback */
+    size_t binary_size = 0;
+    if (CL_SUCCESS == build.err)
+      clGetProgramInfo(build.program, CL_PROGRAM_BINARY_SIZES, sizeof binary_size, &binary_size, NULL);
+
+    stringstream tag;
+    tag << paths[build.file];
+    if (!options[build.options].empty())
+      tag << " [" << options[build.options] << "]";
+    tag << " platform[" << build.platform << "] device[" << build.device << "]";
+    if (CL_SUCCESS == build.err)
+      printf("%s: ok, %10s, binary %s\n", tag.str().c_str(), format_seconds(build.seconds).c_str(),
+             format_bytes(binary_size).c_str());
+    else
+    {
+      ++failures;
+      printf("%s: FAILED, %10s: %s\n", tag.str().c_str(), format_seconds(build.seconds).c_str(), cl_error_str(build.err));
+    }
+    size_t log_size = 0;
+    if (build.program
+        && CL_SUCCESS == clGetProgramBuildInfo(build.program, build.device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size)
+        && log_size > 1)
+    {
+      vector<char> log(log_size);
+      clGetProgramBuildInfo(build.program, build.device_id, CL_PROGRAM_BUILD_LOG, log_size, log.data(), NULL);
+      stringstream lines(log.data());
+      for (string line; getline(lines, line); )
+        if (!line.empty())
+          printf("    %s\n", line.c_str());
+    }
+    if (build.program)
+      clReleaseProgram(build.program);
+  }
+  for (auto context : contexts)
+    clReleaseContext(context);
+
+  printf("%zu builds, %d failed, in %s with %u jobs (%s of compile time, %.1fx)\n", builds.size(), failures,
+         format_seconds(wall).c_str(), jobs, format_seconds(total).c_str(), wall > 0 ? total / wall : 0.0);
+  if (unreadable)
+    printf("%d .cl files could not be read\n", unreadable);
+  return failures || unreadable ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,347 @@
+/**
+ * extensions.cpp --
+ *
+ *      Interned extension names, extension sets and --has-extension.
+ *
+ *      The perfect hash is a seeded FNV-1a into a table of 16 slots per
+ *      known extension; table() tries seeds until no two known names
+ *      share a slot, which takes a few tries at that load.  A slot holds
+ *      the id of the one known name that can hash there, so a lookup is
+ *      a hash and one compare.  Names outside the table go to a map and
+ *      get the ids after the known ones.
+ *
+ *      The table is built once, thread-safely, and known names are looked
+ *      up without a lock.  Interning and looking up other names, and
+ *      name(), take the table's mutex, so sets can be built on any
+ *      thread: the watchdog collects on a worker, and libclinfo.so users
+ *      may collect from several.
+ */
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include "extensions.h"
+#include "icd.h"
+#include "inventory.h"
+
+using namespace std;
+
+#define KNOWN_EXTENSIONS                     \
+    def(cl_khr_3d_image_writes),             \
+    def(cl_khr_async_work_group_copy_fence), \
+    def(cl_khr_byte_addressable_store),      \
+    def(cl_khr_command_buffer),              \
+    def(cl_khr_create_command_queue),        \
+    def(cl_khr_d3d10_sharing),               \
+    def(cl_khr_d3d11_sharing),               \
+    def(cl_khr_depth_images),                \
+    def(cl_khr_device_uuid),                 \
+    def(cl_khr_dx9_media_sharing),           \
+    def(cl_khr_egl_event),                   \
+    def(cl_khr_egl_image),                   \
+    def(cl_khr_expect_assume),               \
+    def(cl_khr_extended_async_copies),       \
+    def(cl_khr_extended_bit_ops),            \
+    def(cl_khr_extended_versioning),         \
+    def(cl_khr_external_memory),             \
+    def(cl_khr_external_semaphore),          \
+    def(cl_khr_fp16),                        \
+    def(cl_khr_fp64),                        \
+    def(cl_khr_gl_depth_images),             \
+    def(cl_khr_gl_event),                    \
+    def(cl_khr_gl_msaa_sharing),             \
+    def(cl_khr_gl_sharing),                  \
+    def(cl_khr_global_int32_base_atomics),   \
+    def(cl_khr_global_int32_extended_atomics), \
+    def(cl_khr_icd),                         \
+    def(cl_khr_il_program),                  \
+    def(cl_khr_image2d_from_buffer),         \
+    def(cl_khr_initialize_memory),           \
+    def(cl_khr_int64_base_atomics),          \
+    def(cl_khr_int64_extended_atomics),      \
+    def(cl_khr_integer_dot_product),         \
+    def(cl_khr_local_int32_base_atomics),    \
+    def(cl_khr_local_int32_extended_atomics), \
+    def(cl_khr_mipmap_image),                \
+    def(cl_khr_mipmap_image_writes),         \
+    def(cl_khr_pci_bus_info),                \
+    def(cl_khr_priority_hints),              \
+    def(cl_khr_select_fprounding_mode),      \
+    def(cl_khr_semaphore),                   \
+    def(cl_khr_spir),                        \
+    def(cl_khr_srgb_image_writes),           \
+    def(cl_khr_subgroup_ballot),             \
+    def(cl_khr_subgroup_clustered_reduce),   \
+    def(cl_khr_subgroup_extended_types),     \
+    def(cl_khr_subgroup_named_barrier),      \
+    def(cl_khr_subgroup_non_uniform_arithmetic), \
+    def(cl_khr_subgroup_non_uniform_vote),   \
+    def(cl_khr_subgroup_rotate),             \
+    def(cl_khr_subgroup_shuffle),            \
+    def(cl_khr_subgroup_shuffle_relative),   \
+    def(cl_khr_subgroups),                   \
+    def(cl_khr_suggested_local_work_size),   \
+    def(cl_khr_terminate_context),           \
+    def(cl_khr_throttle_hints),              \
+    def(cl_khr_work_group_uniform_arithmetic), \
+    def(cl_ext_atomic_counters_32),          \
+    def(cl_ext_cxx_for_opencl),              \
+    def(cl_ext_device_fission),              \
+    def(cl_ext_float_atomics),               \
+    def(cl_ext_migrate_memobject),           \
+    def(cl_amd_device_attribute_query),      \
+    def(cl_amd_fp64),                        \
+    def(cl_amd_media_ops),                   \
+    def(cl_amd_media_ops2),                  \
+    def(cl_amd_printf),                      \
+    def(cl_arm_core_id),                     \
+    def(cl_arm_import_memory),               \
+    def(cl_arm_printf),                      \
+    def(cl_arm_shared_virtual_memory),       \
+    def(cl_intel_accelerator),               \
+    def(cl_intel_device_attribute_query),    \
+    def(cl_intel_media_block_io),            \
+    def(cl_intel_motion_estimation),         \
+    def(cl_intel_packed_yuv),                \
+    def(cl_intel_planar_yuv),                \
+    def(cl_intel_required_subgroup_size),    \
+    def(cl_intel_subgroups),                 \
+    def(cl_intel_subgroups_short),           \
+    def(cl_intel_unified_shared_memory),     \
+    def(cl_nv_compiler_options),             \
+    def(cl_nv_copy_opts),                    \
+    def(cl_nv_create_buffer),                \
+    def(cl_nv_device_attribute_query),       \
+    def(cl_nv_pragma_unroll),                \
+    def(cl_qcom_ext_host_ptr),
+
+namespace {
+
+const char* known[] = {
+#define def(X) #X
+  KNOWN_EXTENSIONS
+#undef def
+};
+
+const size_t NUM_KNOWN = sizeof known / sizeof known[0];
+
+struct Table {
+  uint32_t seed;
+  uint32_t mask;
+  vector<int16_t> slots;         /* known id, -1 if free */
+  mutex lock;                    /* names and others */
+  deque<string> names;           /* by id; a deque keeps name() references valid */
+  map<string, int> others;       /* interned after the known ones */
+};
+
+}
+
+static uint32_t hash_name(const char* s, size_t n, uint32_t seed)
+{
+  uint32_t h = 2166136261u ^ seed;
+  for (size_t ii = 0; ii < n; ++ii)
+    h = (h ^ (unsigned char) s[ii]) * 16777619u;
+  return h ^ (h >> 15);
+}
+
+/**
+ * table --
+ *
+ *      Finds a seed that maps the known names to distinct slots.
+ *
+ * Results:
+ *      the table, built on first use.
+ */
+static bool build_table(Table& t)
+{
+  size_t size = 1;
+  while (size < 16 * NUM_KNOWN)
+    size <<= 1;
+  t.mask = size - 1;
+  for (t.seed = 0; ; ++t.seed)
+  {
+    t.slots.assign(size, -1);
+    size_t id;
+    for (id = 0; id < NUM_KNOWN; ++id)
+    {
+      auto& slot = t.slots[hash_name(known[id], string(known[id]).size(), t.seed) & t.mask];
+      if (slot >= 0)
+        break;
+      slot = id;
+    }
+    if (NUM_KNOWN == id)
+      break;
+  }
+  t.names.assign(known, known + NUM_KNOWN);
+  return true;
+}
+
+static Table& table()
+{
+  static Table t;
+  /* Initialised once even when several threads get here first */
+  static bool built = build_table(t);
+  (void) built;
+  return t;
+}
+
+/* The id of a known name, -1 if it is not one; needs no lock. */
+static int known_id(const Table& t, const string& name)
+{
+  auto id = t.slots[hash_name(name.data(), name.size(), t.seed) & t.mask];
+  return id >= 0 && name == known[id] ? id : -1;
+}
+
+int Extension_set::lookup(const string& name)
+{
+  auto& t = table();
+  auto id = known_id(t, name);
+  if (id >= 0)
+    return id;
+  lock_guard<mutex> guard(t.lock);
+  auto other = t.others.find(name);
+  return other == t.others.end() ? -1 : other->second;
+}
+
+int Extension_set::intern(const string& name)
+{
+  auto& t = table();
+  auto id = known_id(t, name);
+  if (id >= 0)
+    return id;
+  lock_guard<mutex> guard(t.lock);
+  auto other = t.others.find(name);
+  if (other != t.others.end())
+    return other->second;
+  id = t.names.size();
+  t.names.push_back(name);
+  t.others[name] = id;
+  return id;
+}
+
+const string& Extension_set::name(int id)
+{
+  auto& t = table();
+  lock_guard<mutex> guard(t.lock);
+  return t.names[id];
+}
+
+Extension_set::Extension_set(const char* extensions)
+{
+  for (auto s = extensions; *s; )
+  {
+    while (isspace((unsigned char) *s))
+      ++s;
+    auto end = s;
+    while (*end && !isspace((unsigned char) *end))
+      ++end;
+    if (end > s)
+      insert(intern(string(s, end)));
+    s = end;
+  }
+}
+
+void Extension_set::insert(int id)
+{
+  if (bits.size() <= (size_t) id / 64)
+    bits.resize(id / 64 + 1);
+  bits[id / 64] |= uint64_t(1) << (id % 64);
+}
+
+bool Extension_set::has(int id) const
+{
+  return id >= 0 && (size_t) id / 64 < bits.size() && (bits[id / 64] >> (id % 64) & 1);
+}
+
+bool Extension_set::contains(const Extension_set& other) const
+{
+  for (size_t ii = 0; ii < other.bits.size(); ++ii)
+    if (other.bits[ii] & ~(ii < bits.size() ? bits[ii] : 0))
+      return false;
+  return true;
+}
+
+vector<string> Extension_set::names() const
+{
+  vector<string> r;
+  for (size_t ii = 0; ii < bits.size() * 64; ++ii)
+    if (has(ii))
+      r.push_back(name(ii));
+  sort(r.begin(), r.end());
+  return r;
+}
+
+bool device_extensions(cl_device_id device, Extension_set& set)
+{
+  size_t size;
+  if (CL_SUCCESS != icd_get_device_info(device, CL_DEVICE_EXTENSIONS, 0, NULL, &size))
+    return false;
+  vector<char> buf(size + 1);
+  if (CL_SUCCESS != icd_get_device_info(device, CL_DEVICE_EXTENSIONS, size, buf.data(), NULL))
+    return false;
+  set = Extension_set(buf.data());
+  return true;
+}
+
+int has_extensions(const vector<string>& names, cl_device_type type)
+{
+  Extension_set wanted;
+  for (auto& name : names)
+    wanted.insert(Extension_set::intern(name));
+
+  auto enumeration = enumerate_devices();
+  if (CL_SUCCESS != enumeration.status)
+  {
+    report_enumeration(enumeration);
+    return EXIT_QUERY_FAILED;
+  }
+  auto matches = 0, failures = 0;
+  for (size_t ii = 0; ii < enumeration.platforms.size(); ++ii)
+  {
+    /* Keep the indices of the full dump, whatever the type */
+    auto& platform = enumeration.platforms[ii];
+    if (CL_SUCCESS != platform.devices_status)
+    {
+      fprintf(stderr, "platform[%zu]: Unable to %s: %s!\n", ii, platform.devices_failed,
+              cl_error_str(platform.devices_status));
+      ++failures;
+      continue;
+    }
+    auto& devices = platform.devices;
+    for (size_t jj = 0; jj < devices.size(); ++jj)
+    {
+      cl_device_type device_type = 0;
+      Extension_set set;
+      if (CL_SUCCESS != icd_get_device_info(devices[jj], CL_DEVICE_TYPE, sizeof device_type, &device_type, NULL))
+      {
+        fprintf(stderr, "platform[%zu] device[%zu]: Unable to get TYPE!\n", ii, jj);
+        ++failures;
+        continue;
+      }
+      if (!(device_type & type))
+        continue;
+      if (!device_extensions(devices[jj], set))
+      {
+        fprintf(stderr, "platform[%zu] device[%zu]: Unable to get EXTENSIONS!\n", ii, jj);
+        ++failures;
+        continue;
+      }
+      if (set.contains(wanted))
+      {
+        char name[256] = "";
+        icd_get_device_info(devices[jj], CL_DEVICE_NAME, sizeof name, name, NULL);
+        name[sizeof name - 1] = '\0';
+        printf("platform[%zu] device[%zu]: %s\n", ii, jj, name);
+        ++matches;
+      }
+    }
+  }
+  /* Without a match, a device that could not be queried leaves the answer open */
+  if (matches)
+    return EXIT_SUCCESS;
+  return failures ? EXIT_QUERY_FAILED : EXIT_FAILURE;
+}
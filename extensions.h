@@ -0,0 +1,57 @@
+/**
+ * extensions.h --
+ *
+ *      Device extension strings parsed once into sets of interned ids.
+ *
+ *      The cl_* extensions clinfo knows about get fixed ids from a
+ *      perfect hash table built at first use, so looking one up costs a
+ *      hash and a single string compare; others are interned on the fly
+ *      after them.  A set is a bitset over those ids, so testing a set
+ *      for an extension is a bit test.
+ */
+#ifndef CLINFO_EXTENSIONS_H
+#define CLINFO_EXTENSIONS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "clinfo.h"
+
+class Extension_set {
+
+public:
+
+  /* The id of an extension name, -1 if it was never interned; thread-safe. */
+  static int lookup(const std::string& name);
+  static int intern(const std::string& name);
+  static const std::string& name(int id);
+
+  Extension_set() {}
+  /* Parses a space separated CL_*_EXTENSIONS string. */
+  explicit Extension_set(const char* extensions);
+
+  void insert(int id);
+  bool has(int id) const;
+  bool has(const std::string& name) const { return has(lookup(name)); }
+  bool contains(const Extension_set& other) const;
+  /* The names in the set, sorted. */
+  std::vector<std::string> names() const;
+
+private:
+  std::vector<uint64_t> bits;
+};
+
+/* Reads and parses the CL_DEVICE_EXTENSIONS of a device. */
+bool device_extensions(cl_device_id device, Extension_set& set);
+
+#define EXIT_QUERY_FAILED 4 /* the answer is unknown, some platform or device could not be queried */
+
+/*
+ * Prints the devices of the given type that have all the extensions,
+ * returning EXIT_SUCCESS if there are any, EXIT_FAILURE if there are
+ * none and EXIT_QUERY_FAILED if there are none among the devices that
+ * could be queried.
+ */
+int has_extensions(const std::vector<std::string>& names, cl_device_type type);
+
+#endif
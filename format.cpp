@@ -0,0 +1,59 @@
+/**
+ * format.cpp --
+ *
+ *      Host clock and text helpers shared by clinfo and libclinfo.so.
+ */
+#include <chrono>
+#include <cstdio>
+#include "format.h"
+
+using namespace std;
+
+double host_seconds()
+{
+  auto now = chrono::steady_clock::now().time_since_epoch();
+  return chrono::duration_cast<chrono::duration<double>>(now).count();
+}
+
+string format_bytes(uint64_t bytes)
+{
+  static const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+  double val = bytes;
+  int unit = 0;
+  while (val >= 1024 && unit < 4)
+  {
+    val /= 1024;
+    ++unit;
+  }
+  char buf[32];
+  snprintf(buf, sizeof buf, unit ? "%.2f %s" : "%.0f %s", val, units[unit]);
+  return buf;
+}
+
+string json_escape(const string& s)
+{
+  string r;
+  for (auto c : s)
+  {
+    if ('"' == c || '\\' == c)
+      r += '\\';
+    if ((unsigned char) c < 0x20)
+      c = ' ';
+    r += c;
+  }
+  return r;
+}
+
+string format_seconds(double seconds)
+{
+  static const char* units[] = {"s", "ms", "us", "ns"};
+  int unit = 0;
+  while (seconds < 1.0 && seconds > 0.0 && unit < 3)
+  {
+    seconds *= 1000;
+    ++unit;
+  }
+  char buf[32];
+  snprintf(buf, sizeof buf, "%.2f %s", seconds, units[unit]);
+  return buf;
+}
@@ -0,0 +1,23 @@
+/**
+ * format.h --
+ *
+ *      Host clock and text helpers that need no OpenCL, shared by the
+ *      benchmarks and by libclinfo.so.
+ */
+#ifndef CLINFO_FORMAT_H
+#define CLINFO_FORMAT_H
+
+#include <cstdint>
+#include <string>
+
+/* Monotonic host clock. */
+double host_seconds();
+
+/* Human readable size with a binary unit, e.g. "1.50 GiB". */
+std::string format_bytes(uint64_t bytes);
+/* Human readable duration, e.g. "12.34 us". */
+std::string format_seconds(double seconds);
+/* The contents of a JSON string literal; control characters become spaces. */
+std::string json_escape(const std::string& s);
+
+#endif
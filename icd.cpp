@@ -0,0 +1,221 @@
+/**
+ * icd.cpp --
+ *
+ *      Direct loading of vendor libraries, see icd.h.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fnmatch.h>
+#include <fstream>
+#include <iostream>
+#include "icd.h"
+#include "timeline.h"
+
+using namespace std;
+
+#ifndef CL_PLATFORM_NOT_FOUND_KHR
+#define CL_PLATFORM_NOT_FOUND_KHR -1001 /* cl_ext.h */
+#endif
+
+/*
+ * The start of the cl_khr_icd dispatch table, as far as the collection
+ * needs it.  The order is fixed by the extension; the unused entries
+ * only keep the used ones in place.
+ */
+struct Icd_dispatch {
+  void* clGetPlatformIDs;
+  cl_int (CL_API_CALL *clGetPlatformInfo)(cl_platform_id, cl_platform_info, size_t, void*, size_t*);
+  cl_int (CL_API_CALL *clGetDeviceIDs)(cl_platform_id, cl_device_type, cl_uint, cl_device_id*, cl_uint*);
+  cl_int (CL_API_CALL *clGetDeviceInfo)(cl_device_id, cl_device_info, size_t, void*, size_t*);
+  cl_context (CL_API_CALL *clCreateContext)(const cl_context_properties*, cl_uint, const cl_device_id*,
+                                            void (CL_CALLBACK*)(const char*, const void*, size_t, void*),
+                                            void*, cl_int*);
+  void* clCreateContextFromType;
+  void* clRetainContext;
+  cl_int (CL_API_CALL *clReleaseContext)(cl_context);
+  void* clGetContextInfo;
+  void* clCreateCommandQueue;
+  void* clRetainCommandQueue;
+  void* clReleaseCommandQueue;
+  void* clGetCommandQueueInfo;
+  void* clSetCommandQueueProperty;
+  void* clCreateBuffer;
+  void* clCreateImage2D;
+  void* clCreateImage3D;
+  void* clRetainMemObject;
+  void* clReleaseMemObject;
+  cl_int (CL_API_CALL *clGetSupportedImageFormats)(cl_context, cl_mem_flags, cl_mem_object_type, cl_uint,
+                                                   cl_image_format*, cl_uint*);
+};
+
+typedef cl_int (CL_API_CALL *Icd_get_platform_ids)(cl_uint, cl_platform_id*, cl_uint*);
+typedef void* (CL_API_CALL *Get_extension_function_address)(const char*);
+
+namespace {
+
+bool direct;
+vector<cl_platform_id> platforms;
+
+}
+
+/* Every ICD object starts with its dispatch table. */
+template <typename T>
+static const Icd_dispatch* dispatch(T object)
+{
+  return *reinterpret_cast<const Icd_dispatch* const*>(object);
+}
+
+vector<string> icd_libraries(const string& glob)
+{
+  auto vendors = getenv("OCL_ICD_VENDORS");
+  string dir = vendors && *vendors ? vendors : ICD_VENDORS;
+  vector<string> names, libraries;
+  if (auto d = opendir(dir.c_str()))
+  {
+    while (auto entry = readdir(d))
+    {
+      string name = entry->d_name;
+      if (name.size() > 4 && 0 == name.compare(name.size() - 4, 4, ".icd") &&
+          0 == fnmatch(glob.c_str(), name.c_str(), 0))
+        names.push_back(name);
+    }
+    closedir(d);
+  }
+  sort(names.begin(), names.end());
+  for (auto& name : names)
+  {
+    ifstream in(dir + "/" + name);
+    string library;
+    if (getline(in, library))
+    {
+      library.erase(library.find_last_not_of(" \t\r") + 1);
+      library.erase(0, library.find_first_not_of(" \t"));
+      if (!library.empty())
+        libraries.push_back(library);
+    }
+  }
+  return libraries;
+}
+
+/**
+ * open_library --
+ *
+ *      dlopens a vendor library and appends its platforms and handle.
+ *
+ * Results:
+ *      false after printing why the library is unusable.
+ */
+static bool open_library(const string& path, vector<cl_platform_id>& found, vector<void*>& handles)
+{
+  Timeline_scope scope(path, "icd");
+  auto handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!handle)
+  {
+    cerr << "Unable to load " << path << ": " << dlerror() << "!" << endl;
+    return false;
+  }
+  /* As the loader does: through clGetExtensionFunctionAddress, else exported */
+  Icd_get_platform_ids get_platform_ids = nullptr;
+  if (auto lookup = reinterpret_cast<Get_extension_function_address>(dlsym(handle, "clGetExtensionFunctionAddress")))
+    get_platform_ids = reinterpret_cast<Icd_get_platform_ids>(lookup("clIcdGetPlatformIDsKHR"));
+  if (!get_platform_ids)
+    get_platform_ids = reinterpret_cast<Icd_get_platform_ids>(dlsym(handle, "clIcdGetPlatformIDsKHR"));
+  if (!get_platform_ids)
+  {
+    cerr << path << " is not an ICD, it has no clIcdGetPlatformIDsKHR!" << endl;
+    dlclose(handle);
+    return false;
+  }
+  cl_uint num_platforms = 0;
+  auto err = get_platform_ids(0, nullptr, &num_platforms);
+  vector<cl_platform_id> ids(num_platforms);
+  if (CL_SUCCESS == err && num_platforms)
+    err = get_platform_ids(num_platforms, ids.data(), nullptr);
+  if (CL_SUCCESS != err && CL_PLATFORM_NOT_FOUND_KHR != err)
+  {
+    cerr << path << ": Unable to enumerate the platforms: " << cl_error_str(err) << "!" << endl;
+    dlclose(handle);
+    return false;
+  }
+  if (CL_SUCCESS == err)
+    found.insert(found.end(), ids.begin(), ids.end());
+  handles.push_back(handle);
+  return true;
+}
+
+bool icd_open(const vector<string>& libraries)
+{
+  vector<cl_platform_id> found;
+  vector<void*> handles;
+  for (auto& library : libraries)
+    if (!open_library(library, found, handles))
+    {
+      for (auto handle : handles)
+        dlclose(handle);
+      return false;
+    }
+  platforms = found;
+  direct = true;
+  return true;
+}
+
+cl_int icd_get_platform_ids(cl_uint num_entries, cl_platform_id* ids, cl_uint* num_platforms)
+{
+  if (!direct)
+    return clGetPlatformIDs(num_entries, ids, num_platforms);
+  if ((0 == num_entries && ids) || (!ids && !num_platforms))
+    return CL_INVALID_VALUE;
+  if (num_platforms)
+    *num_platforms = platforms.size();
+  for (cl_uint ii = 0; ids && ii < num_entries && ii < platforms.size(); ++ii)
+    ids[ii] = platforms[ii];
+  return CL_SUCCESS;
+}
+
+cl_int icd_get_platform_info(cl_platform_id platform, cl_platform_info param, size_t size, void* value,
+                             size_t* size_ret)
+{
+  if (!direct)
+    return clGetPlatformInfo(platform, param, size, value, size_ret);
+  return dispatch(platform)->clGetPlatformInfo(platform, param, size, value, size_ret);
+}
+
+cl_int icd_get_device_ids(cl_platform_id platform, cl_device_type type, cl_uint num_entries,
+                          cl_device_id* devices, cl_uint* num_devices)
+{
+  if (!direct)
+    return clGetDeviceIDs(platform, type, num_entries, devices, num_devices);
+  return dispatch(platform)->clGetDeviceIDs(platform, type, num_entries, devices, num_devices);
+}
+
+cl_int icd_get_device_info(cl_device_id device, cl_device_info param, size_t size, void* value,
+                           size_t* size_ret)
+{
+  if (!direct)
+    return clGetDeviceInfo(device, param, size, value, size_ret);
+  return dispatch(device)->clGetDeviceInfo(device, param, size, value, size_ret);
+}
+
+cl_context icd_create_context(cl_device_id device, cl_int* err)
+{
+  if (!direct)
+    return clCreateContext(NULL, 1, &device, NULL, NULL, err);
+  return dispatch(device)->clCreateContext(NULL, 1, &device, NULL, NULL, err);
+}
+
+cl_int icd_release_context(cl_context context)
+{
+  if (!direct)
+    return clReleaseContext(context);
+  return dispatch(context)->clReleaseContext(context);
+}
+
+cl_int icd_get_supported_image_formats(cl_context context, cl_mem_flags flags, cl_mem_object_type type,
+                                       cl_uint num_entries, cl_image_format* formats, cl_uint* num_formats)
+{
+  if (!direct)
+    return clGetSupportedImageFormats(context, flags, type, num_entries, formats, num_formats);
+  return dispatch(context)->clGetSupportedImageFormats(context, flags, type, num_entries, formats, num_formats);
+}
@@ -0,0 +1,42 @@
+/**
+ * icd.h --
+ *
+ *      Vendor libraries loaded without the ICD loader.  The first call
+ *      into the loader makes it dlopen and initialise every library
+ *      listed in /etc/OpenCL/vendors, however slow or irrelevant;
+ *      icd_open() loads only the given libraries, takes their platforms
+ *      from clIcdGetPlatformIDsKHR, and the icd_*() entry points below
+ *      then call through the dispatch table at the start of every object
+ *      the way the loader itself does.  Until icd_open() succeeds they
+ *      are the loader's functions.  Every mode enumerates through them;
+ *      the calls they do not cover, such as the contexts and kernels of
+ *      the benchmarks, go through the loader's entry points, which
+ *      dispatch on the object the same way.
+ */
+#ifndef CLINFO_ICD_H
+#define CLINFO_ICD_H
+
+#include <string>
+#include <vector>
+#include "clinfo.h"
+
+#define ICD_VENDORS "/etc/OpenCL/vendors" /* unless OCL_ICD_VENDORS names another */
+
+/* The libraries named by the .icd files whose file name matches glob. */
+std::vector<std::string> icd_libraries(const std::string& glob);
+/* Loads the libraries, all or none; false after printing why. */
+bool icd_open(const std::vector<std::string>& libraries);
+
+cl_int icd_get_platform_ids(cl_uint num_entries, cl_platform_id* platforms, cl_uint* num_platforms);
+cl_int icd_get_platform_info(cl_platform_id platform, cl_platform_info param, size_t size, void* value,
+                             size_t* size_ret);
+cl_int icd_get_device_ids(cl_platform_id platform, cl_device_type type, cl_uint num_entries,
+                          cl_device_id* devices, cl_uint* num_devices);
+cl_int icd_get_device_info(cl_device_id device, cl_device_info param, size_t size, void* value,
+                           size_t* size_ret);
+cl_context icd_create_context(cl_device_id device, cl_int* err);
+cl_int icd_release_context(cl_context context);
+cl_int icd_get_supported_image_formats(cl_context context, cl_mem_flags flags, cl_mem_object_type type,
+                                       cl_uint num_entries, cl_image_format* formats, cl_uint* num_formats);
+
+#endif
@@ -0,0 +1,607 @@
+/**
+ * inventory.cpp --
+ *
+ *      The collection pass: one query per property, in the order of the
+ *      dump, each recorded on the timeline under the property name.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include "icd.h"
+#include "inventory.h"
+#include "timeline.h"
+#include "watchdog.h"
+
+using namespace std;
+
+namespace {
+
+unsigned timeout_ms;
+unique_ptr<Watchdog> watchdog;
+bool hung; /* a call for the device or platform being collected timed out */
+
+}
+
+void collect_timeout(unsigned ms)
+{
+  timeout_ms = ms;
+  watchdog.reset(ms ? new Watchdog(ms) : nullptr);
+}
+
+/**
+ * guarded --
+ *
+ *      Makes a driver call that fills up to size bytes at value.  With a
+ *      timeout it runs on the watchdog's worker, into scratch memory the
+ *      call keeps alive, so a call given up on never writes into the
+ *      inventory; after that the device or platform gets no more calls.
+ *
+ * Results:
+ *      the OpenCL status, CLINFO_TIMED_OUT or CLINFO_SKIPPED.
+ */
+static cl_int guarded(void* value, size_t size, size_t* size_ret, const function<cl_int(void*, size_t*)>& call)
+{
+  if (hung)
+    return CLINFO_SKIPPED;
+  if (!watchdog)
+    return call(value, size_ret);
+  struct Scratch { vector<char> value; size_t size_ret; cl_int status; };
+  auto scratch = make_shared<Scratch>();
+  scratch->value.resize(size);
+  scratch->size_ret = 0;
+  scratch->status = CL_SUCCESS;
+  if (!watchdog->run([scratch, call] { scratch->status = call(scratch->value.data(), &scratch->size_ret); }))
+  {
+    hung = true;
+    return CLINFO_TIMED_OUT;
+  }
+  if (size)
+    memcpy(value, scratch->value.data(), size);
+  if (size_ret)
+    *size_ret = scratch->size_ret;
+  return scratch->status;
+}
+
+static cl_int get_device_info(cl_device_id device, cl_device_info param, size_t size, void* value, size_t* size_ret)
+{
+  return guarded(value, size, size_ret, [=](void* v, size_t* r) { return icd_get_device_info(device, param, size, v, r); });
+}
+
+static cl_int get_platform_info(cl_platform_id platform, cl_platform_info param, size_t size, void* value,
+                                size_t* size_ret)
+{
+  return guarded(value, size, size_ret,
+                 [=](void* v, size_t* r) { return icd_get_platform_info(platform, param, size, v, r); });
+}
+
+static cl_int get_device_ids(cl_platform_id platform, cl_uint num_entries, cl_device_id* devices, cl_uint* num_devices)
+{
+  if (!devices)
+    return guarded(num_devices, sizeof *num_devices, nullptr, [=](void* v, size_t*)
+    {
+      return icd_get_device_ids(platform, CL_DEVICE_TYPE_ALL, 0, nullptr, static_cast<cl_uint*>(v));
+    });
+  return guarded(devices, num_entries * sizeof *devices, nullptr, [=](void* v, size_t*)
+  {
+    return icd_get_device_ids(platform, CL_DEVICE_TYPE_ALL, num_entries, static_cast<cl_device_id*>(v), nullptr);
+  });
+}
+
+static cl_int get_platform_ids(cl_uint num_entries, cl_platform_id* platforms, cl_uint* num_platforms)
+{
+  if (!platforms)
+    return guarded(num_platforms, sizeof *num_platforms, nullptr, [=](void* v, size_t*)
+    {
+      return icd_get_platform_ids(0, nullptr, static_cast<cl_uint*>(v));
+    });
+  return guarded(platforms, num_entries * sizeof *platforms, nullptr, [=](void* v, size_t*)
+  {
+    return icd_get_platform_ids(num_entries, static_cast<cl_platform_id*>(v), nullptr);
+  });
+}
+
+static cl_context create_context(cl_device_id device, cl_int* err)
+{
+  cl_context context = nullptr;
+  *err = guarded(&context, sizeof context, nullptr, [=](void* v, size_t*)
+  {
+    cl_int status;
+    *static_cast<cl_context*>(v) = icd_create_context(device, &status);
+    return status;
+  });
+  return context;
+}
+
+static cl_int get_supported_image_formats(cl_context context, cl_uint num_entries, cl_image_format* formats,
+                                          cl_uint* num_formats)
+{
+  if (!formats)
+    return guarded(num_formats, sizeof *num_formats, nullptr, [=](void* v, size_t*)
+    {
+      return icd_get_supported_image_formats(context, CL_MEM_READ_ONLY, CL_MEM_OBJECT_IMAGE2D, 0, nullptr,
+                                             static_cast<cl_uint*>(v));
+    });
+  return guarded(formats, num_entries * sizeof *formats, nullptr, [=](void* v, size_t*)
+  {
+    return icd_get_supported_image_formats(context, CL_MEM_READ_ONLY, CL_MEM_OBJECT_IMAGE2D, num_entries,
+                                           static_cast<cl_image_format*>(v), nullptr);
+  });
+}
+
+static cl_int release_context(cl_context context)
+{
+  return guarded(nullptr, 0, nullptr, [=](void*, size_t*) { return icd_release_context(context); });
+}
+
+/**
+ * query --
+ *
+ *      clGetDeviceInfo into a Field, recorded on the timeline.
+ *
+ * Results:
+ *      void.
+ */
+static void query(const char* name, cl_device_id device, cl_device_info param, Field<uint64_t>& field)
+{
+  Timeline_scope scope(name, "query");
+  field.value = 0; /* Narrower params fill only the low bytes */
+  field.status = get_device_info(device, param, sizeof field.value, &field.value, &field.size);
+}
+
+static void query(const char* name, cl_device_id device, cl_device_info param, Field<string>& field,
+                  vector<char>& buf)
+{
+  Timeline_scope scope(name, "query");
+  field.status = get_device_info(device, param, buf.size(), buf.data(), &field.size);
+  if (field.ok())
+  {
+    buf.back() = '\0';
+    field.value = buf.data();
+  }
+}
+
+void collect_image_formats(Device& d)
+{
+  Timeline_scope scope("IMAGE FORMATS", "query");
+  auto& field = d.IMAGE_FORMATS;
+  cl_uint num_image_formats;
+  d.image_formats_collected = true;
+  d.image_formats_release = CL_SUCCESS;
+  auto context = create_context(d.id, &field.status);
+  if (!field.ok())
+  {
+    d.image_formats_failed = "create context";
+    return;
+  }
+  field.status = get_supported_image_formats(context, 0, NULL, &num_image_formats);
+  if (!field.ok())
+    d.image_formats_failed = "get number of supported image formats";
+  else
+  {
+    field.value.resize(num_image_formats);
+    field.size = num_image_formats * sizeof(cl_image_format);
+    field.status = get_supported_image_formats(context, num_image_formats, field.value.data(), NULL);
+    if (!field.ok())
+    {
+      d.image_formats_failed = "get supported image formats";
+      field.value.clear();
+    }
+  }
+  d.image_formats_release = release_context(context);
+}
+
+Device collect_device(int index, cl_device_id id, bool image_formats)
+{
+  Timeline_scope scope("device[" + to_string(index) + "]", "collect");
+  vector<char> buf(INVENTORY_STRING);
+  Device d;
+  hung = false;
+  d.id = id;
+  d.image_formats_collected = false;
+  d.image_formats_failed = nullptr;
+  d.image_formats_release = CL_SUCCESS;
+
+  query("TYPE", id, CL_DEVICE_TYPE, d.TYPE);
+#define def(X) query(#X, id, CL_DEVICE_##X, d.X, buf);
+  STR_PROPS
+#undef def
+  query("DRIVER_VERSION", id, CL_DRIVER_VERSION, d.DRIVER_VERSION, buf);
+  query("EXTENSIONS", id, CL_DEVICE_EXTENSIONS, d.EXTENSIONS, buf);
+  if (d.EXTENSIONS.ok())
+    d.extension_set = Extension_set(d.EXTENSIONS.value.c_str());
+  query("EXECUTION_CAPABILITIES", id, CL_DEVICE_EXECUTION_CAPABILITIES, d.EXECUTION_CAPABILITIES);
+  query("GLOBAL_MEM_CACHE_TYPE", id, CL_DEVICE_GLOBAL_MEM_CACHE_TYPE, d.GLOBAL_MEM_CACHE_TYPE);
+  query("LOCAL_MEM_TYPE", id, CL_DEVICE_LOCAL_MEM_TYPE, d.LOCAL_MEM_TYPE);
+#define def(X) query(#X, id, CL_DEVICE_##X, d.X);
+  HEX_PROPS
+  LONG_PROPS
+#undef def
+
+  {
+    Timeline_scope scope("MAX_WORK_ITEM_SIZES", "query");
+    vector<size_t> sizes(d.MAX_WORK_ITEM_DIMENSIONS.ok() ? max<uint64_t>(3, d.MAX_WORK_ITEM_DIMENSIONS.value) : 3);
+    auto& field = d.MAX_WORK_ITEM_SIZES;
+    field.status = get_device_info(id, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizes.size() * sizeof sizes[0], sizes.data(),
+                                   &field.size);
+    if (field.ok())
+      field.value.assign(sizes.begin(), sizes.begin() + min(sizes.size(), field.size / sizeof sizes[0]));
+  }
+#ifdef CL_VERSION_1_2
+  query("PARTITION_MAX_SUB_DEVICES", id, CL_DEVICE_PARTITION_MAX_SUB_DEVICES, d.PARTITION_MAX_SUB_DEVICES);
+  d.PARTITION_MAX_SUB_DEVICES.value &= 0xffffffff; /* cl_uint */
+  {
+    Timeline_scope scope("PARTITION_PROPERTIES", "query");
+    cl_device_partition_property props[16];
+    auto& field = d.PARTITION_PROPERTIES;
+    field.status = get_device_info(id, CL_DEVICE_PARTITION_PROPERTIES, sizeof props, props, &field.size);
+    for (size_t ii = 0; field.ok() && ii < field.size / sizeof props[0] && ii < sizeof props / sizeof props[0]; ++ii)
+      field.value.push_back(props[ii]);
+  }
+  query("PARTITION_AFFINITY_DOMAIN", id, CL_DEVICE_PARTITION_AFFINITY_DOMAIN, d.PARTITION_AFFINITY_DOMAIN);
+#endif
+#ifdef CL_VERSION_2_0
+  query("SVM_CAPABILITIES", id, CL_DEVICE_SVM_CAPABILITIES, d.SVM_CAPABILITIES);
+#endif
+  if (image_formats)
+    collect_image_formats(d);
+  return d;
+}
+
+/**
+ * collect_device_ids --
+ *
+ *      Enumerates the devices of a platform, recording the status and
+ *      the step that failed.
+ *
+ * Results:
+ *      the devices.
+ */
+static vector<cl_device_id> collect_device_ids(cl_platform_id id, cl_int& status, const char*& failed)
+{
+  Timeline_scope scope("clGetDeviceIDs", "query");
+  vector<cl_device_id> device_ids;
+  cl_uint num_devices;
+  status = get_device_ids(id, 0, NULL, &num_devices);
+  if (CL_SUCCESS != status)
+    failed = "query the number of devices";
+  else
+  {
+    device_ids.resize(num_devices);
+    status = get_device_ids(id, num_devices, device_ids.data(), NULL);
+    if (CL_SUCCESS != status)
+    {
+      failed = "enumerate the devices";
+      device_ids.clear();
+    }
+  }
+  return device_ids;
+}
+
+/**
+ * collect_platform --
+ *
+ *      Queries a platform and its devices.
+ *
+ * Results:
+ *      the platform.
+ */
+static Platform collect_platform(int index, cl_platform_id id, bool image_formats)
+{
+  Timeline_scope scope("platform[" + to_string(index) + "]", "collect");
+  vector<char> buf(INVENTORY_STRING);
+  Platform p;
+  hung = false;
+  p.id = id;
+  p.devices_status = CL_SUCCESS;
+  p.devices_failed = nullptr;
+  p.crash_signal = 0;
+
+  static struct { cl_platform_info param; Field<string> Platform::*field; const char* name; } props[] = {
+    { CL_PLATFORM_NAME,       &Platform::name,       "name"       },
+    { CL_PLATFORM_VENDOR,     &Platform::vendor,     "vendor"     },
+    { CL_PLATFORM_PROFILE,    &Platform::profile,    "profile"    },
+    { CL_PLATFORM_VERSION,    &Platform::version,    "version"    },
+    { CL_PLATFORM_EXTENSIONS, &Platform::extensions, "extensions" },
+  };
+  for (auto& prop : props)
+  {
+    Timeline_scope scope(prop.name, "query");
+    auto& field = p.*prop.field;
+    field.status = get_platform_info(id, prop.param, buf.size(), buf.data(), &field.size);
+    if (field.ok())
+    {
+      buf.back() = '\0';
+      field.value = buf.data();
+    }
+  }
+
+  auto device_ids = collect_device_ids(id, p.devices_status, p.devices_failed);
+  for (size_t ii = 0; ii < device_ids.size(); ++ii)
+    p.devices.push_back(collect_device(ii, device_ids[ii], image_formats));
+  return p;
+}
+
+/**
+ * collect_platform_ids --
+ *
+ *      Enumerates the platforms, recording the status in the inventory.
+ *
+ * Results:
+ *      the platforms.
+ */
+static vector<cl_platform_id> collect_platform_ids(cl_int& status, const char*& failed)
+{
+  hung = false;
+  failed = nullptr;
+  vector<cl_platform_id> platform_ids;
+  {
+    Timeline_scope scope("clGetPlatformIDs", "query");
+    cl_uint num_platforms;
+    status = get_platform_ids(0, NULL, &num_platforms);
+    if (CL_SUCCESS != status)
+      failed = "query the number of platforms";
+    else
+    {
+      platform_ids.resize(num_platforms);
+      status = get_platform_ids(num_platforms, platform_ids.data(), nullptr);
+      if (CL_SUCCESS != status)
+      {
+        failed = "enumerate the platforms";
+        platform_ids.clear();
+      }
+    }
+  }
+  return platform_ids;
+}
+
+static vector<cl_platform_id> collect_platform_ids(Inventory& inventory)
+{
+  return collect_platform_ids(inventory.status, inventory.failed);
+}
+
+Enumeration enumerate_devices()
+{
+  Enumeration enumeration;
+  auto platform_ids = collect_platform_ids(enumeration.status, enumeration.failed);
+  for (auto id : platform_ids)
+  {
+    Enumerated_platform p;
+    p.id = id;
+    p.devices_failed = nullptr;
+    hung = false;
+    p.devices = collect_device_ids(id, p.devices_status, p.devices_failed);
+    if (CL_DEVICE_NOT_FOUND == p.devices_status)
+    {
+      p.devices_status = CL_SUCCESS;
+      p.devices_failed = nullptr;
+    }
+    enumeration.platforms.push_back(p);
+  }
+  return enumeration;
+}
+
+bool report_enumeration(const Enumeration& enumeration)
+{
+  if (CL_SUCCESS != enumeration.status)
+  {
+    fprintf(stderr, "Unable to %s: %s!\n", enumeration.failed, cl_error_str(enumeration.status));
+    return false;
+  }
+  auto ok = true;
+  for (size_t ii = 0; ii < enumeration.platforms.size(); ++ii)
+    if (CL_SUCCESS != enumeration.platforms[ii].devices_status)
+    {
+      fprintf(stderr, "platform[%zu]: Unable to %s: %s!\n", ii, enumeration.platforms[ii].devices_failed,
+              cl_error_str(enumeration.platforms[ii].devices_status));
+      ok = false;
+    }
+  return ok;
+}
+
+Inventory collect_inventory(bool image_formats)
+{
+  Inventory inventory;
+  auto platform_ids = collect_platform_ids(inventory);
+  for (size_t ii = 0; ii < platform_ids.size(); ++ii)
+    inventory.platforms.push_back(collect_platform(ii, platform_ids[ii], image_formats));
+  return inventory;
+}
+
+namespace {
+
+/* A child process of collect_inventory_isolated() and what it sent. */
+struct Child {
+  pid_t pid;
+  int fd;
+  vector<char> data;
+  int status;
+};
+
+}
+
+/**
+ * spawn --
+ *
+ *      Forks a child that runs collect and writes the result to a pipe
+ *      as a snapshot.  The child makes every driver call itself, so the
+ *      parent never loads or initialises a driver it could inherit.
+ *
+ * Results:
+ *      false if the child could not be started.
+ */
+static bool spawn(const function<Inventory()>& collect, Child& child)
+{
+  int fds[2];
+  child.pid = -1;
+  child.fd = -1;
+  child.status = 0;
+  if (0 != pipe(fds))
+    return false;
+  fflush(nullptr);
+  child.pid = fork();
+  if (0 == child.pid)
+  {
+    close(fds[0]);
+    /* The parent's worker thread did not come along */
+    collect_timeout(timeout_ms);
+    auto part = collect();
+    auto file = fdopen(fds[1], "wb");
+    auto ok = file && snapshot_write(part, file) && 0 == fclose(file);
+    _exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  close(fds[1]);
+  if (child.pid < 0)
+  {
+    close(fds[0]);
+    return false;
+  }
+  child.fd = fds[0];
+  return true;
+}
+
+/**
+ * drain --
+ *
+ *      Reads what the children send, one thread per child so the time
+ *      taken is that of the slowest, and waits for them to exit.  The
+ *      threads only copy bytes: decoding interns extension names and
+ *      failed steps, which is left to the caller's thread.
+ *
+ * Results:
+ *      void, the data and exit status are in the children.
+ */
+static void drain(vector<Child>& children)
+{
+  vector<thread> readers;
+  for (auto& child : children)
+    if (child.fd >= 0)
+      readers.emplace_back([&child]
+      {
+        char buf[65536];
+        ssize_t n;
+        while ((n = read(child.fd, buf, sizeof buf)) > 0 || (n < 0 && EINTR == errno))
+          if (n > 0)
+            child.data.insert(child.data.end(), buf, buf + n);
+      });
+  for (auto& reader : readers)
+    reader.join();
+  for (auto& child : children)
+  {
+    if (child.fd >= 0)
+      close(child.fd);
+    if (child.pid > 0)
+      while (waitpid(child.pid, &child.status, 0) < 0)
+        if (EINTR != errno)
+        {
+          child.pid = -1;
+          break;
+        }
+  }
+}
+
+/**
+ * decode --
+ *
+ *      Decodes the snapshot a child sent.
+ *
+ * Results:
+ *      false unless the child exited normally after sending a complete one.
+ */
+static bool decode(const Child& child, Inventory& part)
+{
+  if (child.pid <= 0 || !WIFEXITED(child.status) || EXIT_SUCCESS != WEXITSTATUS(child.status) || child.data.empty())
+    return false;
+  auto file = fmemopen(const_cast<char*>(child.data.data()), child.data.size(), "rb");
+  if (!file)
+    return false;
+  auto ok = snapshot_read(part, file);
+  fclose(file);
+  return ok;
+}
+
+/* The signal that killed a child, -1 if it failed otherwise. */
+static int crash_signal(const Child& child)
+{
+  return child.pid > 0 && WIFSIGNALED(child.status) ? WTERMSIG(child.status) : -1;
+}
+
+Inventory collect_inventory_isolated(bool image_formats)
+{
+  /* Even the enumeration may crash in a driver's initialisation */
+  Inventory inventory;
+  vector<Child> enumeration(1);
+  if (spawn([]
+      {
+        Inventory counted;
+        counted.platforms.resize(collect_platform_ids(counted).size());
+        return counted;
+      }, enumeration[0]))
+    drain(enumeration);
+  if (!decode(enumeration[0], inventory))
+  {
+    inventory = Inventory();
+    inventory.status = CLINFO_CRASHED;
+    inventory.failed = "enumerate the platforms";
+    return inventory;
+  }
+
+  vector<Child> children(inventory.platforms.size());
+  for (size_t ii = 0; ii < children.size(); ++ii)
+    spawn([ii, image_formats]
+    {
+      Inventory part;
+      auto platform_ids = collect_platform_ids(part);
+      if (ii < platform_ids.size())
+        part.platforms.push_back(collect_platform(ii, platform_ids[ii], image_formats));
+      return part;
+    }, children[ii]);
+  drain(children);
+
+  for (size_t ii = 0; ii < children.size(); ++ii)
+  {
+    Inventory part;
+    auto& p = inventory.platforms[ii];
+    if (decode(children[ii], part) && 1 == part.platforms.size())
+      p = part.platforms[0];
+    else
+    {
+      p = Platform();
+      p.id = nullptr;
+      p.devices_status = CL_SUCCESS;
+      p.devices_failed = nullptr;
+      p.crash_signal = crash_signal(children[ii]);
+    }
+  }
+  return inventory;
+}
+
+/* The visitor looking for a timed out field. */
+struct Timed_out {
+  bool found;
+
+  template <typename T>
+  void operator()(const char*, const Field<T>& field) { found |= CLINFO_TIMED_OUT == field.status; }
+};
+
+bool inventory_timed_out(const Inventory& inventory)
+{
+  Timed_out check = {CLINFO_TIMED_OUT == inventory.status};
+  for (auto& platform : inventory.platforms)
+  {
+    visit_platform(platform, check);
+    check.found |= CLINFO_TIMED_OUT == platform.devices_status;
+    for (auto& device : platform.devices)
+    {
+      visit_device(device, check);
+      check("IMAGE_FORMATS", device.IMAGE_FORMATS);
+    }
+  }
+  return check.found;
+}
@@ -0,0 +1,190 @@
+/**
+ * inventory.h --
+ *
+ *      The platform and device model behind the dump, and libclinfo's
+ *      API.  collect_inventory() makes every query once and records the
+ *      value and status of each property; the renderers (the text dump,
+ *      JSON and a binary snapshot) only read the model, so a program can
+ *      discover devices in process and keep the result:
+ *
+ *          auto inventory = collect_inventory();
+ *          for (auto& platform : inventory.platforms)
+ *            for (auto& device : platform.devices)
+ *              if (device.GLOBAL_MEM_SIZE.ok() && device.extension_set.has("cl_khr_fp64"))
+ *                ...
+ *
+ *      Device fields are named after their CL_DEVICE_* suffix.
+ */
+#ifndef CLINFO_INVENTORY_H
+#define CLINFO_INVENTORY_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "clinfo.h"
+#include "extensions.h"
+#include "properties.h"
+
+class Output;
+
+#define INVENTORY_STRING 65536     /* longer strings are truncated, as they always were */
+
+/* A queried value with the status of its query and the size it reported. */
+template <typename T>
+struct Field {
+  Field() : value(), status(CL_INVALID_VALUE), size(0) {}
+  bool ok() const { return CL_SUCCESS == status; }
+  T value;
+  cl_int status;
+  size_t size;
+};
+
+struct Device {
+  cl_device_id id;                          /* null in a loaded snapshot */
+
+  Field<uint64_t> TYPE;
+#define def(X) Field<std::string> X;
+  STR_PROPS
+#undef def
+  Field<std::string> DRIVER_VERSION;
+  Field<std::string> EXTENSIONS;
+  Field<uint64_t> EXECUTION_CAPABILITIES;
+  Field<uint64_t> GLOBAL_MEM_CACHE_TYPE;
+  Field<uint64_t> LOCAL_MEM_TYPE;
+#define def(X) Field<uint64_t> X;
+  HEX_PROPS
+  LONG_PROPS
+#undef def
+  Field<std::vector<uint64_t>> MAX_WORK_ITEM_SIZES;
+  Field<uint64_t> PARTITION_MAX_SUB_DEVICES;
+  Field<std::vector<uint64_t>> PARTITION_PROPERTIES;
+  Field<uint64_t> PARTITION_AFFINITY_DOMAIN;
+  Field<uint64_t> SVM_CAPABILITIES;
+
+  /* Read only image formats of 2D images, if collected. */
+  bool image_formats_collected;
+  Field<std::vector<cl_image_format>> IMAGE_FORMATS;
+  const char* image_formats_failed;         /* the step that failed */
+  cl_int image_formats_release;             /* of the context */
+
+  Extension_set extension_set;
+};
+
+struct Platform {
+  cl_platform_id id;
+  Field<std::string> name, vendor, profile, version, extensions;
+  cl_int devices_status;
+  const char* devices_failed;               /* the step that failed */
+  int crash_signal;                         /* that killed its --isolate child, -1 if it failed otherwise */
+  std::vector<Device> devices;
+};
+
+struct Inventory {
+  cl_int status;                            /* of clGetPlatformIDs */
+  const char* failed;
+  std::vector<Platform> platforms;
+};
+
+/**
+ * visit_device --
+ *
+ *      Calls visitor(name, field) for every property of a device, in the
+ *      order of the dump.  Device may be const.
+ */
+template <typename D, typename V>
+void visit_device(D& device, V& visitor)
+{
+  visitor("TYPE", device.TYPE);
+#define def(X) visitor(#X, device.X);
+  STR_PROPS
+#undef def
+  visitor("DRIVER_VERSION", device.DRIVER_VERSION);
+  visitor("EXTENSIONS", device.EXTENSIONS);
+  visitor("EXECUTION_CAPABILITIES", device.EXECUTION_CAPABILITIES);
+  visitor("GLOBAL_MEM_CACHE_TYPE", device.GLOBAL_MEM_CACHE_TYPE);
+  visitor("LOCAL_MEM_TYPE", device.LOCAL_MEM_TYPE);
+#define def(X) visitor(#X, device.X);
+  HEX_PROPS
+  LONG_PROPS
+#undef def
+  visitor("MAX_WORK_ITEM_SIZES", device.MAX_WORK_ITEM_SIZES);
+  visitor("PARTITION_MAX_SUB_DEVICES", device.PARTITION_MAX_SUB_DEVICES);
+  visitor("PARTITION_PROPERTIES", device.PARTITION_PROPERTIES);
+  visitor("PARTITION_AFFINITY_DOMAIN", device.PARTITION_AFFINITY_DOMAIN);
+  visitor("SVM_CAPABILITIES", device.SVM_CAPABILITIES);
+}
+
+template <typename P, typename V>
+void visit_platform(P& platform, V& visitor)
+{
+  visitor("name", platform.name);
+  visitor("vendor", platform.vendor);
+  visitor("profile", platform.profile);
+  visitor("version", platform.version);
+  visitor("extensions", platform.extensions);
+}
+
+/* Queries every platform and device; image formats cost a context each. */
+Inventory collect_inventory(bool image_formats = false);
+/* The parts of it: one device, index as in the dump, and its image formats. */
+Device collect_device(int index, cl_device_id id, bool image_formats = false);
+void collect_image_formats(Device& device);
+/*
+ * collect_inventory() with every driver call made in child processes:
+ * one enumerates the platforms, then one per platform collects it, all
+ * at once.  A platform whose driver crashes comes back with only
+ * crash_signal set, and the others are unaffected; a crash while
+ * enumerating gives the status CLINFO_CRASHED.
+ */
+Inventory collect_inventory_isolated(bool image_formats = false);
+
+/*
+ * Only the platforms and their devices, for the modes that query a few
+ * properties themselves.  Every call is checked and made through icd.h,
+ * so --icd applies; a platform without devices has none and CL_SUCCESS.
+ */
+struct Enumerated_platform {
+  cl_platform_id id;
+  cl_int devices_status;
+  const char* devices_failed;               /* the step that failed */
+  std::vector<cl_device_id> devices;
+};
+
+struct Enumeration {
+  cl_int status;                            /* of clGetPlatformIDs */
+  const char* failed;
+  std::vector<Enumerated_platform> platforms;
+};
+
+Enumeration enumerate_devices();
+/* Prints every step that failed; true if none did. */
+bool report_enumeration(const Enumeration& enumeration);
+
+/*
+ * Gives every driver call of the collection ms milliseconds, 0 for no
+ * limit.  A call that misses the deadline gets status CLINFO_TIMED_OUT
+ * and the rest of its device or platform CLINFO_SKIPPED, so a wedged
+ * device costs one timeout.
+ */
+void collect_timeout(unsigned ms);
+bool inventory_timed_out(const Inventory& inventory);
+
+#define EXIT_TIMEOUT 3 /* the dump is partial, some driver call timed out */
+
+/*
+ * The renderers.  render_text() prints the classic dump, flushing once
+ * per device, and returns false after printing an error the dump
+ * cannot go on from.
+ */
+bool render_text(const Inventory& inventory, Output& out);
+void render_json(const Inventory& inventory, Output& out);
+
+/* A binary snapshot of the model, to render later or elsewhere. */
+bool snapshot_write(const Inventory& inventory, const std::string& path);
+bool snapshot_read(Inventory& inventory, const std::string& path);
+/* The same on an open stream, without messages. */
+bool snapshot_write(const Inventory& inventory, FILE* file);
+bool snapshot_read(Inventory& inventory, FILE* file);
+
+#endif
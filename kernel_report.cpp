@@ -0,0 +1,147 @@
+/**
+ * kernel_report.cpp --
+ *
+ *      Builds a user's OpenCL C file for every device and reports what
+ *      each of its kernels consumes (clGetKernelWorkGroupInfo) against
+ *      the device limits print_device() shows.
+ *
+ *      The work-groups per compute unit estimate takes the smaller of
+ *      what local memory allows and what fits if a compute unit holds
+ *      MAX_WORK_GROUP_SIZE work-items at a time.  OpenCL does not expose
+ *      register files, so private memory is reported but not counted;
+ *      GPUs usually hold more work-items per compute unit than that, so
+ *      treat the estimate as a lower bound.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "bench.h"
+
+using namespace std;
+
+namespace {
+
+string kernel_path;
+string kernel_options;
+
+}
+
+void kernel_file(const string& path, const string& options)
+{
+  kernel_path = path;
+  kernel_options = options;
+}
+
+/**
+ * work_group_info --
+ *
+ *      Reads one clGetKernelWorkGroupInfo property of a kernel.
+ *
+ * Results:
+ *      true if it was read, otherwise false after printing which
+ *      property failed.
+ */
+static bool work_group_info(const string& tag, const char* name, cl_kernel kernel, cl_device_id device,
+                            cl_kernel_work_group_info param, const char* param_name, size_t size, void* value)
+{
+  auto err = clGetKernelWorkGroupInfo(kernel, device, param, size, value, NULL);
+  if (CL_SUCCESS == err)
+    return true;
+  cerr << tag << ": " << name << ": Unable to get " << param_name << ": " << cl_error_str(err) << "!" << endl;
+  return false;
+}
+
+/**
+ * report_kernel --
+ *
+ *      Prints the resource usage of one kernel on the device.
+ *
+ * Results:
+ *      void.
+ */
+static void report_kernel(const string& tag, cl_device_id device, cl_kernel kernel)
+{
+  char name[256] = "";
+  size_t work_group_size, multiple, compile_size[3];
+  cl_ulong local_mem, private_mem;
+
+  clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof name, name, NULL);
+  name[sizeof name - 1] = '\0';
+  if (!work_group_info(tag, name, kernel, device, CL_KERNEL_WORK_GROUP_SIZE, "WORK_GROUP_SIZE",
+                       sizeof work_group_size, &work_group_size)
+      || !work_group_info(tag, name, kernel, device, CL_KERNEL_COMPILE_WORK_GROUP_SIZE, "COMPILE_WORK_GROUP_SIZE",
+                          sizeof compile_size, compile_size)
+      || !work_group_info(tag, name, kernel, device, CL_KERNEL_LOCAL_MEM_SIZE, "LOCAL_MEM_SIZE",
+                          sizeof local_mem, &local_mem))
+    return;
+#ifdef CL_VERSION_1_1
+  /* Reported as 0, i.e. not shown or not counted, if the driver fails them */
+  if (!work_group_info(tag, name, kernel, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+                       "PREFERRED_WORK_GROUP_SIZE_MULTIPLE", sizeof multiple, &multiple))
+    multiple = 0;
+  if (!work_group_info(tag, name, kernel, device, CL_KERNEL_PRIVATE_MEM_SIZE, "PRIVATE_MEM_SIZE",
+                       sizeof private_mem, &private_mem))
+    private_mem = 0;
+#else
+  multiple = private_mem = 0;
+#endif
+
+  auto max_work_group = device_uint(device, CL_DEVICE_MAX_WORK_GROUP_SIZE);
+  auto device_local = device_uint(device, CL_DEVICE_LOCAL_MEM_SIZE);
+  auto compiled = 0 != compile_size[0];
+  /* A reqd_work_group_size is what every launch has to use */
+  size_t group = compiled ? compile_size[0] * max<size_t>(1, compile_size[1]) * max<size_t>(1, compile_size[2])
+                          : work_group_size;
+
+  printf("%s: kernel %s\n", tag.c_str(), name);
+  printf("%s:   %-34s: %zu of %lu MAX_WORK_GROUP_SIZE\n", tag.c_str(), "WORK_GROUP_SIZE",
+         work_group_size, (unsigned long) max_work_group);
+  if (multiple)
+    printf("%s:   %-34s: %zu\n", tag.c_str(), "PREFERRED_WORK_GROUP_SIZE_MULTIPLE", multiple);
+  printf("%s:   %-34s: %s of %s LOCAL_MEM_SIZE (%.1f%%)\n", tag.c_str(), "LOCAL_MEM_SIZE",
+         format_bytes(local_mem).c_str(), format_bytes(device_local).c_str(),
+         device_local ? 100.0 * local_mem / device_local : 0.0);
+  printf("%s:   %-34s: %s per work-item, %s per work-group\n", tag.c_str(), "PRIVATE_MEM_SIZE",
+         format_bytes(private_mem).c_str(), format_bytes(private_mem * group).c_str());
+  if (compiled)
+    printf("%s:   %-34s: %zu x %zu x %zu\n", tag.c_str(), "COMPILE_WORK_GROUP_SIZE",
+           compile_size[0], compile_size[1], compile_size[2]);
+  else
+    printf("%s:   %-34s: none\n", tag.c_str(), "COMPILE_WORK_GROUP_SIZE");
+
+  auto by_items = max<uint64_t>(1, max_work_group / max<size_t>(1, group));
+  auto by_local = local_mem ? device_local / local_mem : by_items;
+  auto groups = min(by_items, by_local);
+  printf("%s:   %-34s: %lu of %zu work-items (limited by %s)\n", tag.c_str(), "work-groups per compute unit",
+         (unsigned long) groups, group, by_local < by_items ? "local memory" : "work-items");
+  if (group > max_work_group || local_mem > device_local)
+    printf("%s:   does not fit the device limits!\n", tag.c_str());
+}
+
+void report_kernels(const string& tag, cl_device_id device)
+{
+  ifstream in(kernel_path);
+  if (!in)
+  {
+    cerr << "Unable to read " << kernel_path << "!" << endl;
+    return;
+  }
+  string source((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+  Bench_context ctx(tag, vector<cl_device_id>(1, device));
+  auto program = ctx ? ctx.build(source.c_str(), kernel_options.c_str()) : nullptr;
+  if (!program)
+    return;
+  cl_uint num_kernels;
+  if (!ctx.check(clCreateKernelsInProgram(program, 0, NULL, &num_kernels), "count kernels"))
+    return;
+  vector<cl_kernel> kernels(num_kernels);
+  if (!ctx.check(clCreateKernelsInProgram(program, num_kernels, kernels.data(), NULL), "create kernels"))
+    return;
+  for (auto kernel : kernels)
+  {
+    report_kernel(tag, device, kernel);
+    clReleaseKernel(kernel);
+  }
+}
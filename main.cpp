@@ -11,15 +11,21 @@
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
-#include <sstream>
-#include <vector>
-#ifdef __APPLE__
-#include <OpenCL/opencl.h>
-#else
 #include <memory>
+#include <sstream>
 #include <string>
-#include "CL/cl.h"
-#endif
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "bench.h"
+#include "clinfo.h"
+#include "cltrace.h"
+#include "extensions.h"
+#include "icd.h"
+#include "inventory.h"
+#include "output.h"
+#include "shm_inventory.h"
+#include "timeline.h"
 
 using namespace std;
 
@@ -27,545 +33,578 @@ class CL_info {
 
 public:
 
-  CL_info(int argc, char** argv) : dump_image_formats(false)
+  CL_info(int argc, char** argv) : dump_image_formats(false), bench_output(false), prometheus_probe_age(0), watch_interval(0),
+                                    threshold(0.05), jobs(0), device_type(CL_DEVICE_TYPE_ALL),
+                                    daemon_interval(0), from_shm(false), json(false), icd_bench(false), self_bench_runs(0), timeout_ms(0),
+                                    isolate(false)
   {
     static struct option options[] = {
-      {"help",          0, nullptr, 'h'},
-      {"image-formats", 0, nullptr, 'i'},
-      {nullptr,         0, nullptr, 0}};
+      {"help",            0, nullptr, 'h'},
+      {"image-formats",   0, nullptr, 'i'},
+      {"bench-partition", 0, nullptr, OPT_BENCH_PARTITION},
+      {"bench-svm",       0, nullptr, OPT_BENCH_SVM},
+      {"bench-output",    0, nullptr, OPT_BENCH_OUTPUT},
+      {"probe-alloc",     0, nullptr, OPT_PROBE_ALLOC},
+      {"probe-zero-copy", 0, nullptr, OPT_PROBE_ZERO_COPY},
+      {"trace-report",    1, nullptr, OPT_TRACE_REPORT},
+      {"trace-out",       1, nullptr, OPT_TRACE_OUT},
+      {"prometheus",      1, nullptr, OPT_PROMETHEUS},
+      {"prometheus-probe",2, nullptr, OPT_PROMETHEUS_PROBE},
+      {"watch",           1, nullptr, OPT_WATCH},
+      {"save-baseline",   1, nullptr, OPT_SAVE_BASELINE},
+      {"compare-baseline",1, nullptr, OPT_COMPARE_BASELINE},
+      {"threshold",       1, nullptr, OPT_THRESHOLD},
+      {"roofline",        0, nullptr, OPT_ROOFLINE},
+      {"roofline-kernel", 1, nullptr, OPT_ROOFLINE_KERNEL},
+      {"roofline-out",    1, nullptr, OPT_ROOFLINE_OUT},
+      {"kernel",          1, nullptr, OPT_KERNEL},
+      {"compile-farm",    1, nullptr, OPT_COMPILE_FARM},
+      {"compile-options", 1, nullptr, OPT_COMPILE_OPTIONS},
+      {"jobs",            1, nullptr, OPT_JOBS},
+      {"has-extension",   1, nullptr, OPT_HAS_EXTENSION},
+      {"type",            1, nullptr, OPT_TYPE},
+      {"select",          1, nullptr, OPT_SELECT},
+      {"daemon",          2, nullptr, OPT_DAEMON},
+      {"from-shm",        0, nullptr, OPT_FROM_SHM},
+      {"json",            0, nullptr, OPT_JSON},
+      {"snapshot-out",    1, nullptr, OPT_SNAPSHOT_OUT},
+      {"snapshot-in",     1, nullptr, OPT_SNAPSHOT_IN},
+      {"icd",             1, nullptr, OPT_ICD},
+      {"icd-filter",      1, nullptr, OPT_ICD_FILTER},
+      {"bench-icd",       0, nullptr, OPT_BENCH_ICD},
+      {"self-bench",      1, nullptr, OPT_SELF_BENCH},
+      {"timeout",         1, nullptr, OPT_TIMEOUT},
+      {"isolate",         0, nullptr, OPT_ISOLATE},
+      {"bench-access",    0, nullptr, OPT_BENCH_ACCESS},
+      {"bench-align",     0, nullptr, OPT_BENCH_ALIGN},
+      {"bench-rect",      0, nullptr, OPT_BENCH_RECT},
+      {nullptr,           0, nullptr, 0}};
     int opt;
 
-    while (EOF != (opt = getopt_long(argc, argv, "hi", options, nullptr)))
+    while (EOF != (opt = getopt_long(argc, argv, "hiD:", options, nullptr)))
     {
       switch (opt)
       {
       case 'i':
         dump_image_formats = true;
         break;
+      case OPT_BENCH_PARTITION:
+        benchmarks.push_back(bench_partition);
+        break;
+      case OPT_BENCH_SVM:
+        benchmarks.push_back(bench_svm);
+        break;
+      case OPT_BENCH_OUTPUT:
+        bench_output = true;
+        break;
+      case OPT_PROBE_ALLOC:
+        benchmarks.push_back(probe_alloc);
+        break;
+      case OPT_PROBE_ZERO_COPY:
+        benchmarks.push_back(probe_zero_copy);
+        break;
+      case OPT_TRACE_REPORT:
+        trace_log = optarg;
+        break;
+      case OPT_TRACE_OUT:
+        Timeline::open(optarg);
+        break;
+      case OPT_PROMETHEUS:
+        prometheus_file = optarg;
+        break;
+      case OPT_PROMETHEUS_PROBE:
+        prometheus_probe_age = optarg ? strtod(optarg, nullptr) : PROMETHEUS_PROBE_AGE;
+        if (prometheus_probe_age <= 0)
+          usage(argv[0]);
+        break;
+      case OPT_WATCH:
+        watch_interval = strtod(optarg, nullptr);
+        if (watch_interval <= 0)
+          usage(argv[0]);
+        break;
+      case OPT_SAVE_BASELINE:
+        save_baseline = optarg;
+        break;
+      case OPT_COMPARE_BASELINE:
+        compare_baseline = optarg;
+        break;
+      case OPT_THRESHOLD:
+        threshold = strtod(optarg, nullptr) / 100;
+        if (threshold <= 0)
+          usage(argv[0]);
+        break;
+      case OPT_ROOFLINE:
+        benchmarks.push_back(bench_roofline);
+        break;
+      case OPT_ROOFLINE_KERNEL:
+        roofline_kernels.push_back(optarg);
+        break;
+      case OPT_ROOFLINE_OUT:
+        roofline_out = optarg;
+        break;
+      case OPT_KERNEL:
+        kernel_path = optarg;
+        benchmarks.push_back(report_kernels);
+        break;
+      case OPT_COMPILE_FARM:
+        compile_dir = optarg;
+        break;
+      case OPT_COMPILE_OPTIONS:
+        compile_options.push_back(optarg);
+        break;
+      case OPT_JOBS:
+        jobs = strtoul(optarg, nullptr, 10);
+        break;
+      case OPT_HAS_EXTENSION:
+        required_extensions.push_back(optarg);
+        break;
+      case OPT_TYPE:
+        device_type = parse_type(optarg);
+        if (0 == device_type)
+          usage(argv[0]);
+        break;
+      case OPT_SELECT:
+        selection = optarg;
+        break;
+      case OPT_DAEMON:
+        daemon_interval = optarg ? strtod(optarg, nullptr) : 60;
+        if (daemon_interval <= 0)
+          usage(argv[0]);
+        break;
+      case OPT_FROM_SHM:
+        from_shm = true;
+        break;
+      case OPT_JSON:
+        json = true;
+        break;
+      case OPT_SNAPSHOT_OUT:
+        snapshot_out = optarg;
+        break;
+      case OPT_SNAPSHOT_IN:
+        snapshot_in = optarg;
+        break;
+      case OPT_ICD:
+        icds.push_back(optarg);
+        break;
+      case OPT_ICD_FILTER:
+        icd_filters.push_back(optarg);
+        break;
+      case OPT_BENCH_ICD:
+        icd_bench = true;
+        break;
+      case OPT_SELF_BENCH:
+        self_bench_runs = strtoul(optarg, nullptr, 10);
+        if (0 == self_bench_runs)
+          usage(argv[0]);
+        break;
+      case OPT_TIMEOUT:
+        timeout_ms = strtoul(optarg, nullptr, 10);
+        if (0 == timeout_ms)
+          usage(argv[0]);
+        break;
+      case OPT_ISOLATE:
+        isolate = true;
+        break;
+      case OPT_BENCH_ACCESS:
+        benchmarks.push_back(bench_access);
+        break;
+      case OPT_BENCH_ALIGN:
+        benchmarks.push_back(bench_align);
+        break;
+      case OPT_BENCH_RECT:
+        benchmarks.push_back(bench_rect);
+        break;
+      case 'D':
+        kernel_options += string(kernel_options.empty() ? "" : " ") + "-D" + optarg;
+        break;
       case 'h':
       default:
         usage(argv[0]);
         break;
       }
     }
+    if (icd_bench && icds.empty() && icd_filters.empty())
+      usage(argv[0]);
+    /* Baselines hold benchmark results, so there has to be a benchmark */
+    if ((!save_baseline.empty() || !compare_baseline.empty()) && benchmarks.empty())
+      usage(argv[0]);
+    if (!roofline_kernels.empty() && benchmarks.end() == find(benchmarks.begin(), benchmarks.end(), bench_roofline))
+      usage(argv[0]);
+    kernel_file(kernel_path, kernel_options);
+    for (auto& spec : roofline_kernels)
+      roofline_kernel(spec, kernel_options);
   }
 
-  void display()
-  {
-    cl_uint num_platforms;
-    auto err = clGetPlatformIDs(0, NULL, &num_platforms);
-    check_opencl_status(err, "Unable to query the number of platforms");
-    cout << num_platforms << " platform" << (num_platforms == 1 ? ":" : "s:") << endl;
-    unique_ptr<cl_platform_id> platform_ids(new cl_platform_id[num_platforms]);
-    if (nullptr == platform_ids)
-    {
-      cerr << "Can't allocate memory for platform IDs (size " << num_platforms * sizeof(cl_platform_id) << ")";
-      exit(1);
-    }
-    err = clGetPlatformIDs(num_platforms, platform_ids.get(), nullptr);
-    check_opencl_status(err, "Unable to enumerate the platforms");
-    for (cl_uint ii = 0; ii < num_platforms; ++ii)
-    {
-      print_platform(ii, platform_ids.get()[ii]);
-      if (ii + 1 < num_platforms)
-        cout << "================================================================================\n";
-    }
-  }
-
-private:
-  bool dump_image_formats;
-  static char unknown[25];
-
   /**
-   * usage --
+   * run --
    *
-   *      Prints the usage message and exits.
+   *      Runs the selected benchmarks on every device in command line
+   *      order, or dumps everything if none is selected.
    *
    * Results:
-   *      void, but calls exit(1)
+   *      the process exit status.
    */
-  void usage(const char *program)
+  int run()
   {
-    cerr << "Usage: " << program << " [options]\n";
-    cerr << "Options:\n";
-    cerr << "  -h, --help                This message\n";
-    cerr << "  -i, --image-formats       Print image formats for each device\n";
-    exit(1);
-  }
-
-  void check_opencl_status(cl_int err, const string& msg)
-  {
-    if (CL_SUCCESS != err)
+    if (from_shm)
+      return shm_inventory_print();
+    if (!trace_log.empty())
+      return trace_report(trace_log);
+    if (self_bench_runs)
+      return self_bench(self_bench_runs);
+    collect_timeout(timeout_ms);
+    for (auto& filter : icd_filters)
     {
-      cerr << msg << ": " << cl_error_str(err) << endl;
-      exit(1);
+      auto libraries = icd_libraries(filter);
+      if (libraries.empty())
+      {
+        cerr << "No vendor .icd file matches " << filter << "!" << endl;
+        return EXIT_FAILURE;
+      }
+      icds.insert(icds.end(), libraries.begin(), libraries.end());
     }
+    if (icd_bench)
+      return bench_icd(icds);
+    if (!icds.empty() && !icd_open(icds))
+      return EXIT_FAILURE;
+    if (!prometheus_file.empty())
+      return prometheus_export(prometheus_file, prometheus_probe_age);
+    if (watch_interval > 0)
+      return watch(watch_interval);
+    if (daemon_interval > 0)
+      return shm_inventory_daemon([this](Inventory& inventory)
+      {
+        string dump;
+        out.capture(&dump);
+        display(&inventory);
+        out.capture(nullptr);
+        return dump;
+      }, daemon_interval);
+    if (!compile_dir.empty())
+      return compile_farm(compile_dir, compile_options, jobs);
+    if (bench_output)
+      return bench_display();
+    if (!selection.empty())
+      return select_devices(selection);
+    if (!required_extensions.empty())
+      return has_extensions(required_extensions, device_type);
+    if (benchmarks.empty())
+    {
+      auto status = display();
+      /* Threads still stuck in a driver could hang exit() in its destructors */
+      if (EXIT_TIMEOUT == status)
+      {
+        if (Timeline::enabled())
+          Timeline::write();
+        out.flush();
+        fflush(nullptr);
+        _exit(status);
+      }
+      return status;
+    }
+    auto enumeration = enumerate_devices();
+    if (!report_enumeration(enumeration))
+      return EXIT_FAILURE;
+    for (size_t ii = 0; ii < enumeration.platforms.size(); ++ii)
+    {
+      auto& device_ids = enumeration.platforms[ii].devices;
+      for (size_t jj = 0; jj < device_ids.size(); ++jj)
+      {
+        stringstream tag;
+        tag << "platform[" << ii << "] device[" << jj << "]";
+        Timeline_scope scope(tag.str(), "benchmark");
+        auto id = device_identity(device_ids[jj]);
+        cout << tag.str() << ": " << id.name << " (" << id.platform << ", " << id.version
+             << ", driver " << id.driver << ")" << endl;
+        for (auto benchmark : benchmarks)
+          benchmark(tag.str(), device_ids[jj]);
+      }
+    }
+    /* Compare first, so a run can be checked against and then replace a baseline */
+    auto status = EXIT_SUCCESS;
+    if (!compare_baseline.empty())
+      status = baseline_compare(compare_baseline, threshold);
+    if (!save_baseline.empty() && !baseline_save(save_baseline) && EXIT_SUCCESS == status)
+      status = EXIT_FAILURE;
+    if (!roofline_out.empty() && !roofline_write(roofline_out) && EXIT_SUCCESS == status)
+      status = EXIT_FAILURE;
+    return status;
   }
 
   /**
-   * cl_error_str --
+   * display --
    *
-   *      Utility function that converts an OpenCL error into a human
-   *      readable string.
+   *      Collects the inventory, or loads it from --snapshot-in, and
+   *      renders it as the dump, as JSON or into --snapshot-out; the
+   *      inventory is kept in collected if given.
    *
    * Results:
-   *      const char * pointer to a static string.
+   *      the process exit status, EXIT_TIMEOUT if a driver call timed out,
+   *      else EXIT_FAILURE if the platforms could not be enumerated or an
+   *      --isolate child crashed.
    */
-  const char* cl_error_str(cl_int error)
-  {
-    static struct {cl_int code; const char *msg;} error_table[] = {
-      {CL_SUCCESS,                       "no error"                     },
-      {CL_DEVICE_NOT_FOUND,              "device not found"             },
-      {CL_DEVICE_NOT_AVAILABLE,          "device not available"         },
-      {CL_COMPILER_NOT_AVAILABLE,        "compiler not available"       },
-      {CL_MEM_OBJECT_ALLOCATION_FAILURE, "mem object allocation failure"},
-      {CL_OUT_OF_RESOURCES,              "out of resources"             },
-      {CL_OUT_OF_HOST_MEMORY,            "out of host memory"           },
-      {CL_PROFILING_INFO_NOT_AVAILABLE,  "profiling not available"      },
-      {CL_MEM_COPY_OVERLAP,              "memcopy overlaps"             },
-      {CL_IMAGE_FORMAT_MISMATCH,         "image format mismatch"        },
-      {CL_IMAGE_FORMAT_NOT_SUPPORTED,    "image format not supported"   },
-      {CL_BUILD_PROGRAM_FAILURE,         "build program failed"         },
-      {CL_MAP_FAILURE,                   "map failed"                   },
-      {CL_INVALID_VALUE,                 "invalid value"                },
-      {CL_INVALID_DEVICE_TYPE,           "invalid device type"          },
-      {0, nullptr}};
-
-    for (int ii = 0; error_table[ii].msg != NULL; ++ii)
-      if (error_table[ii].code == error)
-        return error_table[ii].msg;
-
-    snprintf(unknown, sizeof unknown, "unknown error %d", error);
-    return unknown;
-  }
-
-  string format_long(uint64_t val)
+  int display(Inventory* collected = nullptr)
   {
-    string r = to_string(val % 1000);
-    while (val > 999)
-    {
-      auto x = val % 1000;
-      val = val / 1000;
-      r = to_string(val % 1000) + "," + (x < 100 ? (x < 10 ? string("00") + r : string("0") + r) : r);
-    }
-    return r;
+    Inventory local;
+    auto& inventory = collected ? *collected : local;
+    if (snapshot_in.empty())
+      inventory = isolate ? collect_inventory_isolated(dump_image_formats) : collect_inventory(dump_image_formats);
+    else if (!snapshot_read(inventory, snapshot_in))
+      return EXIT_FAILURE;
+    auto status = inventory_timed_out(inventory) ? EXIT_TIMEOUT : EXIT_SUCCESS;
+    if (CL_SUCCESS != inventory.status && EXIT_SUCCESS == status)
+      status = EXIT_FAILURE;
+    for (auto& platform : inventory.platforms)
+      if (platform.crash_signal && EXIT_SUCCESS == status)
+        status = EXIT_FAILURE;
+    if (!snapshot_out.empty())
+      return snapshot_write(inventory, snapshot_out) ? status : EXIT_FAILURE;
+    if (json)
+      render_json(inventory, out);
+    else if (!render_text(inventory, out) && EXIT_SUCCESS == status)
+      return EXIT_FAILURE;
+    return status;
   }
 
   /**
-   * print_image_format --
+   * bench_display --
    *
-   *      dumps all image formats supported by the device.
+   *      Times display() into a pipe drained by another thread, once
+   *      flushing every line as the dump did with endl and once flushing
+   *      per device block.  -i adds the image formats to the dump.
    *
    * Results:
-   *      void.
+   *      the process exit status.
    */
-  void print_image_formats(int device_index,
-                           const cl_device_id *devices,
-                           cl_mem_flags flags,
-                           cl_mem_object_type image_type)
+  int bench_display()
   {
-    cl_uint fmt;
-    cl_int err;
-    cl_context context;
-    cl_uint num_image_formats;
-    context = clCreateContext(NULL, 1, devices, NULL, NULL, &err);
-    if (err != CL_SUCCESS)
+    int fds[2];
+    if (0 != pipe(fds))
     {
-      cerr << "\tdevice[" << device_index << "]: Unable to create context: "
-           << cl_error_str(err) << "!" << endl;
-      return;
+      cerr << "Unable to create a pipe!" << endl;
+      return EXIT_FAILURE;
     }
-    err = clGetSupportedImageFormats(context, flags, image_type, 0, NULL, &num_image_formats);
-    if (err != CL_SUCCESS)
+    size_t drained = 0;
+    thread drain([&]
     {
-      cerr << "\tdevice[" << device_index << "]: Unable to get number of supported image formats: "
-           << cl_error_str(err) << "!" << endl;
-      return;
-    }
-    auto image_formats = new cl_image_format[num_image_formats];
-    err = clGetSupportedImageFormats(context, flags, image_type, num_image_formats, image_formats, NULL);
-    if (err != CL_SUCCESS)
+      char buf[65536];
+      for (ssize_t n; (n = read(fds[0], buf, sizeof buf)) > 0; )
+        drained += n;
+    });
+
+    static const struct { bool line_mode; const char* metric; } modes[] = {
+      { true,  "dump, flushed per line" },
+      { false, "dump, flushed per block" },
+    };
+    Bench_stats stats[2];
+    size_t writes[2], dumps = 0;
+    out.redirect(fds[1], fds[1]);
+    for (int ii = 0; ii < 2; ++ii)
     {
-      cerr << "\tdevice[" << device_index << "]: Unable to get supported image formats: "
-           << cl_error_str(err) << "!" << endl;
-      return;
+      out.set_line_mode(modes[ii].line_mode);
+      auto before = out.writes();
+      size_t runs = 0;
+      bench_measure([&]
+      {
+        ++runs;
+        auto start = host_seconds();
+        display();
+        return host_seconds() - start;
+      }, stats[ii]);
+      writes[ii] = runs ? (out.writes() - before) / runs : 0;
+      dumps += runs;
     }
-    for (fmt = 0; fmt < num_image_formats; ++fmt)
+    out.set_line_mode(false);
+    out.redirect(1, 2);
+    close(fds[1]);
+    drain.join();
+    close(fds[0]);
+
+    for (int ii = 0; ii < 2; ++ii)
     {
-      if (fmt > 0) cout << "                                          ";
-      switch (image_formats[fmt].image_channel_order)
-      {
-      case CL_R:             cout << " CL_R            "; break;
-      case CL_A:             cout << " CL_A            "; break;
-      case CL_RG:            cout << " CL_RG           "; break;
-      case CL_RA:            cout << " CL_RA           "; break;
-      case CL_RGB:           cout << " CL_RGB          "; break;
-      case CL_RGBA:          cout << " CL_RGBA         "; break;
-      case CL_BGRA:          cout << " CL_BGRA         "; break;
-      case CL_ARGB:          cout << " CL_ARGB         "; break;
-      case CL_INTENSITY:     cout << " CL_INTENSITY    "; break;
-      case CL_LUMINANCE:     cout << " CL_LUMINANCE    "; break;
-      case CL_Rx:            cout << " CL_Rx           "; break;
-      case CL_RGx:           cout << " CL_RGx          "; break;
-      case CL_RGBx:          cout << " CL_RGBx         "; break;
-#ifdef CL_DEPTH
-      case CL_DEPTH:         printf(" CL_DEPTH        "); break;
-#endif
-#ifdef CL_DEPTH_STENCIL
-      case CL_DEPTH_STENCIL: printf(" CL_DEPTH_STENCIL"); break;
-#endif
-      default:               printf(" UKNOWN  %8x", image_formats[fmt].image_channel_order);
-      }
-      switch (image_formats[fmt].image_channel_data_type)
-      {
-      case CL_SNORM_INT8:      cout << ", CL_SNORM_INT8\n";      break;
-      case CL_SNORM_INT16:     cout << ", CL_SNORM_INT16\n";     break;
-      case CL_UNORM_INT8:      cout << ", CL_UNORM_INT8\n";      break;
-      case CL_UNORM_INT16:     cout << ", CL_UNORM_INT16\n";     break;
-      case CL_UNORM_SHORT_565: cout << ", CL_UNORM_SHORT_565\n"; break;
-      case CL_UNORM_SHORT_555: cout << ", CL_UNORM_SHORT_555\n"; break;
-      case CL_UNORM_INT_101010:cout << ", CL_UNORM_INT_101010\n";break;
-      case CL_SIGNED_INT8:     cout << ", CL_SIGNED_INT8\n";     break;
-      case CL_SIGNED_INT16:    cout << ", CL_SIGNED_INT16\n";    break;
-      case CL_SIGNED_INT32:    cout << ", CL_SIGNED_INT32\n";    break;
-      case CL_UNSIGNED_INT8:   cout << ", CL_UNSIGNED_INT8\n";   break;
-      case CL_UNSIGNED_INT16:  cout << ", CL_UNSIGNED_INT16\n";  break;
-      case CL_UNSIGNED_INT32:  cout << ", CL_UNSIGNED_INT32\n";  break;
-      case CL_HALF_FLOAT:      cout << ", CL_HALF_FLOAT\n";      break;
-      case CL_FLOAT:           cout << ", CL_FLOAT\n";           break;
-#ifdef CL_UNORM_INT24
-      case CL_UNORM_INT24:     printf(", CL_UNORM_INT24\n");     break;
-#endif
-      default:                 printf(", UKNOWN %8x\n", image_formats[fmt].image_channel_data_type);
-      }
+      bench_report("output", nullptr, modes[ii].metric, stats[ii]);
+      printf("output: %-28s %zu writes per dump\n", modes[ii].metric, writes[ii]);
     }
-    delete[] image_formats;
-    if ((err = clReleaseContext(context)) != CL_SUCCESS)
-      cerr << "\tdevice[" << device_index << "]: Unable to release context: "
-           << cl_error_str(err) << "!" << endl;
+    printf("output: %s per dump, buffering is %.1fx faster\n", format_bytes(dumps ? drained / dumps : 0).c_str(),
+           stats[1].median > 0 ? stats[0].median / stats[1].median : 0.0);
+    return EXIT_SUCCESS;
   }
 
-  void print_extensions(const char* buf, int width)
-  {
-    vector<string> words;
-    stringstream ss;
-    string word;
-    ss.str(buf);
-    while (ss >> word)
-      words.push_back(word);
-    sort(words.begin(), words.end());
-    cout << words[0] << endl;
-    for (vector<string>::size_type ii = 1; ii != words.size(); ++ii)
-      cout << setw(width) << " " << words[ii] << endl;
-  }
+private:
+  enum {
+    OPT_BENCH_PARTITION = 256,
+    OPT_BENCH_SVM,
+    OPT_BENCH_OUTPUT,
+    OPT_PROBE_ALLOC,
+    OPT_PROBE_ZERO_COPY,
+    OPT_TRACE_REPORT,
+    OPT_TRACE_OUT,
+    OPT_PROMETHEUS,
+    OPT_PROMETHEUS_PROBE,
+    OPT_WATCH,
+    OPT_SAVE_BASELINE,
+    OPT_COMPARE_BASELINE,
+    OPT_THRESHOLD,
+    OPT_ROOFLINE,
+    OPT_ROOFLINE_KERNEL,
+    OPT_ROOFLINE_OUT,
+    OPT_KERNEL,
+    OPT_COMPILE_FARM,
+    OPT_COMPILE_OPTIONS,
+    OPT_JOBS,
+    OPT_HAS_EXTENSION,
+    OPT_TYPE,
+    OPT_SELECT,
+    OPT_DAEMON,
+    OPT_FROM_SHM,
+    OPT_JSON,
+    OPT_SNAPSHOT_OUT,
+    OPT_SNAPSHOT_IN,
+    OPT_ICD,
+    OPT_ICD_FILTER,
+    OPT_BENCH_ICD,
+    OPT_SELF_BENCH,
+    OPT_TIMEOUT,
+    OPT_ISOLATE,
+    OPT_BENCH_ACCESS,
+    OPT_BENCH_ALIGN,
+    OPT_BENCH_RECT
+  };
+
+  bool dump_image_formats;
+  bool bench_output;
+  vector<Benchmark> benchmarks;
+  string trace_log;
+  string prometheus_file;
+  double prometheus_probe_age;
+  double watch_interval;
+  string save_baseline;
+  string compare_baseline;
+  double threshold;
+  vector<string> roofline_kernels;
+  string roofline_out;
+  string kernel_path;
+  string kernel_options;
+  string compile_dir;
+  vector<string> compile_options;
+  unsigned jobs;
+  vector<string> required_extensions;
+  cl_device_type device_type;
+  string selection;
+  double daemon_interval;
+  bool from_shm;
+  bool json;
+  string snapshot_out;
+  string snapshot_in;
+  vector<string> icds;
+  vector<string> icd_filters;
+  bool icd_bench;
+  unsigned self_bench_runs;
+  unsigned timeout_ms;
+  bool isolate;
+  Output out;
 
   /**
-   * print_device --
+   * usage --
    *
-   *      Dumps everything about the given device ID.
+   *      Prints the usage message and exits.
    *
    * Results:
-   *      void.
+   *      void, but calls exit(1)
    */
-  void print_device(int device_index, cl_device_id device)
+  void usage(const char *program)
   {
-#define LONG_PROPS                           \
-    def(VENDOR_ID),                          \
-    def(MAX_COMPUTE_UNITS),                  \
-    def(MAX_WORK_ITEM_DIMENSIONS),           \
-    def(MAX_WORK_GROUP_SIZE),                \
-    def(PREFERRED_VECTOR_WIDTH_CHAR),        \
-    def(PREFERRED_VECTOR_WIDTH_SHORT),       \
-    def(PREFERRED_VECTOR_WIDTH_INT),         \
-    def(PREFERRED_VECTOR_WIDTH_LONG),        \
-    def(PREFERRED_VECTOR_WIDTH_FLOAT),       \
-    def(PREFERRED_VECTOR_WIDTH_DOUBLE),      \
-    def(MAX_CLOCK_FREQUENCY),                \
-    def(ADDRESS_BITS),                       \
-    def(MAX_MEM_ALLOC_SIZE),                 \
-    def(IMAGE_SUPPORT),                      \
-    def(MAX_READ_IMAGE_ARGS),                \
-    def(MAX_WRITE_IMAGE_ARGS),               \
-    def(IMAGE2D_MAX_WIDTH),                  \
-    def(IMAGE2D_MAX_HEIGHT),                 \
-    def(IMAGE3D_MAX_WIDTH),                  \
-    def(IMAGE3D_MAX_HEIGHT),                 \
-    def(IMAGE3D_MAX_DEPTH),                  \
-    def(MAX_SAMPLERS),                       \
-    def(MAX_PARAMETER_SIZE),                 \
-    def(MEM_BASE_ADDR_ALIGN),                \
-    def(MIN_DATA_TYPE_ALIGN_SIZE),           \
-    def(GLOBAL_MEM_CACHELINE_SIZE),          \
-    def(GLOBAL_MEM_CACHE_SIZE),              \
-    def(GLOBAL_MEM_SIZE),                    \
-    def(MAX_CONSTANT_BUFFER_SIZE),           \
-    def(MAX_CONSTANT_ARGS),                  \
-    def(LOCAL_MEM_SIZE),                     \
-    def(ERROR_CORRECTION_SUPPORT),           \
-    def(PROFILING_TIMER_RESOLUTION),         \
-    def(ENDIAN_LITTLE),                      \
-    def(AVAILABLE),                          \
-    def(COMPILER_AVAILABLE),
-
-#define STR_PROPS                            \
-    def(NAME),                               \
-    def(VENDOR),                             \
-    def(PROFILE),                            \
-    def(VERSION),
-
-#define HEX_PROPS                            \
-    def(SINGLE_FP_CONFIG),                   \
-    def(QUEUE_PROPERTIES),
-
-    static struct {cl_device_info param; const char* name;} longProps[] = {
-#define def(X) {CL_DEVICE_##X, #X}
-      LONG_PROPS
-#undef def
-      {0, NULL}
-    };
-    static struct {cl_device_info param; const char* name;} hexProps[] = {
-#define def(X) {CL_DEVICE_##X, #X}
-      HEX_PROPS
-#undef def
-      {0, NULL}
-    };
-    static struct {cl_device_info param; const char* name;} strProps[] = {
-#define def(X) {CL_DEVICE_##X, #X}
-      STR_PROPS
-#undef def
-      {CL_DRIVER_VERSION, "DRIVER_VERSION"},
-      {CL_DEVICE_EXTENSIONS, "EXTENSIONS"},
-      {0, NULL}
-    };
-    size_t work_item_sizes[3];
-    char buf[65536];
-    uint64_t val; /* Avoids unpleasant surprises for some params */
-    size_t size;
-    cl_int err;
-
-    err = clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof val, &val, NULL);
-    if (err == CL_SUCCESS)
-    {
-      printf("device[%d]: TYPE                          : ", device_index);
-      if (val & CL_DEVICE_TYPE_DEFAULT)
-      {
-        val &= ~CL_DEVICE_TYPE_DEFAULT;
-        cout << "Default ";
-      }
-      if (val & CL_DEVICE_TYPE_CPU)
-      {
-        val &= ~CL_DEVICE_TYPE_CPU;
-        cout << "CPU ";
-      }
-      if (val & CL_DEVICE_TYPE_GPU)
-      {
-        val &= ~CL_DEVICE_TYPE_GPU;
-        cout << "GPU ";
-      }
-      if (val & CL_DEVICE_TYPE_ACCELERATOR)
-      {
-        val &= ~CL_DEVICE_TYPE_ACCELERATOR;
-        cout << "Accelerator ";
-      }
-      if (val != 0)
-      {
-        printf("Unknown (0x%lx) ", (unsigned long) val);
-      }
-      cout << endl;
-    }
-    else
-    {
-      fprintf(stderr, "device[%d]: Unable to get TYPE: %s!\n", device_index, cl_error_str(err));
-    }
-
-    for (int ii = 0; strProps[ii].name != NULL; ++ii)
-    {
-      err = clGetDeviceInfo(device, strProps[ii].param, sizeof buf, buf, &size);
-      if (err != CL_SUCCESS)
-      {
-        fprintf(stderr, "device[%d]: Unable to get %s: %s!\n", device_index, strProps[ii].name, cl_error_str(err));
-        continue;
-      }
-      if (size > sizeof buf)
-      {
-        fprintf(stderr, "device[%d]: Large %s (%ld bytes)!  Truncating to %ld!\n",
-                device_index, strProps[ii].name, size, sizeof buf);
-      }
-      cout << "device[" << device_index << "]: " << left << setw(30) << strProps[ii].name << ": ";
-      if (string("EXTENSIONS") != strProps[ii].name)
-        cout << buf << endl;
-      else
-        print_extensions(buf, 43);
-    }
-
-    err = clGetDeviceInfo(device, CL_DEVICE_EXECUTION_CAPABILITIES, sizeof val, &val, NULL);
-    if (err == CL_SUCCESS)
-    {
-      printf("device[%d]: EXECUTION_CAPABILITIES        : ", device_index);
-      if (val & CL_EXEC_KERNEL)
-      {
-        val &= ~CL_EXEC_KERNEL;
-        cout << "Kernel ";
-      }
-      if (val & CL_EXEC_NATIVE_KERNEL)
-      {
-        val &= ~CL_EXEC_NATIVE_KERNEL;
-        cout << "Native ";
-      }
-      if (val)
-      {
-        printf("Unknown (0x%lx) ", (unsigned long) val);
-      }
-      cout << endl;
-    }
-    else
-    {
-      fprintf(stderr, "device[%d]: Unable to get EXECUTION_CAPABILITIES: %s!\n", device_index, cl_error_str(err));
-    }
-
-    err = clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_CACHE_TYPE, sizeof val, &val, NULL);
-    if (err == CL_SUCCESS)
-    {
-      static const char *cacheTypes[] = { "None", "Read-Only", "Read-Write" };
-      static size_t numTypes = sizeof cacheTypes / sizeof cacheTypes[0];
-
-      printf("device[%d]: GLOBAL_MEM_CACHE_TYPE         : %s (%ld)\n",
-             device_index, val < numTypes ? cacheTypes[val] : "???", (unsigned long) val);
-    }
-    else
-    {
-      fprintf(stderr, "device[%d]: Unable to get GLOBAL_MEM_CACHE_TYPE: %s!\n", device_index, cl_error_str(err));
-    }
-    err = clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_TYPE, sizeof val, &val, NULL);
-    if (err == CL_SUCCESS)
-    {
-      static const char* memory_types[] = { "???", "Local", "Global" };
-      static size_t numTypes = sizeof memory_types / sizeof memory_types[0];
-
-      cout << "device[" << device_index << "]: CL_DEVICE_LOCAL_MEM_TYPE      : "
-           << (val < numTypes ? memory_types[val] : "???") << " (" << val << ")" << endl;
-    }
-    else
-    {
-      fprintf(stderr, "device[%d]: Unable to get CL_DEVICE_LOCAL_MEM_TYPE: %s!\n", device_index, cl_error_str(err));
-    }
-
-    for (int ii = 0; hexProps[ii].name != NULL; ++ii)
-    {
-      err = clGetDeviceInfo(device, hexProps[ii].param, sizeof val, &val, &size);
-      if (CL_SUCCESS != err)
-      {
-        fprintf(stderr, "device[%d]: Unable to get %s: %s!\n", device_index, hexProps[ii].name, cl_error_str(err));
-        continue;
-      }
-      if (size > sizeof val)
-      {
-        fprintf(stderr, "device[%d]: Large %s (%lu bytes)!  Truncating to %lu!\n",
-                device_index, hexProps[ii].name, size, sizeof val);
-      }
-      cout << "device[" << device_index << "]: " << left << setw(30) << hexProps[ii].name
-           << ": 0x" << hex << val << dec << endl;
-    }
-
-    for (int ii = 0; longProps[ii].name != NULL; ++ii)
-    {
-      err = clGetDeviceInfo(device, longProps[ii].param, sizeof val, &val, &size);
-      if (CL_SUCCESS != err)
-      {
-        cerr << "device[" << device_index << "]: Unable to get " << longProps[ii].name
-             << ": " << cl_error_str(err) << "!" << endl;
-        continue;
-      }
-      if (size > sizeof val)
-      {
-        cerr << "device[" << device_index << "]: Large " << longProps[ii].name
-             << " (" << size << " bytes)!  Truncating to " << sizeof val << "!" << endl;
-      }
-      cout << "device[" << device_index << "]: " << left << setw(30) << longProps[ii].name
-           << ": " << format_long(val) << endl;
-    }
-    err = clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof work_item_sizes, work_item_sizes, NULL);
-    if (CL_SUCCESS != err)
-    {
-      cerr << "device[" << device_index << "]: Unable to get MAX_WORK_ITEM_SIZES: "
-           << cl_error_str(err) << "!" << endl;
-    }
-    else
-    {
-      printf("device[%d]: %-30s: %zd, %zd, %zd\n", device_index, "MAX_WORK_ITEM_SIZES",
-             work_item_sizes[0], work_item_sizes[1], work_item_sizes[2]);
-    }
-    if (dump_image_formats)
-    {
-      printf("device[%d]: %-30s:", device_index, "IMAGE FORMATS");
-      print_image_formats(device_index, &device, CL_MEM_READ_ONLY, CL_MEM_OBJECT_IMAGE2D);
-    }
+    cerr << "Usage: " << program << " [options]\n";
+    cerr << "Options:\n";
+    cerr << "  -h, --help                This message\n";
+    cerr << "  -i, --image-formats       Print image formats for each device\n";
+    cerr << "      --bench-partition     Compare sub-device partitions of each device\n";
+    cerr << "      --bench-svm           Compare shared virtual memory with buffers\n";
+    cerr << "      --bench-output        Time the dump into a pipe, line flushed and buffered\n";
+    cerr << "      --probe-alloc         Measure allocation latency and real capacity\n";
+    cerr << "      --probe-zero-copy     Tell which host pointer flags map without copying\n";
+    cerr << "      --trace-report FILE   Summarise a libcltrace.so log\n";
+    cerr << "      --trace-out FILE      Write a Chrome trace-event timeline of the run\n";
+    cerr << "      --prometheus FILE     Atomically write device metrics for node_exporter\n";
+    cerr << "      --prometheus-probe[=SECONDS]\n";
+    cerr << "                            Add measured bandwidth and launch latency to them,\n";
+    cerr << "                            measured again when SECONDS old (default " << PROMETHEUS_PROBE_AGE << ")\n";
+    cerr << "      --watch SECONDS       Print changes of device availability as JSON lines\n";
+    cerr << "      --save-baseline FILE  Store the benchmark results per device and driver\n";
+    cerr << "      --compare-baseline FILE\n";
+    cerr << "                            Compare the benchmark results, exit " << EXIT_REGRESSION << " on regression\n";
+    cerr << "      --threshold PERCENT   Slowdown that counts as a regression (default 5)\n";
+    cerr << "      --roofline            Measure memory and compute ceilings of each device\n";
+    cerr << "      --roofline-kernel FILE.cl:KERNEL:ITEMS:OPS:BYTES[:float|double|int]\n";
+    cerr << "                            Place a kernel with known counts per work-item on it\n";
+    cerr << "      --roofline-out FILE   Write the rooflines as JSON (*.json) or CSV\n";
+    cerr << "      --kernel FILE.cl      Report the resources each kernel uses on each device\n";
+    cerr << "  -D NAME[=VALUE]           Define a macro when building FILE.cl and the\n";
+    cerr << "                            roofline kernels\n";
+    cerr << "      --compile-farm DIR    Build every .cl file in DIR for every device in parallel\n";
+    cerr << "      --compile-options OPTIONS\n";
+    cerr << "                            Build options, repeat for more option sets\n";
+    cerr << "      --jobs N              Concurrent builds (default: one per CPU)\n";
+    cerr << "      --has-extension EXT   List the devices with EXT, exit 1 if none, " << EXIT_QUERY_FAILED << " if\n";
+    cerr << "                            a query failed; repeat to require several\n";
+    cerr << "      --type TYPE           Only devices of TYPE: cpu, gpu, accelerator, default\n";
+    cerr << "                            or all\n";
+    cerr << "      --select EXPRESSION   Print platform:device of the devices that satisfy\n";
+    cerr << "                            e.g. 'type==GPU && GLOBAL_MEM_SIZE>=8GiB && has(cl_khr_fp64)',\n";
+    cerr << "                            exit 1 if none, " << EXIT_QUERY_FAILED << " if it or a query failed\n";
+    cerr << "      --daemon[=SECONDS]    Publish the dump in shared memory " << SHM_INVENTORY_NAME << ",\n";
+    cerr << "                            refreshed every SECONDS (default 60)\n";
+    cerr << "      --from-shm            Print the dump a daemon published, without the ICDs\n";
+    cerr << "      --json                Print the platforms and devices as JSON\n";
+    cerr << "      --snapshot-out FILE   Save them in a binary snapshot instead\n";
+    cerr << "      --snapshot-in FILE    Print a snapshot instead of querying the ICDs\n";
+    cerr << "      --icd LIBRARY         Dump only the platforms of this vendor library, loaded\n";
+    cerr << "                            without the ICD loader; repeat for more\n";
+    cerr << "      --icd-filter GLOB     Likewise for the " << ICD_VENDORS << "/*.icd files matching\n";
+    cerr << "      --bench-icd           Time how much faster they start than the loader\n";
+    cerr << "      --self-bench N        Time each phase of the device discovery N times, in\n";
+    cerr << "                            fresh processes and in process\n";
+    cerr << "      --timeout MS          Give up on a driver call of the dump after MS, print\n";
+    cerr << "                            the other devices and exit " << EXIT_TIMEOUT << "\n";
+    cerr << "      --isolate             Collect each platform in a child process of its own,\n";
+    cerr << "                            in parallel; a crashing driver loses only that one\n";
+    cerr << "      --bench-access        Measure strided, gather, scatter and random access\n";
+    cerr << "                            bandwidth per element size, in and out of the cache\n";
+    cerr << "      --bench-align         Measure kernels, sub-buffers and transfers at every\n";
+    cerr << "                            alignment up to MEM_BASE_ADDR_ALIGN and the page size\n";
+    cerr << "      --bench-rect          Compare rectangular copies, reads and writes with a\n";
+    cerr << "                            copy kernel and row by row transfers per tile size\n";
+    exit(1);
   }
 
   /**
-   * print_platform --
+   * parse_type --
    *
-   *      Dumps everything about the given platform ID.
+   *      Converts a --type argument into a device type mask.
    *
    * Results:
-   *      void.
+   *      the mask, 0 for an unknown type.
    */
-  void print_platform(int index, cl_platform_id platform)
+  cl_device_type parse_type(const string& name)
   {
-    static struct { cl_platform_info param; const char *name; } props[] = {
-      { CL_PLATFORM_NAME,       "name"       },
-      { CL_PLATFORM_VENDOR,     "vendor"     },
-      { CL_PLATFORM_PROFILE,    "profile"    },
-      { CL_PLATFORM_VERSION,    "version"    },
-      { CL_PLATFORM_EXTENSIONS, "extensions" },
-      { 0, nullptr },
+    static struct { const char* name; cl_device_type type; } types[] = {
+      { "cpu",         CL_DEVICE_TYPE_CPU         },
+      { "gpu",         CL_DEVICE_TYPE_GPU         },
+      { "accelerator", CL_DEVICE_TYPE_ACCELERATOR },
+      { "default",     CL_DEVICE_TYPE_DEFAULT     },
+      { "all",         CL_DEVICE_TYPE_ALL         },
+      { nullptr,       0                          },
     };
-    char buf[65536];
-    stringstream ss;
-    size_t size;
-    cl_int err;
-
-    for (cl_uint ii = 0; props[ii].name != nullptr; ++ii)
-    {
-      err = clGetPlatformInfo(platform, props[ii].param, sizeof buf, buf, &size);
-      ss << "platform[" << index << "]: Unable to get " << props[ii].name;
-      check_opencl_status(err, ss.str());
-      ss.str(string());
-      if (size > sizeof buf)
-        cerr << "platform[" << index << "]: Huge " << props[ii].name
-             << " (" << size << " bytes)!  Truncating to " << sizeof buf << endl;
-      cout << "platform[" << index << "]: " << left << setw(10) << props[ii].name << ": ";
-      if (string("extensions") != props[ii].name)
-        cout << buf << endl;
-      else
-        print_extensions(buf, 25);
-    }
-    cl_uint num_devices;
-    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 0, NULL, &num_devices);
-    ss << "platform[" << index << "]: Unable to query the number of devices";
-    check_opencl_status(err, ss.str());
-    ss.str(string());
-    cout << "platform[" << index << "], " << num_devices << " device" << (num_devices == 1 ? "" : "s") << ":" << endl;
-    unique_ptr<cl_device_id> device_ids(new cl_device_id[num_devices]);
-    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, num_devices, device_ids.get(), NULL);
-    ss << "platform[" << index << "]: Unable to enumerate the devices";
-    check_opencl_status(err, ss.str());
-    ss.str(string());
-    for (cl_uint ii = 0; ii < num_devices; ++ii)
-    {
-      print_device(ii, *(device_ids.get() + ii));
-      if (ii + 1 < num_devices)
-        cout << "--------------------------------------------------------------------------------\n";
-    }
+    for (int ii = 0; types[ii].name != nullptr; ++ii)
+      if (name == types[ii].name)
+        return types[ii].type;
+    return 0;
   }
 
 };
 
-char CL_info::unknown[25];
-
 int main(int argc, char* argv[])
 {
   CL_info info(argc, argv);
-  info.display();
-  return EXIT_SUCCESS;
+  return info.run();
 }
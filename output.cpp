@@ -0,0 +1,116 @@
+/**
+ * output.cpp --
+ *
+ *      The buffered output of the device dump.
+ */
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <unistd.h>
+#include "output.h"
+
+using namespace std;
+
+/**
+ * append --
+ *
+ *      Formats onto the end of a buffer, in place.
+ *
+ * Results:
+ *      void.
+ */
+static void append(string& buf, const char* format, va_list args)
+{
+  va_list again;
+  va_copy(again, args);
+  auto used = buf.size();
+  buf.resize(used + 256);
+  auto n = vsnprintf(&buf[used], 256, format, args);
+  if (n >= 256)
+  {
+    buf.resize(used + n + 1);
+    vsnprintf(&buf[used], n + 1, format, again);
+  }
+  va_end(again);
+  buf.resize(used + (n > 0 ? n : 0));
+}
+
+void Output::print(const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  append(out, format, args);
+  va_end(args);
+  if (line_mode && !out.empty() && '\n' == out.back())
+    flush_out();
+}
+
+void Output::error(const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  append(err, format, args);
+  va_end(args);
+  if (line_mode)
+    write_all(err_fd, err);
+}
+
+void Output::flush()
+{
+  write_all(err_fd, err);
+  flush_out();
+}
+
+void Output::capture(string* sink)
+{
+  flush();
+  this->sink = sink;
+}
+
+void Output::flush_out()
+{
+  if (sink)
+  {
+    sink->append(out);
+    out.clear();
+  }
+  else
+    write_all(out_fd, out);
+}
+
+void Output::redirect(int out_fd, int err_fd)
+{
+  flush();
+  this->out_fd = out_fd;
+  this->err_fd = err_fd;
+}
+
+/**
+ * write_all --
+ *
+ *      Writes and empties a buffer.  Whatever stdio holds for the same
+ *      stream goes first, so printf() elsewhere keeps its place.
+ *
+ * Results:
+ *      void; write errors drop the rest of the buffer.
+ */
+void Output::write_all(int fd, string& buf)
+{
+  if (buf.empty())
+    return;
+  if (1 == fd)
+    fflush(stdout);
+  else if (2 == fd)
+    fflush(stderr);
+  for (size_t done = 0; done < buf.size(); )
+  {
+    ++syscalls;
+    auto n = write(fd, buf.data() + done, buf.size() - done);
+    if (n < 0 && EINTR == errno)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  buf.clear();
+}
@@ -0,0 +1,59 @@
+/**
+ * output.h --
+ *
+ *      Formats the device dump into memory and writes it out in blocks.
+ *
+ *      print() and error() append printf-style text to one buffer for the
+ *      output and one for the diagnostics; flush() writes the diagnostics
+ *      and then the output, one write(2) each, so a block costs two
+ *      syscalls whatever its size and the order of the two streams no
+ *      longer depends on how they are buffered.  In line mode every
+ *      newline flushes, which is what the dump cost when it used endl.
+ */
+#ifndef CLINFO_OUTPUT_H
+#define CLINFO_OUTPUT_H
+
+#include <cstddef>
+#include <string>
+
+#ifdef __GNUC__
+#define OUTPUT_PRINTF __attribute__((format(printf, 2, 3)))
+#else
+#define OUTPUT_PRINTF
+#endif
+
+class Output {
+
+public:
+
+  Output(int out_fd = 1, int err_fd = 2) : out_fd(out_fd), err_fd(err_fd), line_mode(false), syscalls(0),
+                                           sink(nullptr) {}
+  ~Output() { flush(); }
+
+  void print(const char* format, ...) OUTPUT_PRINTF;
+  void error(const char* format, ...) OUTPUT_PRINTF;
+  void flush();
+
+  /* Redirects the output, e.g. for a benchmark; flushes first. */
+  void redirect(int out_fd, int err_fd);
+  void set_line_mode(bool on) { line_mode = on; }
+  /* Appends the output to *sink instead of writing it, until null. */
+  void capture(std::string* sink);
+  /* The write(2) calls made so far. */
+  size_t writes() const { return syscalls; }
+
+private:
+  int out_fd, err_fd;
+  bool line_mode;
+  size_t syscalls;
+  std::string out, err;
+  std::string* sink;
+
+  void flush_out();
+  void write_all(int fd, std::string& buf);
+
+  Output(const Output&) = delete;
+  Output& operator=(const Output&) = delete;
+};
+
+#endif
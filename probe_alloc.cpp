@@ -0,0 +1,253 @@
+/**
+ * probe_alloc.cpp --
+ *
+ *      Probes how much memory a device really delivers.  MAX_MEM_ALLOC_SIZE
+ *      and GLOBAL_MEM_SIZE are upper bounds, and most drivers only back a
+ *      buffer with memory when it is first used, so a buffer only counts
+ *      here once it has been written and read back.
+ *
+ *      Failed allocations are the expected outcome of the capacity
+ *      searches, so this probe calls clCreateBuffer itself instead of
+ *      going through Bench_context::buffer, which reports every failure.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+#include "bench.h"
+
+using namespace std;
+
+#define MIB              (UINT64_C(1) << 20)
+#define LATENCY_MIN_SIZE 4096
+#define LATENCY_MAX_SIZE (UINT64_C(1) << 30)
+#define TOTAL_CHUNK      (256 * MIB)
+
+/**
+ * touch --
+ *
+ *      Writes a pattern over the whole buffer and reads back its last word.
+ *
+ * Results:
+ *      CL_SUCCESS and the elapsed host time, or the first error.
+ */
+static cl_int touch(cl_command_queue queue, cl_mem mem, size_t size, double* seconds)
+{
+  cl_uint pattern = 0x5a5a5a5a, check = 0;
+  cl_int err;
+  auto start = host_seconds();
+#ifdef CL_VERSION_1_2
+  err = clEnqueueFillBuffer(queue, mem, &pattern, sizeof pattern, 0, size, 0, NULL, NULL);
+#else
+  vector<cl_uint> chunk(min<size_t>(size, 16 * MIB) / sizeof pattern, pattern);
+  err = CL_SUCCESS;
+  for (size_t offset = 0; offset < size && CL_SUCCESS == err; offset += chunk.size() * sizeof pattern)
+    err = clEnqueueWriteBuffer(queue, mem, CL_FALSE, offset, min(size - offset, chunk.size() * sizeof pattern),
+                               chunk.data(), 0, NULL, NULL);
+#endif
+  if (CL_SUCCESS == err)
+    err = clEnqueueReadBuffer(queue, mem, CL_TRUE, size - sizeof check, sizeof check, &check, 0, NULL, NULL);
+  if (CL_SUCCESS == err && check != pattern)
+    err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  *seconds = host_seconds() - start;
+  return err;
+}
+
+/**
+ * try_allocate --
+ *
+ *      Allocates and touches a single buffer in a fresh context, since some
+ *      drivers leave a queue unusable after a failed allocation.
+ *
+ * Results:
+ *      CL_SUCCESS if the buffer could be allocated and written.
+ */
+static cl_int try_allocate(const string& tag, cl_device_id device, uint64_t size)
+{
+  Bench_context ctx(tag, vector<cl_device_id>(1, device));
+  if (!ctx)
+    return CL_OUT_OF_RESOURCES;
+  cl_int err;
+  double seconds;
+  auto mem = clCreateBuffer(ctx.get(), CL_MEM_READ_WRITE, size, NULL, &err);
+  if (CL_SUCCESS != err)
+    return err;
+  err = touch(ctx.queue(), mem, size, &seconds);
+  clReleaseMemObject(mem);
+  return err;
+}
+
+/**
+ * latency --
+ *
+ *      Times creating a buffer, touching it the first time and touching
+ *      it again, with a fresh buffer per run.  The harness repeats the
+ *      whole cycle; the three parts are summarized separately.
+ *
+ * Results:
+ *      void.
+ */
+static void latency(Bench_context& ctx, uint64_t max_alloc)
+{
+  Bench_policy policy;
+  policy.warmup = 0; /* the first allocation of a size is what we are after too */
+  policy.min_runs = 3;
+  policy.budget = 0.5;
+  for (uint64_t size = LATENCY_MIN_SIZE; size <= max_alloc && size <= LATENCY_MAX_SIZE; size *= 4)
+  {
+    vector<double> create, first, second;
+    cl_int err = CL_SUCCESS;
+    Bench_stats cycle;
+    bench_measure([&]() -> double
+    {
+      double t1, t2;
+      auto start = host_seconds();
+      auto mem = clCreateBuffer(ctx.get(), CL_MEM_READ_WRITE, size, NULL, &err);
+      auto t0 = host_seconds() - start;
+      if (CL_SUCCESS != err)
+        return -1.0;
+      if (CL_SUCCESS == (err = touch(ctx.queue(), mem, size, &t1)))
+        err = touch(ctx.queue(), mem, size, &t2);
+      clReleaseMemObject(mem);
+      if (CL_SUCCESS != err)
+        return -1.0;
+      create.push_back(t0);
+      first.push_back(t1);
+      second.push_back(t2);
+      return t0 + t1 + t2;
+    }, cycle, policy);
+    if (CL_SUCCESS != err)
+    {
+      cerr << ctx.name() << ": Unable to allocate " << format_bytes(size) << ": " << cl_error_str(err) << "!" << endl;
+      return;
+    }
+    auto prefix = "alloc " + format_bytes(size);
+    bench_report(ctx.name(), ctx.device(), prefix + " create", bench_summarize(create, policy.target_ci));
+    bench_report(ctx.name(), ctx.device(), prefix + " first touch", bench_summarize(first, policy.target_ci));
+    bench_report(ctx.name(), ctx.device(), prefix + " second touch", bench_summarize(second, policy.target_ci));
+  }
+}
+
+/**
+ * largest_buffer --
+ *
+ *      Binary-searches the largest buffer, in MiB steps, that can really
+ *      be allocated and written.
+ *
+ * Results:
+ *      the size in bytes, 0 if not even a MiB could be allocated.
+ */
+static uint64_t largest_buffer(const string& tag, cl_device_id device, uint64_t advertised)
+{
+  auto err = try_allocate(tag, device, advertised);
+  if (CL_SUCCESS == err)
+    return advertised;
+  cl_int last_err = err;
+  uint64_t good = 0, bad = advertised / MIB;
+  while (bad - good > 1)
+  {
+    auto mid = good + (bad - good) / 2;
+    err = try_allocate(tag, device, mid * MIB);
+    if (CL_SUCCESS == err)
+      good = mid;
+    else
+    {
+      bad = mid;
+      last_err = err;
+    }
+  }
+  cout << tag << ": allocations above " << format_bytes(good * MIB) << " fail with "
+       << cl_error_str(last_err) << endl;
+  return good * MIB;
+}
+
+/**
+ * total_memory --
+ *
+ *      Allocates and touches chunks, halving them when an allocation is
+ *      refused, until the limit is reached, chunks get below a MiB or
+ *      touching one fails.
+ *
+ * Results:
+ *      the total allocated size, with the number of buffers it took.
+ */
+static uint64_t total_memory(const string& tag, cl_device_id device, uint64_t chunk, uint64_t limit, size_t* count)
+{
+  Bench_context ctx(tag, vector<cl_device_id>(1, device));
+  vector<cl_mem> mems;
+  uint64_t total = 0;
+  double seconds;
+  while (ctx && chunk >= MIB)
+  {
+    if (total + chunk > limit)
+    {
+      chunk /= 2;
+      continue;
+    }
+    cl_int err;
+    auto mem = clCreateBuffer(ctx.get(), CL_MEM_READ_WRITE, chunk, NULL, &err);
+    if (CL_SUCCESS != err)
+    {
+      chunk /= 2;
+      continue;
+    }
+    /* A failed enqueue may leave the queue unusable: keep what was reached */
+    err = touch(ctx.queue(), mem, chunk, &seconds);
+    if (CL_SUCCESS != err)
+    {
+      clReleaseMemObject(mem);
+      cout << tag << ": touching a " << format_bytes(chunk) << " buffer after " << format_bytes(total)
+           << " failed with " << cl_error_str(err) << endl;
+      break;
+    }
+    mems.push_back(mem);
+    total += chunk;
+  }
+  *count = mems.size();
+  for (auto mem : mems)
+    clReleaseMemObject(mem);
+  return total;
+}
+
+void probe_alloc(const string& tag, cl_device_id device)
+{
+  auto max_alloc = device_uint(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE) / MIB * MIB;
+  auto global_mem = device_uint(device, CL_DEVICE_GLOBAL_MEM_SIZE);
+  if (0 == max_alloc || 0 == global_mem)
+  {
+    cerr << tag << ": Unable to get the advertised memory sizes!" << endl;
+    return;
+  }
+
+  {
+    Bench_context ctx(tag, vector<cl_device_id>(1, device));
+    if (!ctx)
+      return;
+    latency(ctx, max_alloc);
+  }
+
+  auto largest = largest_buffer(tag, device, max_alloc);
+  printf("%s: largest single buffer: %s of %s MAX_MEM_ALLOC_SIZE (%.1f%%)\n", tag.c_str(),
+         format_bytes(largest).c_str(), format_bytes(max_alloc).c_str(), 100.0 * largest / max_alloc);
+  if (0 == largest)
+    return;
+
+  /* CPU devices share host memory; do not push the host into swap or the OOM killer */
+  auto limit = global_mem;
+  const char* limited = "";
+#ifdef _SC_AVPHYS_PAGES
+  if (device_uint(device, CL_DEVICE_TYPE) & CL_DEVICE_TYPE_CPU)
+  {
+    uint64_t host_free = (uint64_t) sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+    if (host_free < limit)
+    {
+      limit = host_free;
+      limited = ", limited by free host memory";
+    }
+  }
+#endif
+  size_t count;
+  auto total = total_memory(tag, device, min(largest, TOTAL_CHUNK), limit, &count);
+  printf("%s: total allocatable    : %s in %zu buffers of %s GLOBAL_MEM_SIZE (%.1f%%%s)\n", tag.c_str(),
+         format_bytes(total).c_str(), count, format_bytes(global_mem).c_str(), 100.0 * total / global_mem, limited);
+}
@@ -0,0 +1,112 @@
+/**
+ * probe_zero_copy.cpp --
+ *
+ *      Tells whether mapping a buffer is zero-copy for each of the host
+ *      pointer flags.  A buffer counts as zero-copy when mapping it
+ *      always returns the same pointer (the host pointer itself for
+ *      CL_MEM_USE_HOST_PTR) and a map/unmap round trip costs a small
+ *      fraction of copying the same number of bytes.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "bench.h"
+
+using namespace std;
+
+#define BUFFER_SIZE  (16 << 20)
+#define HOST_ALIGN   4096
+#define COPY_RATIO   0.1 /* map + unmap must cost less than this many copies */
+
+/**
+ * map_unmap --
+ *
+ *      Maps the whole buffer for reading and writing and unmaps it again.
+ *
+ * Results:
+ *      the elapsed host time and the mapped pointer, nullptr on failure.
+ */
+static void* map_unmap(Bench_context& ctx, cl_mem mem, double* seconds)
+{
+  cl_int err;
+  auto start = host_seconds();
+  auto ptr = clEnqueueMapBuffer(ctx.queue(), mem, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, BUFFER_SIZE,
+                                0, NULL, NULL, &err);
+  if (!ctx.check(err, "map buffer"))
+    return nullptr;
+  /* Touch the mapping so a lazy copy-on-map cannot hide */
+  static_cast<volatile char*>(ptr)[0] = 1;
+  static_cast<volatile char*>(ptr)[BUFFER_SIZE - 1] = 1;
+  if (!ctx.check(clEnqueueUnmapMemObject(ctx.queue(), mem, ptr, 0, NULL, NULL), "unmap buffer")
+      || !ctx.finish())
+    return nullptr;
+  *seconds = host_seconds() - start;
+  return ptr;
+}
+
+void probe_zero_copy(const string& tag, cl_device_id device)
+{
+  static struct {cl_mem_flags flag; const char* name;} flags[] = {
+    {0,                     "DEFAULT"       },
+    {CL_MEM_ALLOC_HOST_PTR, "ALLOC_HOST_PTR"},
+    {CL_MEM_USE_HOST_PTR,   "USE_HOST_PTR"  },
+    {CL_MEM_COPY_HOST_PTR,  "COPY_HOST_PTR" },
+    {0, NULL}};
+
+  void* host_ptr;
+  if (0 != posix_memalign(&host_ptr, HOST_ALIGN, BUFFER_SIZE))
+  {
+    cerr << tag << ": Unable to allocate host memory!" << endl;
+    return;
+  }
+  memset(host_ptr, 0, BUFFER_SIZE);
+  vector<char> copy(BUFFER_SIZE);
+
+  for (int ii = 0; flags[ii].name != NULL; ++ii)
+  {
+    Bench_context ctx(tag, vector<cl_device_id>(1, device));
+    if (!ctx)
+      break;
+    auto uses_host_ptr = 0 != (flags[ii].flag & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR));
+    auto mem = ctx.buffer(CL_MEM_READ_WRITE | flags[ii].flag, BUFFER_SIZE, uses_host_ptr ? host_ptr : nullptr);
+    if (!mem)
+      continue;
+
+    double t;
+    auto first = map_unmap(ctx, mem, &t); /* the first map may allocate the host copy */
+    if (nullptr == first)
+      continue;
+    auto stable = true;
+    Bench_stats map_stats, copy_stats;
+    Bench_policy policy;
+    policy.warmup = 0;
+    if (!bench_measure([&]() -> double
+        {
+          auto ptr = map_unmap(ctx, mem, &t);
+          stable = stable && ptr == first;
+          return nullptr == ptr ? -1.0 : t;
+        }, map_stats, policy)
+        || !bench_measure([&]() -> double
+        {
+          auto start = host_seconds();
+          if (!ctx.check(clEnqueueReadBuffer(ctx.queue(), mem, CL_TRUE, 0, BUFFER_SIZE, copy.data(), 0, NULL, NULL), "read buffer"))
+            return -1.0;
+          return host_seconds() - start;
+        }, copy_stats))
+      continue;
+    string name = flags[ii].name;
+    bench_report(tag, device, "map+unmap " + name, map_stats);
+    bench_report(tag, device, "copy " + name, copy_stats, BUFFER_SIZE * 1e-9, "GB/s");
+    auto map_time = map_stats.median, copy_time = copy_stats.median;
+
+    auto at_host_ptr = CL_MEM_USE_HOST_PTR != flags[ii].flag || first == host_ptr;
+    auto cheap = map_time < COPY_RATIO * copy_time;
+    printf("%s: %-14s zero-copy: %-3s (map+unmap %9.2f us, copy %9.2f us, pointer %s%s)\n",
+           tag.c_str(), flags[ii].name, stable && at_host_ptr && cheap ? "yes" : "no",
+           map_time * 1e6, copy_time * 1e6, stable ? "stable" : "moves",
+           at_host_ptr ? "" : ", not the host pointer");
+  }
+  free(host_ptr);
+}
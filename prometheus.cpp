@@ -0,0 +1,320 @@
+/**
+ * prometheus.cpp --
+ *
+ *      Writes the device inventory as metrics for the node_exporter
+ *      textfile collector.  The static gauges cost a few clGetDeviceInfo
+ *      calls per device, cheap enough to export every few seconds.  The
+ *      optional probe costs a context, a tiny program and a few
+ *      milliseconds of device time per device, so its results are taken
+ *      over from the previous file until they reach a maximum age.
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <unistd.h>
+#include "bench.h"
+#include "icd.h"
+#include "inventory.h"
+
+using namespace std;
+
+#define PROBE_BUFFER_SIZE  (4 << 20)
+#define PROBE_BUDGET       0.005 /* seconds of timed runs per probe metric */
+
+namespace {
+
+struct Metric {
+  const char* name;
+  const char* help;
+  vector<pair<string, double>> samples; /* label set, value */
+};
+
+enum {
+  GLOBAL_MEM_BYTES,
+  COMPUTE_UNITS,
+  MAX_CLOCK_MHZ,
+  AVAILABLE,
+  PROBE_BANDWIDTH,
+  PROBE_LAUNCH_LATENCY,
+  PROBE_TIMESTAMP,
+  EXPORT_DURATION,
+  NUM_METRICS
+};
+
+Metric metrics[NUM_METRICS] = {
+  {"clinfo_global_mem_bytes",
+   "Size of the device global memory in bytes.", {}},
+  {"clinfo_compute_units",
+   "Number of parallel compute units of the device.", {}},
+  {"clinfo_max_clock_mhz",
+   "Maximum configured clock frequency of the device in MHz.", {}},
+  {"clinfo_available",
+   "Whether the device is available (1) or not (0); 0 without labels if no platform could be enumerated.", {}},
+  {"clinfo_probe_bandwidth_bytes_per_second",
+   "Device to device buffer copy bandwidth.", {}},
+  {"clinfo_probe_launch_seconds",
+   "Round trip time of an empty kernel launch.", {}},
+  {"clinfo_probe_timestamp_seconds",
+   "Unix time the probe results of the device were measured.", {}},
+  {"clinfo_export_duration_seconds",
+   "Time taken to collect these metrics.", {}},
+};
+
+}
+
+/**
+ * label_value --
+ *
+ *      Escapes a string for use as a label value.
+ *
+ * Results:
+ *      the quoted value.
+ */
+static string label_value(const string& s)
+{
+  string r = "\"";
+  for (auto c : s)
+  {
+    switch (c)
+    {
+    case '\\': r += "\\\\"; break;
+    case '"':  r += "\\\""; break;
+    case '\n': r += "\\n";  break;
+    default:   r += c;
+    }
+  }
+  return r + "\"";
+}
+
+static string platform_string(cl_platform_id platform, cl_platform_info param)
+{
+  char buf[4096];
+  if (CL_SUCCESS != icd_get_platform_info(platform, param, sizeof buf, buf, NULL))
+    return string();
+  buf[sizeof buf - 1] = '\0';
+  return buf;
+}
+
+static Bench_policy probe_policy()
+{
+  Bench_policy policy;
+  policy.min_runs = 3;
+  policy.budget = PROBE_BUDGET;
+  return policy;
+}
+
+/**
+ * probe_bandwidth --
+ *
+ *      Copies a small buffer on the device within the probe budget.
+ *
+ * Results:
+ *      the median bandwidth in bytes per second, negative on failure.
+ */
+static double probe_bandwidth(Bench_context& ctx)
+{
+  auto src = ctx.buffer(CL_MEM_READ_WRITE, PROBE_BUFFER_SIZE);
+  auto dst = ctx.buffer(CL_MEM_READ_WRITE, PROBE_BUFFER_SIZE);
+  if (!src || !dst)
+    return -1.0; /* the contents do not matter */
+
+  Bench_stats stats;
+  if (!bench_measure([&]() -> double
+      {
+        cl_event event;
+        if (!ctx.check(clEnqueueCopyBuffer(ctx.queue(), src, dst, 0, 0, PROBE_BUFFER_SIZE, 0, NULL, &event), "copy buffer"))
+          return -1.0;
+        auto t = event_seconds(event);
+        clReleaseEvent(event);
+        return t;
+      }, stats, probe_policy()))
+    return -1.0;
+  return 2.0 * PROBE_BUFFER_SIZE / stats.median;
+}
+
+/**
+ * probe_launch --
+ *
+ *      Launches an empty kernel and waits for it, within the probe
+ *      budget.
+ *
+ * Results:
+ *      the median round trip in seconds, negative on failure.
+ */
+static double probe_launch(Bench_context& ctx)
+{
+  auto program = ctx.build("__kernel void empty(void) {}");
+  auto kernel = program ? ctx.kernel(program, "empty") : nullptr;
+  if (!kernel)
+    return -1.0;
+
+  size_t one = 1;
+  Bench_stats stats;
+  if (!bench_measure([&]() -> double
+      {
+        auto start = host_seconds();
+        if (!ctx.enqueue(0, kernel, 1, &one) || !ctx.finish())
+          return -1.0;
+        return host_seconds() - start;
+      }, stats, probe_policy()))
+    return -1.0;
+  return stats.median;
+}
+
+/**
+ * previous_probes --
+ *
+ *      Reads the probe samples of the previous export at path.
+ *
+ * Results:
+ *      the values by metric name and label set, empty if there is no
+ *      previous file.
+ */
+static map<string, double> previous_probes(const string& path)
+{
+  map<string, double> samples;
+  ifstream in(path);
+  for (string line; getline(in, line); )
+  {
+    auto space = line.rfind(' ');
+    if (string::npos == space)
+      continue;
+    for (auto metric : {PROBE_BANDWIDTH, PROBE_LAUNCH_LATENCY, PROBE_TIMESTAMP})
+      if (0 == line.compare(0, strlen(metrics[metric].name), metrics[metric].name))
+        samples[line.substr(0, space)] = strtod(line.c_str() + space + 1, nullptr);
+  }
+  return samples;
+}
+
+/**
+ * write_metrics --
+ *
+ *      Writes the collected metrics to a temporary file next to path
+ *      and renames it over path, so the collector never sees a partial
+ *      file.
+ *
+ * Results:
+ *      true on success.
+ */
+static bool write_metrics(const string& path)
+{
+  auto tmp = path + ".tmp." + to_string(getpid());
+  auto fp = fopen(tmp.c_str(), "w");
+  if (nullptr == fp)
+  {
+    cerr << "Unable to create " << tmp << ": " << strerror(errno) << "!" << endl;
+    return false;
+  }
+  for (auto& metric : metrics)
+  {
+    if (metric.samples.empty())
+      continue;
+    fprintf(fp, "# HELP %s %s\n# TYPE %s gauge\n", metric.name, metric.help, metric.name);
+    for (auto& sample : metric.samples)
+      fprintf(fp, "%s%s %.17g\n", metric.name, sample.first.c_str(), sample.second);
+  }
+  auto ok = 0 == fflush(fp) && 0 == fsync(fileno(fp));
+  ok = 0 == fclose(fp) && ok;
+  if (!ok || 0 != rename(tmp.c_str(), path.c_str()))
+  {
+    cerr << "Unable to write " << path << ": " << strerror(errno) << "!" << endl;
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * write_unavailable --
+ *
+ *      Replaces the metrics with a single clinfo_available 0, so a stale
+ *      file cannot keep reporting devices that clinfo no longer sees.
+ *
+ * Results:
+ *      EXIT_FAILURE.
+ */
+static int write_unavailable(const string& path, double start)
+{
+  metrics[AVAILABLE].samples.push_back(make_pair(string(), 0.0));
+  metrics[EXPORT_DURATION].samples.push_back(make_pair(string(), host_seconds() - start));
+  write_metrics(path);
+  return EXIT_FAILURE;
+}
+
+int prometheus_export(const string& path, double probe_age)
+{
+  auto start = host_seconds();
+  auto previous = probe_age > 0 ? previous_probes(path) : map<string, double>();
+  auto enumeration = enumerate_devices();
+  report_enumeration(enumeration);
+  if (CL_SUCCESS != enumeration.status)
+    return write_unavailable(path, start);
+
+  for (size_t ii = 0; ii < enumeration.platforms.size(); ++ii)
+  {
+    auto& devices = enumeration.platforms[ii].devices;
+    auto platform_name = platform_string(enumeration.platforms[ii].id, CL_PLATFORM_NAME);
+
+    for (size_t jj = 0; jj < devices.size(); ++jj)
+    {
+      auto device = devices[jj];
+      stringstream labels;
+      labels << "{platform=" << label_value(platform_name) << ",platform_index=\"" << ii
+             << "\",device=" << label_value(device_string(device, CL_DEVICE_NAME))
+             << ",device_index=\"" << jj << "\"}";
+      auto l = labels.str();
+
+      static struct {int metric; cl_device_info param;} gauges[] = {
+        {GLOBAL_MEM_BYTES, CL_DEVICE_GLOBAL_MEM_SIZE    },
+        {COMPUTE_UNITS,    CL_DEVICE_MAX_COMPUTE_UNITS  },
+        {MAX_CLOCK_MHZ,    CL_DEVICE_MAX_CLOCK_FREQUENCY},
+        {AVAILABLE,        CL_DEVICE_AVAILABLE          }};
+      for (auto& gauge : gauges)
+      {
+        uint64_t val = 0; /* Narrower params fill only the low bytes */
+        auto err = icd_get_device_info(device, gauge.param, sizeof val, &val, NULL);
+        if (CL_SUCCESS == err)
+          metrics[gauge.metric].samples.push_back(make_pair(l, static_cast<double>(val)));
+        else
+          cerr << "platform[" << ii << "] device[" << jj << "]: Unable to get " << metrics[gauge.metric].name
+               << ": " << cl_error_str(err) << "!" << endl;
+      }
+
+      if (probe_age <= 0 || !device_uint(device, CL_DEVICE_AVAILABLE))
+        continue;
+      double now = time(nullptr);
+      auto taken = previous.find(metrics[PROBE_TIMESTAMP].name + l);
+      if (previous.end() != taken && now - taken->second < probe_age)
+      {
+        for (auto metric : {PROBE_BANDWIDTH, PROBE_LAUNCH_LATENCY, PROBE_TIMESTAMP})
+        {
+          auto sample = previous.find(metrics[metric].name + l);
+          if (previous.end() != sample)
+            metrics[metric].samples.push_back(make_pair(l, sample->second));
+        }
+        continue;
+      }
+      stringstream tag;
+      tag << "platform[" << ii << "] device[" << jj << "]";
+      Bench_context ctx(tag.str(), vector<cl_device_id>(1, device));
+      if (!ctx)
+        continue;
+      auto bandwidth = probe_bandwidth(ctx);
+      if (bandwidth > 0)
+        metrics[PROBE_BANDWIDTH].samples.push_back(make_pair(l, bandwidth));
+      auto launch = probe_launch(ctx);
+      if (launch > 0)
+        metrics[PROBE_LAUNCH_LATENCY].samples.push_back(make_pair(l, launch));
+      metrics[PROBE_TIMESTAMP].samples.push_back(make_pair(l, now));
+    }
+  }
+
+  metrics[EXPORT_DURATION].samples.push_back(make_pair(string(), host_seconds() - start));
+  return write_metrics(path) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,62 @@
+/**
+ * properties.h --
+ *
+ *      The device properties print_device() dumps by kind, as X-macro
+ *      lists of CL_DEVICE_* suffixes: integers, strings and bit fields
+ *      printed in hex.  --select builds its property registry from the
+ *      same lists.  The entries have no separators, so def() can expand
+ *      to initializers as well as to member declarations.
+ */
+#ifndef CLINFO_PROPERTIES_H
+#define CLINFO_PROPERTIES_H
+
+#define LONG_PROPS                           \
+    def(VENDOR_ID)                           \
+    def(MAX_COMPUTE_UNITS)                   \
+    def(MAX_WORK_ITEM_DIMENSIONS)            \
+    def(MAX_WORK_GROUP_SIZE)                 \
+    def(PREFERRED_VECTOR_WIDTH_CHAR)         \
+    def(PREFERRED_VECTOR_WIDTH_SHORT)        \
+    def(PREFERRED_VECTOR_WIDTH_INT)          \
+    def(PREFERRED_VECTOR_WIDTH_LONG)         \
+    def(PREFERRED_VECTOR_WIDTH_FLOAT)        \
+    def(PREFERRED_VECTOR_WIDTH_DOUBLE)       \
+    def(MAX_CLOCK_FREQUENCY)                 \
+    def(ADDRESS_BITS)                        \
+    def(MAX_MEM_ALLOC_SIZE)                  \
+    def(IMAGE_SUPPORT)                       \
+    def(MAX_READ_IMAGE_ARGS)                 \
+    def(MAX_WRITE_IMAGE_ARGS)                \
+    def(IMAGE2D_MAX_WIDTH)                   \
+    def(IMAGE2D_MAX_HEIGHT)                  \
+    def(IMAGE3D_MAX_WIDTH)                   \
+    def(IMAGE3D_MAX_HEIGHT)                  \
+    def(IMAGE3D_MAX_DEPTH)                   \
+    def(MAX_SAMPLERS)                        \
+    def(MAX_PARAMETER_SIZE)                  \
+    def(MEM_BASE_ADDR_ALIGN)                 \
+    def(MIN_DATA_TYPE_ALIGN_SIZE)            \
+    def(GLOBAL_MEM_CACHELINE_SIZE)           \
+    def(GLOBAL_MEM_CACHE_SIZE)               \
+    def(GLOBAL_MEM_SIZE)                     \
+    def(MAX_CONSTANT_BUFFER_SIZE)            \
+    def(MAX_CONSTANT_ARGS)                   \
+    def(LOCAL_MEM_SIZE)                      \
+    def(ERROR_CORRECTION_SUPPORT)            \
+    def(PROFILING_TIMER_RESOLUTION)          \
+    def(ENDIAN_LITTLE)                       \
+    def(AVAILABLE)                           \
+    def(COMPILER_AVAILABLE)                  \
+    def(HOST_UNIFIED_MEMORY)
+
+#define STR_PROPS                            \
+    def(NAME)                                \
+    def(VENDOR)                              \
+    def(PROFILE)                             \
+    def(VERSION)
+
+#define HEX_PROPS                            \
+    def(SINGLE_FP_CONFIG)                    \
+    def(QUEUE_PROPERTIES)
+
+#endif
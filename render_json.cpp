@@ -0,0 +1,93 @@
+/**
+ * render_json.cpp --
+ *
+ *      The inventory as one JSON document.  Properties keep their dump
+ *      names and raw values; a property whose query failed is an object
+ *      with the error instead:
+ *
+ *          {"platforms": [{"name": "...", ..., "devices": [
+ *            {"TYPE": 4, "NAME": "...", "VENDOR_ID": {"error": -30, "message": "invalid value"}, ...}]}]}
+ */
+#include "format.h"
+#include "inventory.h"
+#include "output.h"
+
+using namespace std;
+
+static void print_value(Output& out, uint64_t val)
+{
+  out.print("%llu", (unsigned long long) val);
+}
+
+static void print_value(Output& out, const string& val)
+{
+  out.print("\"%s\"", json_escape(val).c_str());
+}
+
+static void print_value(Output& out, const vector<uint64_t>& val)
+{
+  out.print("[");
+  for (size_t ii = 0; ii < val.size(); ++ii)
+    out.print("%s%llu", ii ? ", " : "", (unsigned long long) val[ii]);
+  out.print("]");
+}
+
+static void print_value(Output& out, const vector<cl_image_format>& val)
+{
+  out.print("[");
+  for (size_t ii = 0; ii < val.size(); ++ii)
+    out.print("%s{\"order\": %u, \"type\": %u}", ii ? ", " : "", val[ii].image_channel_order,
+              val[ii].image_channel_data_type);
+  out.print("]");
+}
+
+/**
+ * Property --
+ *
+ *      The visitor printing "name": value pairs, comma separated.
+ */
+struct Property {
+  Output& out;
+  const char* indent;
+  bool first;
+
+  template <typename T>
+  void operator()(const char* name, const Field<T>& field)
+  {
+    out.print("%s\n%s\"%s\": ", first ? "" : ",", indent, name);
+    first = false;
+    if (field.ok())
+      print_value(out, field.value);
+    else
+      out.print("{\"error\": %d, \"message\": \"%s\"}", field.status, cl_error_str(field.status));
+  }
+};
+
+void render_json(const Inventory& inventory, Output& out)
+{
+  out.print("{\n  \"status\": %d,\n  \"platforms\": [", inventory.status);
+  for (size_t ii = 0; ii < inventory.platforms.size(); ++ii)
+  {
+    auto& platform = inventory.platforms[ii];
+    out.print("%s\n    {", ii ? "," : "");
+    Property property = {out, "      ", true};
+    visit_platform(platform, property);
+    if (platform.crash_signal)
+      out.print(",\n      \"signal\": %d", platform.crash_signal);
+    out.print(",\n      \"devices_status\": %d,\n      \"devices\": [", platform.devices_status);
+    for (size_t jj = 0; jj < platform.devices.size(); ++jj)
+    {
+      auto& device = platform.devices[jj];
+      out.print("%s\n        {", jj ? "," : "");
+      Property property = {out, "          ", true};
+      visit_device(device, property);
+      if (device.image_formats_collected)
+        property("IMAGE_FORMATS", device.IMAGE_FORMATS);
+      out.print("\n        }");
+    }
+    out.print("\n      ]\n    }");
+    out.flush();
+  }
+  out.print("\n  ]\n}\n");
+  out.flush();
+}
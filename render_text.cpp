@@ -0,0 +1,455 @@
+/**
+ * render_text.cpp --
+ *
+ *      The classic clinfo dump, rendered from the inventory.
+ */
+#include <cstring>
+#include "inventory.h"
+#include "output.h"
+
+using namespace std;
+
+static string format_long(uint64_t val)
+{
+  string r = to_string(val % 1000);
+  while (val > 999)
+  {
+    auto x = val % 1000;
+    val = val / 1000;
+    r = to_string(val % 1000) + "," + (x < 100 ? (x < 10 ? string("00") + r : string("0") + r) : r);
+  }
+  return r;
+}
+
+static void print_extensions(Output& out, const Extension_set& set, int width)
+{
+  auto words = set.names();
+  for (vector<string>::size_type ii = 0; ii != words.size(); ++ii)
+    out.print("%*s%s\n", ii ? width : 0, "", words[ii].c_str());
+  if (words.empty())
+    out.print("\n");
+}
+
+/**
+ * print_flags --
+ *
+ *      Prints the names of the bits set in a bit field, and what is left.
+ *
+ * Results:
+ *      void.
+ */
+struct Flag { uint64_t bit; const char* name; };
+
+template <size_t N>
+static void print_flags(Output& out, uint64_t val, const Flag (&flags)[N])
+{
+  for (auto& flag : flags)
+  {
+    if (val & flag.bit)
+    {
+      val &= ~flag.bit;
+      out.print("%s ", flag.name);
+    }
+  }
+  if (val)
+    out.print("Unknown (0x%lx) ", (unsigned long) val);
+}
+
+/* Prints why a property is missing, unless it was skipped after a timeout. */
+static void print_error(Output& out, int device_index, const char* name, cl_int status)
+{
+  if (CLINFO_SKIPPED != status)
+    out.error("device[%d]: Unable to get %s: %s!\n", device_index, name, cl_error_str(status));
+}
+
+/**
+ * print_image_formats --
+ *
+ *      Dumps the image formats collected for the device.
+ *
+ * Results:
+ *      void.
+ */
+static void print_image_formats(Output& out, int device_index, const Device& d)
+{
+  if (!d.IMAGE_FORMATS.ok())
+  {
+    if (CLINFO_SKIPPED != d.IMAGE_FORMATS.status)
+      out.error("\tdevice[%d]: Unable to %s: %s!\n", device_index, d.image_formats_failed,
+                cl_error_str(d.IMAGE_FORMATS.status));
+    return;
+  }
+  auto& image_formats = d.IMAGE_FORMATS.value;
+  for (size_t fmt = 0; fmt < image_formats.size(); ++fmt)
+  {
+    if (fmt > 0) out.print("                                          ");
+    switch (image_formats[fmt].image_channel_order)
+    {
+    case CL_R:             out.print(" CL_R            "); break;
+    case CL_A:             out.print(" CL_A            "); break;
+    case CL_RG:            out.print(" CL_RG           "); break;
+    case CL_RA:            out.print(" CL_RA           "); break;
+    case CL_RGB:           out.print(" CL_RGB          "); break;
+    case CL_RGBA:          out.print(" CL_RGBA         "); break;
+    case CL_BGRA:          out.print(" CL_BGRA         "); break;
+    case CL_ARGB:          out.print(" CL_ARGB         "); break;
+    case CL_INTENSITY:     out.print(" CL_INTENSITY    "); break;
+    case CL_LUMINANCE:     out.print(" CL_LUMINANCE    "); break;
+    case CL_Rx:            out.print(" CL_Rx           "); break;
+    case CL_RGx:           out.print(" CL_RGx          "); break;
+    case CL_RGBx:          out.print(" CL_RGBx         "); break;
+#ifdef CL_DEPTH
+    case CL_DEPTH:         out.print(" CL_DEPTH        "); break;
+#endif
+#ifdef CL_DEPTH_STENCIL
+    case CL_DEPTH_STENCIL: out.print(" CL_DEPTH_STENCIL"); break;
+#endif
+    default:               out.print(" UKNOWN  %8x", image_formats[fmt].image_channel_order);
+    }
+    switch (image_formats[fmt].image_channel_data_type)
+    {
+    case CL_SNORM_INT8:      out.print(", CL_SNORM_INT8\n");      break;
+    case CL_SNORM_INT16:     out.print(", CL_SNORM_INT16\n");     break;
+    case CL_UNORM_INT8:      out.print(", CL_UNORM_INT8\n");      break;
+    case CL_UNORM_INT16:     out.print(", CL_UNORM_INT16\n");     break;
+    case CL_UNORM_SHORT_565: out.print(", CL_UNORM_SHORT_565\n"); break;
+    case CL_UNORM_SHORT_555: out.print(", CL_UNORM_SHORT_555\n"); break;
+    case CL_UNORM_INT_101010:out.print(", CL_UNORM_INT_101010\n");break;
+    case CL_SIGNED_INT8:     out.print(", CL_SIGNED_INT8\n");     break;
+    case CL_SIGNED_INT16:    out.print(", CL_SIGNED_INT16\n");    break;
+    case CL_SIGNED_INT32:    out.print(", CL_SIGNED_INT32\n");    break;
+    case CL_UNSIGNED_INT8:   out.print(", CL_UNSIGNED_INT8\n");   break;
+    case CL_UNSIGNED_INT16:  out.print(", CL_UNSIGNED_INT16\n");  break;
+    case CL_UNSIGNED_INT32:  out.print(", CL_UNSIGNED_INT32\n");  break;
+    case CL_HALF_FLOAT:      out.print(", CL_HALF_FLOAT\n");      break;
+    case CL_FLOAT:           out.print(", CL_FLOAT\n");           break;
+#ifdef CL_UNORM_INT24
+    case CL_UNORM_INT24:     out.print(", CL_UNORM_INT24\n");     break;
+#endif
+    default:                 out.print(", UKNOWN %8x\n", image_formats[fmt].image_channel_data_type);
+    }
+  }
+  if (CL_SUCCESS != d.image_formats_release && CLINFO_SKIPPED != d.image_formats_release)
+    out.error("\tdevice[%d]: Unable to release context: %s!\n", device_index, cl_error_str(d.image_formats_release));
+}
+
+/**
+ * print_number --
+ *
+ *      Prints an integer property with thousands separators, or why
+ *      there is none.
+ *
+ * Results:
+ *      void.
+ */
+static void print_number(Output& out, int device_index, const char* name, const Field<uint64_t>& field)
+{
+  if (!field.ok())
+  {
+    print_error(out, device_index, name, field.status);
+    return;
+  }
+  if (field.size > sizeof field.value)
+    out.error("device[%d]: Large %s (%zu bytes)!  Truncating to %zu!\n",
+              device_index, name, field.size, sizeof field.value);
+  out.print("device[%d]: %-30s: %s\n", device_index, name, format_long(field.value).c_str());
+}
+
+static void print_hex(Output& out, int device_index, const char* name, const Field<uint64_t>& field)
+{
+  if (!field.ok())
+  {
+    print_error(out, device_index, name, field.status);
+    return;
+  }
+  if (field.size > sizeof field.value)
+    out.error("device[%d]: Large %s (%zu bytes)!  Truncating to %zu!\n",
+              device_index, name, field.size, sizeof field.value);
+  out.print("device[%d]: %-30s: 0x%lx\n", device_index, name, (unsigned long) field.value);
+}
+
+/**
+ * print_device --
+ *
+ *      Dumps everything about the given device.
+ *
+ * Results:
+ *      void.
+ */
+static void print_device(Output& out, int device_index, const Device& d)
+{
+  if (d.TYPE.ok())
+  {
+    static const Flag types[] = {
+      {CL_DEVICE_TYPE_DEFAULT,     "Default"    },
+      {CL_DEVICE_TYPE_CPU,         "CPU"        },
+      {CL_DEVICE_TYPE_GPU,         "GPU"        },
+      {CL_DEVICE_TYPE_ACCELERATOR, "Accelerator"},
+    };
+    out.print("device[%d]: TYPE                          : ", device_index);
+    print_flags(out, d.TYPE.value, types);
+    out.print("\n");
+  }
+  else
+  {
+    print_error(out, device_index, "TYPE", d.TYPE.status);
+  }
+
+  struct { const char* name; const Field<string>& field; } strings[] = {
+#define def(X) {#X, d.X},
+    STR_PROPS
+#undef def
+    {"DRIVER_VERSION", d.DRIVER_VERSION},
+    {"EXTENSIONS", d.EXTENSIONS},
+  };
+  for (auto& s : strings)
+  {
+    if (!s.field.ok())
+    {
+      print_error(out, device_index, s.name, s.field.status);
+      continue;
+    }
+    if (s.field.size > INVENTORY_STRING)
+    {
+      out.error("device[%d]: Large %s (%zu bytes)!  Truncating to %zu!\n",
+                device_index, s.name, s.field.size, (size_t) INVENTORY_STRING);
+    }
+    out.print("device[%d]: %-30s: ", device_index, s.name);
+    if (&s.field != &d.EXTENSIONS)
+      out.print("%s\n", s.field.value.c_str());
+    else
+      print_extensions(out, d.extension_set, 43);
+  }
+
+  if (d.EXECUTION_CAPABILITIES.ok())
+  {
+    static const Flag capabilities[] = {
+      {CL_EXEC_KERNEL,        "Kernel"},
+      {CL_EXEC_NATIVE_KERNEL, "Native"},
+    };
+    out.print("device[%d]: EXECUTION_CAPABILITIES        : ", device_index);
+    print_flags(out, d.EXECUTION_CAPABILITIES.value, capabilities);
+    out.print("\n");
+  }
+  else
+  {
+    print_error(out, device_index, "EXECUTION_CAPABILITIES", d.EXECUTION_CAPABILITIES.status);
+  }
+
+  if (d.GLOBAL_MEM_CACHE_TYPE.ok())
+  {
+    static const char *cacheTypes[] = { "None", "Read-Only", "Read-Write" };
+    static size_t numTypes = sizeof cacheTypes / sizeof cacheTypes[0];
+    auto val = d.GLOBAL_MEM_CACHE_TYPE.value;
+
+    out.print("device[%d]: GLOBAL_MEM_CACHE_TYPE         : %s (%lu)\n",
+              device_index, val < numTypes ? cacheTypes[val] : "???", (unsigned long) val);
+  }
+  else
+  {
+    print_error(out, device_index, "GLOBAL_MEM_CACHE_TYPE", d.GLOBAL_MEM_CACHE_TYPE.status);
+  }
+  if (d.LOCAL_MEM_TYPE.ok())
+  {
+    static const char* memory_types[] = { "???", "Local", "Global" };
+    static size_t numTypes = sizeof memory_types / sizeof memory_types[0];
+    auto val = d.LOCAL_MEM_TYPE.value;
+
+    out.print("device[%d]: CL_DEVICE_LOCAL_MEM_TYPE      : %s (%lu)\n",
+              device_index, val < numTypes ? memory_types[val] : "???", (unsigned long) val);
+  }
+  else
+  {
+    print_error(out, device_index, "CL_DEVICE_LOCAL_MEM_TYPE", d.LOCAL_MEM_TYPE.status);
+  }
+
+#define def(X) print_hex(out, device_index, #X, d.X);
+  HEX_PROPS
+#undef def
+#define def(X) print_number(out, device_index, #X, d.X);
+  LONG_PROPS
+#undef def
+
+  if (!d.MAX_WORK_ITEM_SIZES.ok())
+  {
+    print_error(out, device_index, "MAX_WORK_ITEM_SIZES", d.MAX_WORK_ITEM_SIZES.status);
+  }
+  else
+  {
+    out.print("device[%d]: %-30s: ", device_index, "MAX_WORK_ITEM_SIZES");
+    for (size_t ii = 0; ii < d.MAX_WORK_ITEM_SIZES.value.size(); ++ii)
+      out.print("%s%lu", ii ? ", " : "", (unsigned long) d.MAX_WORK_ITEM_SIZES.value[ii]);
+    out.print("\n");
+  }
+#ifdef CL_VERSION_1_2
+  if (d.PARTITION_MAX_SUB_DEVICES.ok())
+  {
+    out.print("device[%d]: %-30s: %s\n", device_index, "PARTITION_MAX_SUB_DEVICES",
+              format_long(d.PARTITION_MAX_SUB_DEVICES.value).c_str());
+  }
+  else
+  {
+    print_error(out, device_index, "PARTITION_MAX_SUB_DEVICES", d.PARTITION_MAX_SUB_DEVICES.status);
+  }
+
+  if (d.PARTITION_PROPERTIES.ok())
+  {
+    auto& props = d.PARTITION_PROPERTIES.value;
+    out.print("device[%d]: PARTITION_PROPERTIES          : ", device_index);
+    for (auto prop : props)
+    {
+      switch (prop)
+      {
+      case 0:                                      break;
+      case CL_DEVICE_PARTITION_EQUALLY:            out.print("Equally "); break;
+      case CL_DEVICE_PARTITION_BY_COUNTS:          out.print("By-counts "); break;
+      case CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN: out.print("By-affinity-domain "); break;
+      default:                                     out.print("Unknown (0x%lx) ", (unsigned long) prop);
+      }
+    }
+    if (props.empty() || 0 == props[0])
+      out.print("None");
+    out.print("\n");
+  }
+  else
+  {
+    print_error(out, device_index, "PARTITION_PROPERTIES", d.PARTITION_PROPERTIES.status);
+  }
+
+  if (d.PARTITION_AFFINITY_DOMAIN.ok())
+  {
+    static const Flag domains[] = {
+      {CL_DEVICE_AFFINITY_DOMAIN_NUMA,               "NUMA"            },
+      {CL_DEVICE_AFFINITY_DOMAIN_L4_CACHE,           "L4-cache"        },
+      {CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE,           "L3-cache"        },
+      {CL_DEVICE_AFFINITY_DOMAIN_L2_CACHE,           "L2-cache"        },
+      {CL_DEVICE_AFFINITY_DOMAIN_L1_CACHE,           "L1-cache"        },
+      {CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE, "Next-partitionable"},
+    };
+    out.print("device[%d]: PARTITION_AFFINITY_DOMAIN     : ", device_index);
+    if (0 == d.PARTITION_AFFINITY_DOMAIN.value)
+      out.print("None ");
+    print_flags(out, d.PARTITION_AFFINITY_DOMAIN.value, domains);
+    out.print("\n");
+  }
+  else
+  {
+    print_error(out, device_index, "PARTITION_AFFINITY_DOMAIN", d.PARTITION_AFFINITY_DOMAIN.status);
+  }
+#endif
+#ifdef CL_VERSION_2_0
+  if (d.SVM_CAPABILITIES.ok())
+  {
+    static const Flag capabilities[] = {
+      {CL_DEVICE_SVM_COARSE_GRAIN_BUFFER, "Coarse-grain-buffer"},
+      {CL_DEVICE_SVM_FINE_GRAIN_BUFFER,   "Fine-grain-buffer"  },
+      {CL_DEVICE_SVM_FINE_GRAIN_SYSTEM,   "Fine-grain-system"  },
+      {CL_DEVICE_SVM_ATOMICS,             "Atomics"            },
+    };
+    out.print("device[%d]: SVM_CAPABILITIES              : ", device_index);
+    if (0 == d.SVM_CAPABILITIES.value)
+      out.print("None ");
+    print_flags(out, d.SVM_CAPABILITIES.value, capabilities);
+    out.print("\n");
+  }
+  else
+  {
+    print_error(out, device_index, "SVM_CAPABILITIES", d.SVM_CAPABILITIES.status);
+  }
+#endif
+  if (d.image_formats_collected && CLINFO_SKIPPED != d.IMAGE_FORMATS.status)
+  {
+    out.print("device[%d]: %-30s:", device_index, "IMAGE FORMATS");
+    print_image_formats(out, device_index, d);
+  }
+}
+
+/**
+ * print_platform --
+ *
+ *      Dumps everything about the given platform, flushing the output
+ *      once for the platform properties and once per device.
+ *
+ * Results:
+ *      false after an error the dump stops at; a timeout or a crashed
+ *      --isolate child only ends the platform.
+ */
+static bool print_platform(Output& out, int index, const Platform& p)
+{
+  if (p.crash_signal > 0)
+  {
+    out.error("platform[%d]: Collection crashed with signal %d (%s)!\n", index, p.crash_signal,
+              strsignal(p.crash_signal));
+    return true;
+  }
+  if (p.crash_signal < 0)
+  {
+    out.error("platform[%d]: Collection failed in its child process!\n", index);
+    return true;
+  }
+  auto ok = true;
+  cl_int failed = CL_SUCCESS;
+  auto print_property = [&](const char* name, const Field<string>& field)
+  {
+    if (!ok)
+      return;
+    if (!field.ok())
+    {
+      out.error("platform[%d]: Unable to get %s: %s\n", index, name, cl_error_str(field.status));
+      failed = field.status;
+      ok = false;
+      return;
+    }
+    if (field.size > INVENTORY_STRING)
+      out.error("platform[%d]: Huge %s (%zu bytes)!  Truncating to %zu\n",
+                index, name, field.size, (size_t) INVENTORY_STRING);
+    out.print("platform[%d]: %-10s: ", index, name);
+    if (&field != &p.extensions)
+      out.print("%s\n", field.value.c_str());
+    else
+      print_extensions(out, Extension_set(field.value.c_str()), 25);
+  };
+  visit_platform(p, print_property);
+  if (!ok)
+    return CLINFO_TIMED_OUT == failed;
+  if (CL_SUCCESS != p.devices_status)
+  {
+    out.error("platform[%d]: Unable to %s: %s\n", index, p.devices_failed, cl_error_str(p.devices_status));
+    return CLINFO_TIMED_OUT == p.devices_status;
+  }
+  auto num_devices = p.devices.size();
+  out.print("platform[%d], %zu device%s:\n", index, num_devices, num_devices == 1 ? "" : "s");
+  out.flush();
+  for (size_t ii = 0; ii < num_devices; ++ii)
+  {
+    print_device(out, ii, p.devices[ii]);
+    if (ii + 1 < num_devices)
+      out.print("--------------------------------------------------------------------------------\n");
+    out.flush();
+  }
+  return true;
+}
+
+bool render_text(const Inventory& inventory, Output& out)
+{
+  if (CL_SUCCESS != inventory.status)
+  {
+    out.error("Unable to %s: %s\n", inventory.failed, cl_error_str(inventory.status));
+    out.flush();
+    return false;
+  }
+  auto num_platforms = inventory.platforms.size();
+  out.print("%zu platform%s\n", num_platforms, num_platforms == 1 ? ":" : "s:");
+  for (size_t ii = 0; ii < num_platforms; ++ii)
+  {
+    if (!print_platform(out, ii, inventory.platforms[ii]))
+    {
+      out.flush();
+      return false;
+    }
+    if (ii + 1 < num_platforms)
+      out.print("================================================================================\n");
+  }
+  out.flush();
+  return true;
+}
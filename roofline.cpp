@@ -0,0 +1,445 @@
+/**
+ * roofline.cpp --
+ *
+ *      Measures the ceilings of a roofline model for each device: the
+ *      bandwidth of global, local and constant memory and the float,
+ *      double and integer throughput, all with short kernels timed by
+ *      the benchmark harness.  A user kernel with known operation and
+ *      byte counts per work-item can be placed on the roofline as well,
+ *      under the float (default), double or int compute ceiling:
+ *
+ *          --roofline-kernel file.cl:kernel:items:ops:bytes[:type]
+ *
+ *      Its buffer arguments get ROOFLINE_BYTES_PER_ITEM bytes per
+ *      work-item (capped by the device limits), local arguments
+ *      ROOFLINE_LOCAL_BYTES and scalar arguments are zero, so the kernel
+ *      should take its trip counts from constants or from the -D options
+ *      given on the command line.
+ *
+ *      The ceilings are printed and, with --roofline-out FILE, written as
+ *      JSON (for a .json file) or CSV.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "bench.h"
+
+using namespace std;
+
+#define GLOBAL_BYTES        (64 << 20)
+#define ITEMS_PER_UNIT      (1 << 14)
+#define LOCAL_ITERATIONS    256
+#define CONSTANT_ELEMENTS   1024 /* 16 KiB, well below the 64 KiB minimum */
+#define CONSTANT_ITERATIONS 256
+#define COMPUTE_ITERATIONS  256
+#define ROOFLINE_BYTES_PER_ITEM 64
+#define ROOFLINE_LOCAL_BYTES    4096
+
+static const char* roofline_source = R"CLC(
+__kernel void global_copy(__global const float4* a, __global float4* b)
+{
+  size_t i = get_global_id(0);
+  b[i] = a[i];
+}
+
+__kernel void local_read(__global float* out)
+{
+  __local float4 tile[256];
+  size_t l = get_local_id(0), n = get_local_size(0);
+  for (size_t i = l; i < 256; i += n)
+    tile[i] = (float4) (1.0f);
+  barrier(CLK_LOCAL_MEM_FENCE);
+  float4 x = (float4) (0.0f);
+  for (int i = 0; i < LOCAL_ITERATIONS; ++i)
+    x += tile[(l + i) & 255];
+  out[get_global_id(0)] = x.x + x.y + x.z + x.w;
+}
+
+__kernel void constant_read(__constant float4* c, __global float* out)
+{
+  size_t g = get_global_id(0);
+  float4 x = (float4) (0.0f);
+  for (int i = 0; i < CONSTANT_ITERATIONS; ++i)
+    x += c[(g + i) & (CONSTANT_ELEMENTS - 1)];
+  out[g] = x.x + x.y + x.z + x.w;
+}
+
+/* Eight independent chains of multiply-adds, 16 operations per iteration */
+#define COMPUTE(NAME, T)                                                \
+__kernel void NAME(__global T* out, T a, T b)                           \
+{                                                                       \
+  T x0 = (T) get_global_id(0), x1 = x0 + 1, x2 = x0 + 2, x3 = x0 + 3;   \
+  T x4 = x0 + 4, x5 = x0 + 5, x6 = x0 + 6, x7 = x0 + 7;                 \
+  for (int i = 0; i < COMPUTE_ITERATIONS; ++i)                          \
+  {                                                                     \
+    x0 = x0 * a + b; x1 = x1 * a + b; x2 = x2 * a + b; x3 = x3 * a + b; \
+    x4 = x4 * a + b; x5 = x5 * a + b; x6 = x6 * a + b; x7 = x7 * a + b; \
+  }                                                                     \
+  out[get_global_id(0)] = x0 + x1 + x2 + x3 + x4 + x5 + x6 + x7;        \
+}
+
+COMPUTE(compute_float, float)
+COMPUTE(compute_int, uint)
+#ifdef USE_DOUBLE
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+COMPUTE(compute_double, double)
+#endif
+)CLC";
+
+enum Ceiling { GLOBAL, LOCAL, CONSTANT, FLOAT, DOUBLE, INT, NUM_CEILINGS };
+
+static struct {const char* name; const char* kind; const char* unit;} ceilings[] = {
+  {"global",   "bandwidth", "GB/s"   },
+  {"local",    "bandwidth", "GB/s"   },
+  {"constant", "bandwidth", "GB/s"   },
+  {"float",    "compute",   "GFLOP/s"},
+  {"double",   "compute",   "GFLOP/s"},
+  {"int",      "compute",   "GIOP/s" }};
+
+namespace {
+
+struct Placement {
+  string name;
+  int ceiling;      /* the compute ceiling it is placed under */
+  double intensity; /* operations per byte */
+  double achieved;  /* operations per second */
+  double attainable;
+};
+
+struct Roofline {
+  string tag;
+  Device_identity device;
+  double values[NUM_CEILINGS]; /* per second, 0 if not measured */
+  vector<Placement> kernels;
+};
+
+vector<Roofline> rooflines;
+vector<string> user_kernels;
+string user_options;
+
+}
+
+void roofline_kernel(const string& spec, const string& options)
+{
+  user_kernels.push_back(spec);
+  user_options = options;
+}
+
+/**
+ * time_kernel --
+ *
+ *      Times a kernel whose arguments are set.
+ *
+ * Results:
+ *      true and the statistics if it was measured.
+ */
+static bool time_kernel(Bench_context& ctx, cl_kernel kernel, size_t global, const size_t* local, Bench_stats& stats)
+{
+  return bench_measure([&]() -> double
+  {
+    cl_event event;
+    if (!ctx.check(clEnqueueNDRangeKernel(ctx.queue(), kernel, 1, NULL, &global, local, 0, NULL, &event), "enqueue kernel"))
+      return -1.0;
+    auto t = event_seconds(event);
+    clReleaseEvent(event);
+    return t;
+  }, stats);
+}
+
+/**
+ * arg_size --
+ *
+ *      The size of a scalar or vector kernel argument from its type name.
+ *
+ * Results:
+ *      the size in bytes, 0 if the type is not known.
+ */
+static size_t arg_size(const string& type)
+{
+  static struct {const char* name; size_t size;} scalars[] = {
+    {"char", 1}, {"uchar", 1}, {"short", 2}, {"ushort", 2}, {"half", 2}, {"int", 4}, {"uint", 4},
+    {"float", 4}, {"long", 8}, {"ulong", 8}, {"double", 8}, {nullptr, 0}};
+  auto digits = type.find_first_of("0123456789");
+  auto base = type.substr(0, digits);
+  size_t width = digits == string::npos ? 1 : strtoul(type.c_str() + digits, nullptr, 10);
+  if (3 == width)
+    width = 4; /* three-component vectors are padded */
+  for (int ii = 0; scalars[ii].name != nullptr; ++ii)
+    if (base == scalars[ii].name)
+      return scalars[ii].size * width;
+  return 0;
+}
+
+/**
+ * place_kernel --
+ *
+ *      Builds and times a user kernel and places it on the roofline.
+ *
+ * Results:
+ *      void.
+ */
+static void place_kernel(const string& tag, cl_device_id device, const string& spec, Roofline& roofline)
+{
+  vector<string> parts;
+  stringstream ss(spec);
+  string part;
+  while (getline(ss, part, ':'))
+    parts.push_back(part);
+  int ceiling = FLOAT;
+  if (6 == parts.size())
+    for (ceiling = FLOAT; ceiling < NUM_CEILINGS && parts[5] != ceilings[ceiling].name; ++ceiling)
+      ;
+  if ((5 != parts.size() && 6 != parts.size()) || NUM_CEILINGS == ceiling)
+  {
+    cerr << "--roofline-kernel " << spec << ": expected file.cl:kernel:items:ops:bytes[:float|double|int]!" << endl;
+    return;
+  }
+  if (roofline.values[ceiling] <= 0 || roofline.values[GLOBAL] <= 0)
+  {
+    cerr << tag << ": " << parts[1] << ": no " << ceilings[ceiling].name << " ceiling to place it under!" << endl;
+    return;
+  }
+  size_t items = strtoull(parts[2].c_str(), nullptr, 10);
+  double flops = strtod(parts[3].c_str(), nullptr), bytes = strtod(parts[4].c_str(), nullptr);
+  ifstream in(parts[0]);
+  if (!in || 0 == items || flops <= 0 || bytes <= 0)
+  {
+    cerr << "--roofline-kernel " << spec << ": Unable to read " << parts[0] << " or bad counts!" << endl;
+    return;
+  }
+  string source((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+#ifdef CL_VERSION_1_2
+  Bench_context ctx(tag, vector<cl_device_id>(1, device));
+  auto program = ctx ? ctx.build(source.c_str(), ("-cl-kernel-arg-info " + user_options).c_str()) : nullptr;
+  auto kernel = program ? ctx.kernel(program, parts[1].c_str()) : nullptr;
+  if (!kernel)
+    return;
+  cl_uint num_args;
+  if (!ctx.check(clGetKernelInfo(kernel, CL_KERNEL_NUM_ARGS, sizeof num_args, &num_args, NULL), "get kernel arguments"))
+    return;
+  auto buffer_size = min<uint64_t>(items * ROOFLINE_BYTES_PER_ITEM, device_uint(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE));
+  auto constant_size = min<uint64_t>(buffer_size, device_uint(device, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE));
+  for (cl_uint ii = 0; ii < num_args; ++ii)
+  {
+    cl_kernel_arg_address_qualifier qualifier;
+    char type[256];
+    if (!ctx.check(clGetKernelArgInfo(kernel, ii, CL_KERNEL_ARG_ADDRESS_QUALIFIER, sizeof qualifier, &qualifier, NULL), "get argument qualifier")
+        || !ctx.check(clGetKernelArgInfo(kernel, ii, CL_KERNEL_ARG_TYPE_NAME, sizeof type, type, NULL), "get argument type"))
+      return;
+    if (CL_KERNEL_ARG_ADDRESS_GLOBAL == qualifier || CL_KERNEL_ARG_ADDRESS_CONSTANT == qualifier)
+    {
+      auto mem = ctx.buffer(CL_MEM_READ_WRITE, CL_KERNEL_ARG_ADDRESS_GLOBAL == qualifier ? buffer_size : constant_size);
+      if (!mem || !ctx.set_arg(kernel, ii, sizeof mem, &mem))
+        return;
+    }
+    else if (CL_KERNEL_ARG_ADDRESS_LOCAL == qualifier)
+    {
+      if (!ctx.set_arg(kernel, ii, ROOFLINE_LOCAL_BYTES, NULL))
+        return;
+    }
+    else
+    {
+      auto size = arg_size(type);
+      if (0 == size)
+      {
+        cerr << tag << ": " << parts[1] << ": cannot pass an argument of type " << type << "!" << endl;
+        return;
+      }
+      char zero[128] = {0};
+      if (!ctx.set_arg(kernel, ii, size, zero))
+        return;
+    }
+  }
+
+  Bench_stats stats;
+  if (!time_kernel(ctx, kernel, items, nullptr, stats))
+    return;
+  auto unit = ceilings[ceiling].unit;
+  bench_report(tag, device, "roofline " + parts[1], stats, items * flops * 1e-9, unit);
+  Placement p;
+  p.name = parts[1];
+  p.ceiling = ceiling;
+  p.intensity = flops / bytes;
+  p.achieved = items * flops / stats.median;
+  p.attainable = min(roofline.values[ceiling], p.intensity * roofline.values[GLOBAL]);
+  roofline.kernels.push_back(p);
+  auto ridge = roofline.values[ceiling] / roofline.values[GLOBAL];
+  printf("%s: %s at %.2f %s/byte: %.2f %s of %.2f attainable (%.0f%%), %s-bound\n",
+         tag.c_str(), p.name.c_str(), p.intensity, INT == ceiling ? "IOP" : "FLOP", p.achieved * 1e-9, unit,
+         p.attainable * 1e-9, 100.0 * p.achieved / p.attainable, p.intensity < ridge ? "memory" : "compute");
+#else
+  cerr << tag << ": placing a kernel requires OpenCL 1.2" << endl;
+#endif
+}
+
+void bench_roofline(const string& tag, cl_device_id device)
+{
+  Roofline roofline;
+  roofline.tag = tag;
+  roofline.device = device_identity(device);
+  fill(roofline.values, roofline.values + NUM_CEILINGS, 0.0);
+
+  auto use_double = string::npos != device_string(device, CL_DEVICE_EXTENSIONS).find("cl_khr_fp64");
+  auto items = ITEMS_PER_UNIT * max<uint64_t>(1, device_uint(device, CL_DEVICE_MAX_COMPUTE_UNITS));
+  size_t bytes = min<uint64_t>({GLOBAL_BYTES, device_uint(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE),
+                                device_uint(device, CL_DEVICE_GLOBAL_MEM_SIZE) / 4});
+  size_t elements = bytes / sizeof(cl_float4);
+  size_t local = 1;
+  while (local * 2 <= min<uint64_t>(256, device_uint(device, CL_DEVICE_MAX_WORK_GROUP_SIZE)))
+    local *= 2;
+
+  Bench_context ctx(tag, vector<cl_device_id>(1, device));
+  if (!ctx)
+    return;
+  stringstream options;
+  options << "-cl-mad-enable -DLOCAL_ITERATIONS=" << LOCAL_ITERATIONS << " -DCONSTANT_ELEMENTS=" << CONSTANT_ELEMENTS
+          << " -DCONSTANT_ITERATIONS=" << CONSTANT_ITERATIONS << " -DCOMPUTE_ITERATIONS=" << COMPUTE_ITERATIONS
+          << (use_double ? " -DUSE_DOUBLE" : "");
+  auto program = ctx.build(roofline_source, options.str().c_str());
+  if (!program)
+    return;
+
+  vector<cl_float4> ones(CONSTANT_ELEMENTS);
+  for (auto& v : ones)
+    for (auto& c : v.s)
+      c = 1.0f;
+  auto a = ctx.buffer(CL_MEM_READ_ONLY, bytes);
+  auto b = ctx.buffer(CL_MEM_WRITE_ONLY, bytes);
+  auto c = ctx.buffer(CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, CONSTANT_ELEMENTS * sizeof(cl_float4), ones.data());
+  auto out = ctx.buffer(CL_MEM_WRITE_ONLY, items * sizeof(cl_double));
+  if (!a || !b || !c || !out)
+    return;
+
+  /* Bytes or operations per work-item and work-items of each ceiling */
+  struct {const char* kernel; double work; size_t items; const size_t* local;} runs[NUM_CEILINGS] = {
+    {"global_copy",    2.0 * sizeof(cl_float4),                       elements, nullptr},
+    {"local_read",     1.0 * LOCAL_ITERATIONS * sizeof(cl_float4),    items,    &local },
+    {"constant_read",  1.0 * CONSTANT_ITERATIONS * sizeof(cl_float4), items,    nullptr},
+    {"compute_float",  16.0 * COMPUTE_ITERATIONS,                     items,    nullptr},
+    {"compute_double", 16.0 * COMPUTE_ITERATIONS,                     items,    nullptr},
+    {"compute_int",    16.0 * COMPUTE_ITERATIONS,                     items,    nullptr}};
+  /* Multipliers that keep the chains away from denormals and overflow */
+  cl_float fa = 0.999f, fb = 0.001f;
+  cl_double da = 0.999, db = 0.001;
+  cl_uint ia = 3, ib = 1;
+
+  for (int ii = 0; ii < NUM_CEILINGS; ++ii)
+  {
+    if (DOUBLE == ii && !use_double)
+      continue;
+    auto kernel = ctx.kernel(program, runs[ii].kernel);
+    if (!kernel)
+      return;
+    auto set = [&](cl_uint index, size_t size, const void* value) { return ctx.set_arg(kernel, index, size, value); };
+    bool ok;
+    switch (ii)
+    {
+    case GLOBAL:
+      ok = set(0, sizeof a, &a) && set(1, sizeof b, &b);
+      break;
+    case LOCAL:
+      ok = set(0, sizeof out, &out);
+      break;
+    case CONSTANT:
+      ok = set(0, sizeof c, &c) && set(1, sizeof out, &out);
+      break;
+    case FLOAT:
+      ok = set(0, sizeof out, &out) && set(1, sizeof fa, &fa) && set(2, sizeof fb, &fb);
+      break;
+    case DOUBLE:
+      ok = set(0, sizeof out, &out) && set(1, sizeof da, &da) && set(2, sizeof db, &db);
+      break;
+    default:
+      ok = set(0, sizeof out, &out) && set(1, sizeof ia, &ia) && set(2, sizeof ib, &ib);
+    }
+    if (!ok)
+      return;
+    Bench_stats stats;
+    if (!time_kernel(ctx, kernel, runs[ii].items, runs[ii].local, stats))
+      return;
+    auto work = runs[ii].work * runs[ii].items;
+    bench_report(tag, device, string("roofline ") + ceilings[ii].name, stats, work * 1e-9, ceilings[ii].unit);
+    roofline.values[ii] = work / stats.median;
+  }
+  printf("%s: roofline ridge point at %.2f FLOP/byte of global memory\n",
+         tag.c_str(), roofline.values[FLOAT] / roofline.values[GLOBAL]);
+
+  for (auto& spec : user_kernels)
+    place_kernel(tag, device, spec, roofline);
+  rooflines.push_back(roofline);
+}
+
+static void write_json(ostream& out)
+{
+  out << "{\"devices\": [";
+  for (size_t ii = 0; ii < rooflines.size(); ++ii)
+  {
+    auto& r = rooflines[ii];
+    out << (ii ? "," : "") << "\n  {\"tag\": \"" << r.tag << "\", \"platform\": \"" << json_escape(r.device.platform)
+        << "\", \"device\": \"" << json_escape(r.device.name) << "\", \"driver\": \"" << json_escape(r.device.driver)
+        << "\",\n   \"ceilings\": {";
+    auto first = true;
+    for (int jj = 0; jj < NUM_CEILINGS; ++jj)
+    {
+      if (r.values[jj] <= 0)
+        continue;
+      out << (first ? "" : ", ") << "\"" << ceilings[jj].name << "\": " << r.values[jj];
+      first = false;
+    }
+    out << "},\n   \"kernels\": [";
+    for (size_t jj = 0; jj < r.kernels.size(); ++jj)
+    {
+      auto& k = r.kernels[jj];
+      out << (jj ? ", " : "") << "{\"name\": \"" << json_escape(k.name) << "\", \"ceiling\": \""
+          << ceilings[k.ceiling].name << "\", \"intensity\": " << k.intensity
+          << ", \"achieved\": " << k.achieved << ", \"attainable\": " << k.attainable << "}";
+    }
+    out << "]}";
+  }
+  out << "\n]}\n";
+}
+
+/* Quotes a CSV field. */
+static string csv(const string& s)
+{
+  string r = "\"";
+  for (auto c : s)
+    r += '"' == c ? string("\"\"") : string(1, c);
+  return r + "\"";
+}
+
+static void write_csv(ostream& out)
+{
+  out << "tag,platform,device,driver,kind,name,intensity,value,ceiling\n";
+  for (auto& r : rooflines)
+  {
+    auto prefix = csv(r.tag) + "," + csv(r.device.platform) + "," + csv(r.device.name) + "," + csv(r.device.driver) + ",";
+    for (int ii = 0; ii < NUM_CEILINGS; ++ii)
+      if (r.values[ii] > 0)
+        out << prefix << ceilings[ii].kind << "," << ceilings[ii].name << ",," << r.values[ii] << ",\n";
+    for (auto& k : r.kernels)
+      out << prefix << "kernel," << csv(k.name) << "," << k.intensity << "," << k.achieved << ","
+          << ceilings[k.ceiling].name << "\n";
+  }
+}
+
+bool roofline_write(const string& path)
+{
+  ofstream out(path);
+  if (!out)
+  {
+    cerr << "Unable to create " << path << "!" << endl;
+    return false;
+  }
+  out.precision(6);
+  if (path.size() >= 5 && 0 == path.compare(path.size() - 5, 5, ".json"))
+    write_json(out);
+  else
+    write_csv(out);
+  return static_cast<bool>(out);
+}
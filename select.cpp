@@ -0,0 +1,476 @@
+/**
+ * select.cpp --
+ *
+ *      Device selection with constraint expressions (clinfo --select):
+ *
+ *          type == GPU && GLOBAL_MEM_SIZE >= 8GiB && has(cl_khr_fp64)
+ *
+ *      Names are the properties print_device() dumps, without CL_DEVICE_
+ *      and in any case, plus TYPE; numbers take K, M, G and T suffixes
+ *      (optionally followed by iB or B, all binary) and strings are
+ *      quoted.  Integer properties compare with == != < <= > >= and
+ *      stand alone for != 0, strings and TYPE with == and !=; && || !
+ *      and parentheses combine the tests.
+ *
+ *      The expression is compiled into a tree once.  Evaluation fetches
+ *      a property from the driver the first time a device needs it and
+ *      && and || short-circuit, so a device costs at most one call per
+ *      property the expression names and often fewer.
+ */
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include "bench.h"
+#include "extensions.h"
+#include "icd.h"
+#include "inventory.h"
+#include "properties.h"
+
+using namespace std;
+
+namespace {
+
+enum Kind { NUMBER, STRING, TYPE };
+
+struct Property {
+  const char* name;
+  cl_device_info param;
+  Kind kind;
+};
+
+const Property registry[] = {
+#define def(X) {#X, CL_DEVICE_##X, NUMBER},
+  LONG_PROPS
+  HEX_PROPS
+#undef def
+#define def(X) {#X, CL_DEVICE_##X, STRING},
+  STR_PROPS
+#undef def
+  {"DRIVER_VERSION", CL_DRIVER_VERSION, STRING},
+  {"TYPE", CL_DEVICE_TYPE, TYPE},
+};
+
+const size_t NUM_PROPERTIES = sizeof registry / sizeof registry[0];
+
+const struct { const char* name; cl_device_type type; } types[] = {
+  { "CPU",         CL_DEVICE_TYPE_CPU         },
+  { "GPU",         CL_DEVICE_TYPE_GPU         },
+  { "ACCELERATOR", CL_DEVICE_TYPE_ACCELERATOR },
+  { "DEFAULT",     CL_DEVICE_TYPE_DEFAULT     },
+};
+
+enum Op { EQ, NE, LT, LE, GT, GE };
+
+enum Node_kind { PROP, HAS, COMPARE, NOT, AND, OR };
+
+struct Node {
+  Node_kind kind;
+  size_t prop;     /* PROP and COMPARE */
+  Op op;           /* COMPARE */
+  uint64_t number; /* COMPARE with an integer or a type */
+  string text;     /* COMPARE with a string */
+  int extension;   /* HAS */
+  unique_ptr<Node> left, right;
+};
+
+/* The lazily fetched values of one device. */
+struct Values {
+  cl_device_id device;
+  vector<int> fetched; /* per property: 0 not yet, 1 ok, -1 failed */
+  vector<uint64_t> numbers;
+  vector<string> strings;
+  int extensions_fetched;
+  Extension_set extensions;
+  const char* failed;  /* the first property that could not be queried */
+  cl_int status;       /* of its query, CL_SUCCESS if unknown */
+};
+
+class Parser {
+
+public:
+
+  explicit Parser(const string& text) : text(text), pos(0) {}
+
+  unique_ptr<Node> parse()
+  {
+    auto node = parse_or();
+    skip();
+    if (pos < text.size())
+      fail("unexpected '" + text.substr(pos, 1) + "'");
+    return node;
+  }
+
+  bool ok() const { return error.empty(); }
+  const string& message() const { return error; }
+
+private:
+  const string& text;
+  size_t pos;
+  string error;
+
+  void fail(const string& what)
+  {
+    if (error.empty())
+      error = "column " + to_string(pos + 1) + ": " + what;
+    pos = text.size();
+  }
+
+  void skip()
+  {
+    while (pos < text.size() && isspace((unsigned char) text[pos]))
+      ++pos;
+  }
+
+  bool accept(const char* token)
+  {
+    skip();
+    auto n = strlen(token);
+    if (0 != text.compare(pos, n, token))
+      return false;
+    pos += n;
+    return true;
+  }
+
+  string identifier()
+  {
+    skip();
+    auto start = pos;
+    while (pos < text.size() && (isalnum((unsigned char) text[pos]) || '_' == text[pos]))
+      ++pos;
+    return text.substr(start, pos - start);
+  }
+
+  unique_ptr<Node> join(Node_kind kind, unique_ptr<Node> left, unique_ptr<Node> right)
+  {
+    unique_ptr<Node> node(new Node());
+    node->kind = kind;
+    node->left = move(left);
+    node->right = move(right);
+    return node;
+  }
+
+  unique_ptr<Node> parse_or()
+  {
+    auto node = parse_and();
+    while (ok() && accept("||"))
+      node = join(OR, move(node), parse_and());
+    return node;
+  }
+
+  unique_ptr<Node> parse_and()
+  {
+    auto node = parse_unary();
+    while (ok() && accept("&&"))
+      node = join(AND, move(node), parse_unary());
+    return node;
+  }
+
+  unique_ptr<Node> parse_unary()
+  {
+    if (accept("!"))
+      return join(NOT, parse_unary(), nullptr);
+    if (accept("("))
+    {
+      auto node = parse_or();
+      if (!accept(")"))
+        fail("expected ')'");
+      return node;
+    }
+    return parse_test();
+  }
+
+  /* has(EXT), PROPERTY or PROPERTY OP VALUE */
+  unique_ptr<Node> parse_test()
+  {
+    unique_ptr<Node> node(new Node());
+    auto name = identifier();
+    if (name.empty())
+    {
+      fail("expected a property or has()");
+      return node;
+    }
+    if ("has" == name && accept("("))
+    {
+      auto extension = identifier();
+      if (extension.empty() || !accept(")"))
+        fail("expected has(EXTENSION)");
+      node->kind = HAS;
+      node->extension = Extension_set::intern(extension);
+      return node;
+    }
+    for (auto& c : name)
+      c = toupper((unsigned char) c);
+    if (0 == name.compare(0, 10, "CL_DEVICE_"))
+      name = name.substr(10);
+    for (node->prop = 0; node->prop < NUM_PROPERTIES; ++node->prop)
+      if (name == registry[node->prop].name)
+        break;
+    if (NUM_PROPERTIES == node->prop)
+    {
+      fail("unknown property " + name);
+      return node;
+    }
+    auto kind = registry[node->prop].kind;
+
+    static const struct { const char* token; Op op; } ops[] = {
+      {"==", EQ}, {"!=", NE}, {"<=", LE}, {">=", GE}, {"<", LT}, {">", GT},
+    };
+    size_t ii;
+    for (ii = 0; ii < sizeof ops / sizeof ops[0]; ++ii)
+      if (accept(ops[ii].token))
+        break;
+    if (sizeof ops / sizeof ops[0] == ii)
+    {
+      if (NUMBER != kind)
+        fail(name + " needs a comparison");
+      node->kind = PROP;
+      return node;
+    }
+    node->kind = COMPARE;
+    node->op = ops[ii].op;
+    if (NUMBER != kind && EQ != node->op && NE != node->op)
+      fail(name + " supports only == and != comparisons");
+    if (NUMBER == kind)
+      node->number = number();
+    else if (STRING == kind)
+      node->text = quoted();
+    else
+      node->number = type();
+    return node;
+  }
+
+  /* One token: digits, then a unit without spaces, as in 8GiB */
+  uint64_t number()
+  {
+    skip();
+    auto first = pos;
+    auto start = text.c_str() + pos;
+    char* end;
+    auto hex = '0' == start[0] && 'x' == tolower((unsigned char) start[1]);
+    errno = 0;
+    auto value = strtoull(start, &end, hex ? 16 : 10);
+    if (end == start || !isdigit((unsigned char) *start))
+    {
+      fail("expected a number");
+      return 0;
+    }
+    auto overflow = ERANGE == errno;
+    pos += end - start;
+    static const char units[] = "KMGT";
+    auto unit = pos < text.size() ? strchr(units, toupper((unsigned char) text[pos])) : nullptr;
+    if (unit)
+    {
+      auto shift = 10 * (unit - units + 1);
+      overflow = overflow || value > UINT64_MAX >> shift;
+      value <<= shift;
+      ++pos;
+      if (0 == text.compare(pos, 2, "iB"))
+        pos += 2;
+      else if (0 == text.compare(pos, 1, "B"))
+        ++pos;
+    }
+    if (pos < text.size() && (isalnum((unsigned char) text[pos]) || '_' == text[pos]))
+      fail("unexpected '" + text.substr(pos, 1) + "' in a number");
+    else if (overflow)
+    {
+      auto last = pos;
+      pos = first;
+      fail(text.substr(first, last - first) + " does not fit in 64 bits");
+    }
+    return value;
+  }
+
+  string quoted()
+  {
+    skip();
+    if (pos >= text.size() || '"' != text[pos])
+    {
+      fail("expected a quoted string");
+      return string();
+    }
+    auto end = text.find('"', pos + 1);
+    if (string::npos == end)
+    {
+      fail("unterminated string");
+      return string();
+    }
+    auto s = text.substr(pos + 1, end - pos - 1);
+    pos = end + 1;
+    return s;
+  }
+
+  cl_device_type type()
+  {
+    auto name = identifier();
+    for (auto& c : name)
+      c = toupper((unsigned char) c);
+    for (auto& t : types)
+      if (name == t.name)
+        return t.type;
+    fail("expected CPU, GPU, ACCELERATOR or DEFAULT");
+    return 0;
+  }
+};
+
+}
+
+/**
+ * fetch --
+ *
+ *      Queries a property of a device unless it already has.
+ *
+ * Results:
+ *      true if the value is known.
+ */
+static bool fetch(Values& values, size_t prop)
+{
+  if (values.fetched[prop])
+    return values.fetched[prop] > 0;
+  auto& p = registry[prop];
+  cl_int err;
+  if (STRING == p.kind)
+  {
+    size_t size = 0;
+    err = icd_get_device_info(values.device, p.param, 0, NULL, &size);
+    vector<char> buf(size + 1);
+    if (CL_SUCCESS == err)
+      err = icd_get_device_info(values.device, p.param, size, buf.data(), NULL);
+    values.strings[prop] = buf.data();
+  }
+  else
+  {
+    uint64_t val = 0; /* Narrower params fill only the low bytes */
+    err = icd_get_device_info(values.device, p.param, sizeof val, &val, NULL);
+    values.numbers[prop] = val;
+  }
+  values.fetched[prop] = CL_SUCCESS == err ? 1 : -1;
+  if (CL_SUCCESS != err && !values.failed)
+  {
+    values.failed = p.name;
+    values.status = err;
+  }
+  return CL_SUCCESS == err;
+}
+
+static bool compare(uint64_t a, Op op, uint64_t b)
+{
+  switch (op)
+  {
+  case EQ: return a == b;
+  case NE: return a != b;
+  case LT: return a < b;
+  case LE: return a <= b;
+  case GT: return a > b;
+  case GE: return a >= b;
+  }
+  return false;
+}
+
+/**
+ * evaluate --
+ *
+ *      Evaluates the expression for one device.  A property the driver
+ *      does not report is recorded in values.failed, which makes the
+ *      answer unknown whatever the rest of the expression gives.
+ *
+ * Results:
+ *      whether the device matches, if nothing failed.
+ */
+static bool evaluate(const Node& node, Values& values)
+{
+  switch (node.kind)
+  {
+  case NOT:
+    return !evaluate(*node.left, values);
+  case AND:
+    return evaluate(*node.left, values) && evaluate(*node.right, values);
+  case OR:
+    return evaluate(*node.left, values) || evaluate(*node.right, values);
+  case HAS:
+    if (0 == values.extensions_fetched)
+    {
+      values.extensions_fetched = device_extensions(values.device, values.extensions) ? 1 : -1;
+      if (values.extensions_fetched < 0 && !values.failed)
+      {
+        values.failed = "EXTENSIONS";
+        values.status = CL_SUCCESS;
+      }
+    }
+    return values.extensions.has(node.extension);
+  case PROP:
+    return fetch(values, node.prop) && 0 != values.numbers[node.prop];
+  case COMPARE:
+    if (!fetch(values, node.prop))
+      return false;
+    switch (registry[node.prop].kind)
+    {
+    case NUMBER:
+      return compare(values.numbers[node.prop], node.op, node.number);
+    case STRING:
+      return (values.strings[node.prop] == node.text) == (EQ == node.op);
+    case TYPE:
+      return (0 != (values.numbers[node.prop] & node.number)) == (EQ == node.op);
+    }
+  }
+  return false;
+}
+
+bool select_check(const string& expression, string& error)
+{
+  Parser parser(expression);
+  parser.parse();
+  error = parser.message();
+  return parser.ok();
+}
+
+int select_devices(const string& expression)
+{
+  Parser parser(expression);
+  auto tree = parser.parse();
+  if (!parser.ok())
+  {
+    cerr << "--select: " << parser.message() << "!" << endl;
+    return EXIT_QUERY_FAILED;
+  }
+
+  auto enumeration = enumerate_devices();
+  auto failures = report_enumeration(enumeration) ? 0 : 1;
+  auto matches = 0;
+  for (size_t ii = 0; ii < enumeration.platforms.size(); ++ii)
+  {
+    auto& devices = enumeration.platforms[ii].devices;
+    for (size_t jj = 0; jj < devices.size(); ++jj)
+    {
+      Values values;
+      values.device = devices[jj];
+      values.fetched.assign(NUM_PROPERTIES, 0);
+      values.numbers.assign(NUM_PROPERTIES, 0);
+      values.strings.assign(NUM_PROPERTIES, string());
+      values.extensions_fetched = 0;
+      values.failed = nullptr;
+      values.status = CL_SUCCESS;
+      auto match = evaluate(*tree, values);
+      if (values.failed)
+      {
+        cerr << "platform[" << ii << "] device[" << jj << "]: Unable to get " << values.failed;
+        if (CL_SUCCESS != values.status)
+          cerr << ": " << cl_error_str(values.status);
+        cerr << "!" << endl;
+        ++failures;
+      }
+      else if (match)
+      {
+        printf("%zu:%zu\n", ii, jj);
+        ++matches;
+      }
+    }
+  }
+  /* A device that could not be queried may be a missing match */
+  if (failures)
+    return EXIT_QUERY_FAILED;
+  return matches ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,167 @@
+/**
+ * self_bench.cpp --
+ *
+ *      How long clinfo itself takes to discover the devices, phase by
+ *      phase.  Each vendor library listed in the ICD vendors directory
+ *      is loaded with icd_open(), which is its dlopen and
+ *      clIcdGetPlatformIDsKHR, and its devices enumerated, so every
+ *      vendor's cost is its own pair of phases; then come property
+ *      collection and the contexts the image format listing creates.
+ *
+ *      Cold runs happen in fresh child processes forked before this one
+ *      touches OpenCL, so every library is loaded and every driver
+ *      initialised again; warm runs repeat the discovery in process
+ *      after one untimed run, with everything resident.
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench.h"
+#include "icd.h"
+#include "inventory.h"
+
+using namespace std;
+
+/**
+ * discover --
+ *
+ *      Goes through the discovery path once.
+ *
+ * Results:
+ *      the seconds of each phase, in the order of phase_names(), then
+ *      the total; empty if a vendor library could not be loaded.
+ */
+static vector<double> discover(const vector<string>& libraries)
+{
+  vector<double> seconds;
+  auto start = host_seconds(), last = start;
+  auto lap = [&]
+  {
+    auto now = host_seconds();
+    seconds.push_back(now - last);
+    last = now;
+  };
+
+  /* Library by library, so each vendor's share is its own phase */
+  vector<cl_device_id> devices;
+  for (auto& library : libraries)
+  {
+    if (!icd_open(vector<string>(1, library)))
+      return vector<double>();
+    lap();
+    auto enumeration = enumerate_devices();
+    report_enumeration(enumeration);
+    for (auto& platform : enumeration.platforms)
+      devices.insert(devices.end(), platform.devices.begin(), platform.devices.end());
+    lap();
+  }
+
+  vector<Device> collected;
+  for (size_t ii = 0; ii < devices.size(); ++ii)
+    collected.push_back(collect_device(ii, devices[ii]));
+  lap();
+
+  for (auto& device : collected)
+    collect_image_formats(device);
+  lap();
+
+  seconds.push_back(host_seconds() - start);
+  return seconds;
+}
+
+static vector<string> phase_names(const vector<string>& libraries)
+{
+  vector<string> names;
+  for (auto& library : libraries)
+  {
+    auto name = library.substr(library.rfind('/') + 1);
+    names.push_back("load " + name);
+    names.push_back("enumerate " + name);
+  }
+  names.push_back("property collection");
+  names.push_back("image format contexts");
+  names.push_back("total");
+  return names;
+}
+
+/**
+ * discover_cold --
+ *
+ *      Runs discover() in a child process, which sends the times back.
+ *
+ * Results:
+ *      the times, empty if the child failed.
+ */
+static vector<double> discover_cold(const vector<string>& libraries, size_t num_phases)
+{
+  vector<double> seconds(num_phases);
+  int fds[2];
+  if (0 != pipe(fds))
+    return vector<double>();
+  auto pid = fork();
+  if (0 == pid)
+  {
+    close(fds[0]);
+    auto times = discover(libraries);
+    auto ok = times.size() * sizeof times[0] == (size_t) write(fds[1], times.data(), times.size() * sizeof times[0]);
+    _exit(ok ? 0 : 1);
+  }
+  close(fds[1]);
+  size_t got = 0, want = num_phases * sizeof seconds[0];
+  for (ssize_t n = 1; pid > 0 && got < want && n > 0; )
+  {
+    n = read(fds[0], reinterpret_cast<char*>(seconds.data()) + got, want - got);
+    if (n > 0)
+      got += n;
+  }
+  close(fds[0]);
+  int status = 0;
+  while (pid > 0 && waitpid(pid, &status, 0) < 0)
+    if (EINTR != errno)
+      return vector<double>();
+  if (pid < 0 || got != want || !WIFEXITED(status) || 0 != WEXITSTATUS(status))
+    return vector<double>();
+  return seconds;
+}
+
+static void report(const char* tag, const vector<string>& names, const vector<vector<double>>& samples)
+{
+  for (size_t ii = 0; ii < names.size(); ++ii)
+    bench_report(tag, nullptr, names[ii], bench_summarize(samples[ii]));
+}
+
+int self_bench(unsigned runs)
+{
+  auto libraries = icd_libraries("*");
+  auto names = phase_names(libraries);
+  vector<vector<double>> cold(names.size()), warm(names.size());
+
+  /* Cold first: this process must not have touched OpenCL when forking */
+  for (unsigned run = 0; run < runs; ++run)
+  {
+    auto seconds = discover_cold(libraries, names.size());
+    if (seconds.empty())
+    {
+      cerr << "self-bench: The discovery failed in a child process!" << endl;
+      return EXIT_FAILURE;
+    }
+    for (size_t ii = 0; ii < names.size(); ++ii)
+      cold[ii].push_back(seconds[ii]);
+  }
+  if (discover(libraries).empty())
+    return EXIT_FAILURE;
+  for (unsigned run = 0; run < runs; ++run)
+  {
+    auto seconds = discover(libraries);
+    if (seconds.empty())
+      return EXIT_FAILURE;
+    for (size_t ii = 0; ii < names.size(); ++ii)
+      warm[ii].push_back(seconds[ii]);
+  }
+  report("cold", names, cold);
+  report("warm", names, warm);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,201 @@
+/**
+ * shm_inventory.cpp --
+ *
+ *      The writing side of the shared memory inventory and --from-shm.
+ *      The device table comes from the inventory the dump was rendered
+ *      from and is built before the sequence goes odd, so readers only
+ *      retry for the time of a copy into the segment.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <sys/file.h>
+#include <thread>
+#include "format.h"
+#include "inventory.h"
+#include "shm_inventory.h"
+
+using namespace std;
+
+namespace {
+
+Shm_inventory* shm;
+int shm_fd = -1; /* kept open, with its lock, while the daemon runs */
+volatile sig_atomic_t stopping;
+
+}
+
+static void stop(int)
+{
+  stopping = 1;
+}
+
+static void copy_string(char (&to)[SHM_INVENTORY_STRING], const string& from)
+{
+  auto n = min(from.size(), sizeof to - 1);
+  memcpy(to, from.data(), n);
+  to[n] = '\0';
+}
+
+/**
+ * open_segment --
+ *
+ *      Creates the segment on first use, locks it against a second
+ *      daemon and maps it.
+ *
+ * Results:
+ *      true if the segment is mapped.
+ */
+static bool open_segment()
+{
+  if (shm)
+    return true;
+  auto fd = shm_open(SHM_INVENTORY_NAME, O_CREAT | O_RDWR, 0644);
+  if (fd < 0)
+  {
+    cerr << "Unable to open shared memory " << SHM_INVENTORY_NAME << ": " << strerror(errno) << "!" << endl;
+    return false;
+  }
+  /* The sequence protocol allows one writer only */
+  if (0 != flock(fd, LOCK_EX | LOCK_NB))
+  {
+    if (EWOULDBLOCK == errno)
+      cerr << "Another clinfo --daemon is publishing " << SHM_INVENTORY_NAME << "!" << endl;
+    else
+      cerr << "Unable to lock shared memory " << SHM_INVENTORY_NAME << ": " << strerror(errno) << "!" << endl;
+    close(fd);
+    return false;
+  }
+  void* mapping = MAP_FAILED;
+  if (0 == ftruncate(fd, sizeof(Shm_inventory)))
+    mapping = mmap(nullptr, sizeof(Shm_inventory), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (MAP_FAILED == mapping)
+  {
+    cerr << "Unable to map shared memory " << SHM_INVENTORY_NAME << ": " << strerror(errno) << "!" << endl;
+    close(fd);
+    return false;
+  }
+  shm_fd = fd;
+  shm = static_cast<Shm_inventory*>(mapping);
+  return true;
+}
+
+/**
+ * device_table --
+ *
+ *      Fills the device table from the inventory, with the indices of
+ *      the dump.  A property whose query failed is 0 or empty.
+ *
+ * Results:
+ *      the devices, at most SHM_INVENTORY_DEVICES.
+ */
+static vector<Shm_device> device_table(const Inventory& inventory)
+{
+  vector<Shm_device> devices;
+  for (size_t ii = 0; ii < inventory.platforms.size(); ++ii)
+  {
+    auto& platform = inventory.platforms[ii];
+    for (size_t jj = 0; jj < platform.devices.size() && devices.size() < SHM_INVENTORY_DEVICES; ++jj)
+    {
+      auto& device = platform.devices[jj];
+      Shm_device d;
+      memset(&d, 0, sizeof d);
+      d.platform = ii;
+      d.device = jj;
+      d.type = device.TYPE.value;
+      d.global_mem_size = device.GLOBAL_MEM_SIZE.value;
+      d.max_mem_alloc_size = device.MAX_MEM_ALLOC_SIZE.value;
+      d.local_mem_size = device.LOCAL_MEM_SIZE.value;
+      d.max_compute_units = device.MAX_COMPUTE_UNITS.value;
+      d.max_clock_frequency = device.MAX_CLOCK_FREQUENCY.value;
+      d.max_work_group_size = device.MAX_WORK_GROUP_SIZE.value;
+      d.available = device.AVAILABLE.value;
+      copy_string(d.platform_name, platform.name.value);
+      copy_string(d.name, device.NAME.value);
+      copy_string(d.vendor, device.VENDOR.value);
+      copy_string(d.version, device.VERSION.value);
+      copy_string(d.driver, device.DRIVER_VERSION.value);
+      devices.push_back(d);
+    }
+  }
+  return devices;
+}
+
+bool shm_inventory_publish(const Inventory& inventory, const string& dump)
+{
+  if (!open_segment())
+    return false;
+  auto devices = device_table(inventory);
+  auto now = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+  /* Odd if a daemon died while writing; then it stays odd until this write is done */
+  auto sequence = shm->sequence | 1;
+  __atomic_store_n(&shm->sequence, sequence, __ATOMIC_RELAXED);
+  atomic_thread_fence(memory_order_release);
+  memcpy(shm->magic, SHM_INVENTORY_MAGIC, sizeof shm->magic);
+  shm->version = SHM_INVENTORY_VERSION;
+  shm->size = sizeof(Shm_inventory);
+  shm->pid = getpid();
+  shm->updated = now;
+  shm->num_devices = devices.size();
+  memcpy(shm->devices, devices.data(), devices.size() * sizeof devices[0]);
+  shm->dump_size = min<size_t>(dump.size(), SHM_INVENTORY_DUMP);
+  memcpy(shm->dump, dump.data(), shm->dump_size);
+  __atomic_store_n(&shm->sequence, sequence + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+int shm_inventory_daemon(const function<string(Inventory&)>& collect, double interval)
+{
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  auto period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(interval));
+  /* Before the first collection, which a second daemon should not pay for */
+  if (!open_segment())
+    return EXIT_FAILURE;
+  auto status = EXIT_SUCCESS;
+  while (!stopping)
+  {
+    auto next = chrono::steady_clock::now() + period;
+    Inventory inventory;
+    auto dump = collect(inventory);
+    if (!shm_inventory_publish(inventory, dump))
+    {
+      status = EXIT_FAILURE;
+      break;
+    }
+    /* Short naps, so a signal does not wait for the next refresh */
+    while (!stopping && chrono::steady_clock::now() < next)
+      this_thread::sleep_for(min<chrono::steady_clock::duration>(next - chrono::steady_clock::now(),
+                                                                chrono::milliseconds(100)));
+  }
+  shm_unlink(SHM_INVENTORY_NAME);
+  return status;
+}
+
+int shm_inventory_print()
+{
+  unique_ptr<Shm_inventory> copy(new Shm_inventory);
+  if (!shm_inventory_read(*copy))
+  {
+    cerr << "No inventory in shared memory " << SHM_INVENTORY_NAME << ", is clinfo --daemon running?" << endl;
+    return EXIT_FAILURE;
+  }
+  if (0 != kill(copy->pid, 0) && ESRCH == errno)
+  {
+    time_t updated = copy->updated / 1000000000;
+    char when[64];
+    strftime(when, sizeof when, "%Y-%m-%d %H:%M:%S", localtime(&updated));
+    cerr << "The daemon (pid " << copy->pid << ") is gone, the inventory is from " << when << "!" << endl;
+  }
+  fwrite(copy->dump, 1, copy->dump_size, stdout);
+  if (SHM_INVENTORY_DUMP == copy->dump_size)
+    cerr << "The inventory is truncated to " << format_bytes(SHM_INVENTORY_DUMP) << "!" << endl;
+  return EXIT_SUCCESS;
+}
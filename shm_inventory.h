@@ -0,0 +1,133 @@
+/**
+ * shm_inventory.h --
+ *
+ *      Layout of the device inventory clinfo --daemon publishes in POSIX
+ *      shared memory, and a reader that needs no OpenCL library: copy
+ *      the segment with shm_inventory_read() and use the device table or
+ *      the text of the full dump.
+ *
+ *      The daemon is the only writer, which a lock on the segment makes
+ *      sure of.  It makes sequence odd, updates the segment and makes it
+ *      even again; a reader copies the segment
+ *      between two reads of an even, unchanged sequence and retries
+ *      otherwise, so it never sees a half written inventory and never
+ *      blocks the daemon.  Link readers with -lrt on older glibc.
+ */
+#ifndef CLINFO_SHM_INVENTORY_H
+#define CLINFO_SHM_INVENTORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHM_INVENTORY_NAME    "/clinfo-inventory"
+#define SHM_INVENTORY_MAGIC   "CLINVEN"
+#define SHM_INVENTORY_VERSION 1
+#define SHM_INVENTORY_DEVICES 32
+#define SHM_INVENTORY_STRING  128
+#define SHM_INVENTORY_DUMP    (1 << 20)
+
+struct Inventory;
+
+struct Shm_device {
+  uint32_t platform;                        /* indices of the dump */
+  uint32_t device;
+  uint64_t type;                            /* CL_DEVICE_TYPE */
+  uint64_t global_mem_size;
+  uint64_t max_mem_alloc_size;
+  uint64_t local_mem_size;
+  uint32_t max_compute_units;
+  uint32_t max_clock_frequency;             /* MHz */
+  uint64_t max_work_group_size;
+  uint32_t available;
+  uint32_t reserved;
+  char     platform_name[SHM_INVENTORY_STRING];
+  char     name[SHM_INVENTORY_STRING];
+  char     vendor[SHM_INVENTORY_STRING];
+  char     version[SHM_INVENTORY_STRING];
+  char     driver[SHM_INVENTORY_STRING];
+};
+
+struct Shm_inventory {
+  char     magic[8];                        /* SHM_INVENTORY_MAGIC */
+  uint32_t version;                         /* SHM_INVENTORY_VERSION */
+  uint32_t size;                            /* sizeof(Shm_inventory) */
+  uint32_t sequence;                        /* odd while the daemon writes */
+  uint32_t pid;                             /* of the daemon */
+  uint64_t updated;                         /* ns since the epoch */
+  uint32_t num_devices;                     /* at most SHM_INVENTORY_DEVICES */
+  uint32_t dump_size;                       /* bytes of dump, not terminated */
+  Shm_device devices[SHM_INVENTORY_DEVICES];
+  char     dump[SHM_INVENTORY_DUMP];        /* clinfo's output, truncated */
+};
+
+/**
+ * shm_inventory_read --
+ *
+ *      Copies a consistent inventory out of the segment.  The copy is
+ *      over a MiB, so allocate it rather than putting it on the stack.
+ *
+ * Results:
+ *      true on success; false if no daemon published the segment or it
+ *      has another layout.
+ */
+static inline bool shm_inventory_read(Shm_inventory& copy, const char* name = SHM_INVENTORY_NAME)
+{
+  struct stat st;
+  auto fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  /* A segment the daemon has not sized yet would fault */
+  auto mapping = 0 == fstat(fd, &st) && st.st_size >= (off_t) sizeof(Shm_inventory)
+                 ? mmap(nullptr, sizeof(Shm_inventory), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (MAP_FAILED == mapping)
+    return false;
+  auto shm = static_cast<Shm_inventory*>(mapping);
+  auto ok = false;
+  if (0 == memcmp(shm->magic, SHM_INVENTORY_MAGIC, sizeof shm->magic)
+      && SHM_INVENTORY_VERSION == shm->version && sizeof(Shm_inventory) == shm->size)
+  {
+    for (int tries = 0; !ok && tries < 100000; ++tries)
+    {
+      auto before = __atomic_load_n(&shm->sequence, __ATOMIC_ACQUIRE);
+      if (before & 1)
+      {
+        sched_yield();
+        continue;
+      }
+      memcpy(&copy, shm, offsetof(Shm_inventory, dump));
+      auto dump_size = copy.dump_size < SHM_INVENTORY_DUMP ? copy.dump_size : SHM_INVENTORY_DUMP;
+      memcpy(copy.dump, shm->dump, dump_size);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      ok = __atomic_load_n(&shm->sequence, __ATOMIC_RELAXED) == before;
+      copy.dump_size = dump_size;
+    }
+  }
+  munmap(mapping, sizeof(Shm_inventory));
+  return ok;
+}
+
+/*
+ * Publishes the dump and the device table of the inventory it was
+ * rendered from; false if the segment failed or another daemon has it.
+ */
+bool shm_inventory_publish(const Inventory& inventory, const std::string& dump);
+/*
+ * Publishes the dump collect returns, and the inventory it fills in,
+ * every interval seconds until SIGINT or SIGTERM, then removes the
+ * segment (clinfo --daemon).
+ */
+int shm_inventory_daemon(const std::function<std::string(Inventory&)>& collect, double interval);
+/* Prints the published dump (clinfo --from-shm). */
+int shm_inventory_print();
+
+#endif
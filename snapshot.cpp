@@ -0,0 +1,277 @@
+/**
+ * snapshot.cpp --
+ *
+ *      The binary snapshot of an inventory: a magic and version, then the
+ *      model in the order of the visitors, each field as its status, its
+ *      reported size and its value.  Strings are length prefixed, vectors
+ *      count prefixed, and everything is in host byte order, so a snapshot
+ *      is read back on the kind of machine that wrote it.
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include "inventory.h"
+
+using namespace std;
+
+#define SNAPSHOT_MAGIC   "CLSNAP\0"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_MAX     (1u << 26) /* of a string or vector, against corrupt files */
+
+namespace {
+
+struct Writer {
+  FILE* file;
+  bool ok;
+
+  void raw(const void* data, size_t size)
+  {
+    if (ok && size && 1 != fwrite(data, size, 1, file))
+      ok = false;
+  }
+  void put(uint64_t val) { raw(&val, sizeof val); }
+  void put(int32_t val) { raw(&val, sizeof val); }
+  void put(const string& val)
+  {
+    put((uint64_t) val.size());
+    raw(val.data(), val.size());
+  }
+  void put(const char* val) { put(string(val ? val : "")); }
+  void put(const vector<uint64_t>& val)
+  {
+    put((uint64_t) val.size());
+    for (auto v : val)
+      put(v);
+  }
+  void put(const vector<cl_image_format>& val)
+  {
+    put((uint64_t) val.size());
+    for (auto& v : val)
+    {
+      put((uint64_t) v.image_channel_order);
+      put((uint64_t) v.image_channel_data_type);
+    }
+  }
+
+  template <typename T>
+  void operator()(const char*, const Field<T>& field)
+  {
+    put((int32_t) field.status);
+    put((uint64_t) field.size);
+    put(field.value);
+  }
+};
+
+struct Reader {
+  FILE* file;
+  bool ok;
+
+  void raw(void* data, size_t size)
+  {
+    if (ok && size && 1 != fread(data, size, 1, file))
+      ok = false;
+  }
+  uint64_t count()
+  {
+    uint64_t n = 0;
+    get(n);
+    if (n > SNAPSHOT_MAX)
+      ok = false;
+    return ok ? n : 0;
+  }
+  void get(uint64_t& val) { raw(&val, sizeof val); }
+  void get(int32_t& val) { raw(&val, sizeof val); }
+  void get(string& val)
+  {
+    val.resize(count());
+    if (!val.empty())
+      raw(&val[0], val.size());
+  }
+  /* The failed steps are string constants in the model; intern them, for readers on any thread. */
+  void get(const char*& val)
+  {
+    static mutex steps_lock;
+    static set<string> steps;
+    string step;
+    get(step);
+    if (step.empty())
+    {
+      val = nullptr;
+      return;
+    }
+    lock_guard<mutex> guard(steps_lock);
+    val = steps.insert(step).first->c_str();
+  }
+  /* Vectors grow as their elements arrive, so a corrupt count hits the end of the file first. */
+  void get(vector<uint64_t>& val)
+  {
+    val.clear();
+    for (auto n = count(); ok && n; --n)
+    {
+      uint64_t v = 0;
+      get(v);
+      val.push_back(v);
+    }
+  }
+  void get(vector<cl_image_format>& val)
+  {
+    val.clear();
+    for (auto n = count(); ok && n; --n)
+    {
+      uint64_t order = 0, type = 0;
+      get(order);
+      get(type);
+      cl_image_format v;
+      v.image_channel_order = order;
+      v.image_channel_data_type = type;
+      val.push_back(v);
+    }
+  }
+
+  template <typename T>
+  void operator()(const char*, Field<T>& field)
+  {
+    int32_t status = CL_INVALID_VALUE;
+    uint64_t size = 0;
+    get(status);
+    get(size);
+    get(field.value);
+    field.status = status;
+    field.size = size;
+  }
+};
+
+}
+
+bool snapshot_write(const Inventory& inventory, FILE* file)
+{
+  Writer w = {file, true};
+  w.raw(SNAPSHOT_MAGIC, 8);
+  w.put((int32_t) SNAPSHOT_VERSION);
+  w.put((int32_t) inventory.status);
+  w.put(inventory.failed);
+  w.put((uint64_t) inventory.platforms.size());
+  for (auto& platform : inventory.platforms)
+  {
+    visit_platform(platform, w);
+    w.put((int32_t) platform.devices_status);
+    w.put(platform.devices_failed);
+    w.put((int32_t) platform.crash_signal);
+    w.put((uint64_t) platform.devices.size());
+    for (auto& device : platform.devices)
+    {
+      visit_device(device, w);
+      w.put((int32_t) device.image_formats_collected);
+      if (device.image_formats_collected)
+      {
+        w("IMAGE_FORMATS", device.IMAGE_FORMATS);
+        w.put(device.image_formats_failed);
+        w.put((int32_t) device.image_formats_release);
+      }
+    }
+  }
+  if (0 != fflush(file))
+    w.ok = false;
+  return w.ok;
+}
+
+bool snapshot_write(const Inventory& inventory, const string& path)
+{
+  auto file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    cerr << "Unable to create " << path << ": " << strerror(errno) << "!" << endl;
+    return false;
+  }
+  auto ok = snapshot_write(inventory, file);
+  if (0 != fclose(file))
+    ok = false;
+  if (!ok)
+    cerr << "Unable to write " << path << "!" << endl;
+  return ok;
+}
+
+/**
+ * read_header --
+ *
+ *      Reads the magic and version.
+ *
+ * Results:
+ *      false unless they are this version's.
+ */
+static bool read_header(Reader& r)
+{
+  char magic[8] = {0};
+  int32_t version = 0;
+  r.raw(magic, sizeof magic);
+  r.get(version);
+  return r.ok && 0 == memcmp(magic, SNAPSHOT_MAGIC, sizeof magic) && SNAPSHOT_VERSION == version;
+}
+
+bool snapshot_read(Inventory& inventory, FILE* file)
+{
+  Reader r = {file, true};
+  int32_t status = 0;
+  if (!read_header(r))
+    return false;
+  inventory = Inventory();
+  r.get(status);
+  inventory.status = status;
+  r.get(inventory.failed);
+  for (auto num_platforms = r.count(); r.ok && num_platforms; --num_platforms)
+  {
+    inventory.platforms.push_back(Platform());
+    auto& platform = inventory.platforms.back();
+    platform.id = nullptr;
+    visit_platform(platform, r);
+    r.get(status);
+    platform.devices_status = status;
+    r.get(platform.devices_failed);
+    r.get(status);
+    platform.crash_signal = status;
+    for (auto num_devices = r.count(); r.ok && num_devices; --num_devices)
+    {
+      platform.devices.push_back(Device());
+      auto& device = platform.devices.back();
+      device.id = nullptr;
+      visit_device(device, r);
+      if (device.EXTENSIONS.ok())
+        device.extension_set = Extension_set(device.EXTENSIONS.value.c_str());
+      int32_t collected = 0;
+      r.get(collected);
+      device.image_formats_collected = collected;
+      device.image_formats_failed = nullptr;
+      device.image_formats_release = CL_SUCCESS;
+      if (collected)
+      {
+        r("IMAGE_FORMATS", device.IMAGE_FORMATS);
+        r.get(device.image_formats_failed);
+        r.get(status);
+        device.image_formats_release = status;
+      }
+    }
+  }
+  return r.ok;
+}
+
+bool snapshot_read(Inventory& inventory, const string& path)
+{
+  auto file = fopen(path.c_str(), "rb");
+  if (!file)
+  {
+    cerr << "Unable to open " << path << ": " << strerror(errno) << "!" << endl;
+    return false;
+  }
+  Reader r = {file, true};
+  auto is_snapshot = read_header(r);
+  auto ok = is_snapshot && 0 == fseek(file, 0, SEEK_SET) && snapshot_read(inventory, file);
+  fclose(file);
+  if (!is_snapshot)
+    cerr << path << " is not a clinfo snapshot!" << endl;
+  else if (!ok)
+    cerr << path << " is truncated or corrupt!" << endl;
+  return ok;
+}
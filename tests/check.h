@@ -0,0 +1,42 @@
+/**
+ * check.h --
+ *
+ *      The helpers of the unit checks run by make check.  Each
+ *      tests/check_*.cpp is a program that needs no OpenCL device; it
+ *      prints every check that fails and its verdict to stderr, and
+ *      exits with EXIT_FAILURE if a check failed.
+ */
+#ifndef CLINFO_CHECK_H
+#define CLINFO_CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+static int check_failures;
+
+static inline void check(bool ok, const char* what, const char* file, int line)
+{
+  if (ok)
+    return;
+  fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+  ++check_failures;
+}
+
+#define CHECK(X) check((X), #X, __FILE__, __LINE__)
+
+/* A temporary file name for the checks that write one. */
+static inline std::string check_path(const char* name)
+{
+  auto dir = getenv("TMPDIR");
+  return std::string(dir ? dir : "/tmp") + "/clinfo-check-" + std::to_string(getpid()) + "-" + name;
+}
+
+static inline int check_result(const char* name)
+{
+  fprintf(stderr, "%s: %s\n", name, check_failures ? "FAILED" : "ok");
+  return check_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
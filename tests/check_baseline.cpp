@@ -0,0 +1,93 @@
+/**
+ * check_baseline.cpp --
+ *
+ *      Baselines: saving replaces a metric's line, and comparing picks
+ *      the entry of the same device and driver, newest first, and calls
+ *      a regression only outside both confidence intervals.
+ */
+#include <fstream>
+#include "check.h"
+#include "bench.h"
+
+using namespace std;
+
+/* Writes a baseline file: the header and the given entry lines. */
+static string write(const string& path, const string& lines, const char* header = "# clinfo baseline 1")
+{
+  ofstream out(path);
+  out << header << "\n" << lines;
+  return path;
+}
+
+/* An entry of host work: tag, no platform or device, driver, metric, runs, mean, ci, median. */
+static string entry(const string& saved, const string& driver, const string& metric, const string& mean,
+                    const string& ci)
+{
+  return saved + "\thost\t\t\t" + driver + "\t" + metric + "\t10\t" + mean + "\t" + ci + "\t" + mean + "\n";
+}
+
+static size_t count_lines(const string& path)
+{
+  ifstream in(path);
+  size_t n = 0;
+  for (string line; getline(in, line); )
+    ++n;
+  return n;
+}
+
+int main()
+{
+  /* The reports and comparisons print their verdicts; only the checks matter */
+  freopen("/dev/null", "w", stdout);
+  Bench_stats stats = Bench_stats();
+  stats.runs = 10;
+  stats.mean = stats.median = stats.min = stats.max = 1.0;
+  stats.ci = 0.01;
+  bench_report("host", nullptr, "copy", stats);
+  bench_report("host", nullptr, "tab\tbed", stats);
+
+  auto path = check_path("baseline");
+  remove(path.c_str());
+  CHECK(EXIT_FAILURE == baseline_compare(path, 0.05));
+  CHECK(baseline_save(path));
+  CHECK(baseline_save(path));
+  CHECK(3 == count_lines(path));
+  CHECK(EXIT_SUCCESS == baseline_compare(path, 0.05));
+
+  /* Twice as slow as the baseline, outside both intervals */
+  write(path, entry("1", "", "copy", "0.5", "0.01"));
+  CHECK(EXIT_REGRESSION == baseline_compare(path, 0.05));
+  /* but within the threshold or the intervals it is not a regression */
+  CHECK(EXIT_SUCCESS == baseline_compare(path, 1.5));
+  write(path, entry("1", "", "copy", "0.5", "1"));
+  CHECK(EXIT_SUCCESS == baseline_compare(path, 0.05));
+  write(path, entry("1", "", "copy", "2", "0.01"));
+  CHECK(EXIT_SUCCESS == baseline_compare(path, 0.05));
+
+  /* The same driver wins over a newer entry of another one */
+  write(path, entry("1", "", "copy", "1", "0.01") + entry("2", "other", "copy", "0.5", "0.01"));
+  CHECK(EXIT_SUCCESS == baseline_compare(path, 0.05));
+  write(path, entry("2", "other", "copy", "1", "0.01") + entry("1", "", "copy", "0.5", "0.01"));
+  CHECK(EXIT_REGRESSION == baseline_compare(path, 0.05));
+  /* and among the same driver's the newest, whatever the file order */
+  write(path, entry("2", "", "copy", "1", "0.01") + entry("1", "", "copy", "0.5", "0.01"));
+  CHECK(EXIT_SUCCESS == baseline_compare(path, 0.05));
+  write(path, entry("1", "", "copy", "1", "0.01") + entry("2", "", "copy", "0.5", "0.01"));
+  CHECK(EXIT_REGRESSION == baseline_compare(path, 0.05));
+
+  /* Tabs in names are saved as spaces and still match */
+  write(path, entry("1", "", "tab bed", "0.5", "0.01"));
+  CHECK(EXIT_REGRESSION == baseline_compare(path, 0.05));
+  /* Another tag is not a baseline for these */
+  write(path, "1\tplatform[0] device[0]\t\t\t\tcopy\t10\t0.5\t0.01\t0.5\n");
+  CHECK(EXIT_SUCCESS == baseline_compare(path, 0.05));
+
+  write(path, entry("1", "", "copy", "1", "0.01"), "# clinfo baseline");
+  CHECK(EXIT_FAILURE == baseline_compare(path, 0.05));
+  CHECK(!baseline_save(path));
+  write(path, "1\thost\tcopy\n");
+  CHECK(EXIT_FAILURE == baseline_compare(path, 0.05));
+
+  remove(path.c_str());
+  return check_result("check_baseline");
+}
@@ -0,0 +1,105 @@
+/**
+ * check_bench_stats.cpp --
+ *
+ *      bench_summarize(): outlier rejection by median absolute
+ *      deviation, order statistics, and Student's t confidence intervals.
+ */
+#include <cmath>
+#include <vector>
+#include "check.h"
+#include "bench.h"
+
+using namespace std;
+
+static bool near(double a, double b)
+{
+  return fabs(a - b) <= 1e-9 * max(1.0, fabs(b));
+}
+
+/* The relative half width of the 95% interval of the mean with quantile t. */
+static double interval(const vector<double>& samples, double t)
+{
+  double sum = 0, sum2 = 0;
+  for (auto x : samples)
+    sum += x;
+  auto mean = sum / samples.size();
+  for (auto x : samples)
+    sum2 += (x - mean) * (x - mean);
+  return t * sqrt(sum2 / (samples.size() - 1)) / sqrt(samples.size()) / mean;
+}
+
+/* n samples alternating below and above 1. */
+static vector<double> alternating(size_t n)
+{
+  vector<double> samples;
+  for (size_t ii = 0; ii < n; ++ii)
+    samples.push_back(ii % 2 ? 1.1 : 0.9);
+  return samples;
+}
+
+/* n samples 0.01 apart around 1. */
+static vector<double> spread(size_t n)
+{
+  vector<double> samples;
+  for (size_t ii = 0; ii < n; ++ii)
+    samples.push_back(1.0 + 0.01 * (ii - (n - 1) / 2.0));
+  return samples;
+}
+
+int main()
+{
+  auto stats = bench_summarize(vector<double>());
+  CHECK(0 == stats.runs && stats.noisy);
+
+  stats = bench_summarize(vector<double>{2.0});
+  CHECK(1 == stats.runs && 2.0 == stats.mean && 2.0 == stats.median && std::isinf(stats.ci) && stats.noisy);
+
+  stats = bench_summarize(vector<double>(10, 1.0));
+  CHECK(10 == stats.runs && 0 == stats.outliers && 1.0 == stats.median && 0 == stats.cv && 0 == stats.ci);
+  CHECK(!stats.noisy);
+
+  /* Order statistics, unsorted input */
+  vector<double> ranks;
+  for (int ii = 100; ii >= 1; --ii)
+    ranks.push_back(ii);
+  stats = bench_summarize(ranks, 1.0);
+  CHECK(100 == stats.runs && 0 == stats.outliers);
+  CHECK(1 == stats.min && 50.5 == stats.median && 90 == stats.p90 && 99 == stats.p99 && 100 == stats.max);
+  CHECK(50.5 == stats.mean);
+
+  /* Small samples use Student's t, up to 30 degrees of freedom, then 1.96 */
+  vector<double> three{1, 2, 3};
+  stats = bench_summarize(three, 1.0);
+  CHECK(3 == stats.runs && near(stats.ci, interval(three, 4.303)) && near(stats.cv, 0.5));
+  auto samples = spread(31);
+  stats = bench_summarize(samples);
+  CHECK(0 == stats.outliers && near(stats.ci, interval(samples, 2.042)));
+  samples = spread(32);
+  stats = bench_summarize(samples);
+  CHECK(0 == stats.outliers && near(stats.ci, interval(samples, 1.96)));
+  CHECK(stats.noisy);
+  CHECK(!bench_summarize(samples, 0.1).noisy);
+
+  /* A preempted run is rejected */
+  samples = alternating(20);
+  samples.push_back(10.0);
+  stats = bench_summarize(samples, 1.0);
+  CHECK(20 == stats.runs && 1 == stats.outliers && 1.1 == stats.max && near(stats.mean, 1.0));
+  CHECK(!stats.noisy);
+
+  /* but within 5% of the median nothing is, even when the others agree exactly */
+  samples.assign(9, 1.0);
+  samples.push_back(1.04);
+  stats = bench_summarize(samples, 1.0);
+  CHECK(10 == stats.runs && 0 == stats.outliers);
+  samples.back() = 1.06;
+  stats = bench_summarize(samples, 1.0);
+  CHECK(9 == stats.runs && 1 == stats.outliers && !stats.noisy);
+
+  /* Rejecting more than a tenth of the runs makes the result noisy */
+  samples.push_back(0.5);
+  stats = bench_summarize(samples, 1.0);
+  CHECK(2 == stats.outliers && stats.noisy);
+
+  return check_result("check_bench_stats");
+}
@@ -0,0 +1,91 @@
+/**
+ * check_extensions.cpp --
+ *
+ *      Extension interning and sets: known names get their fixed ids,
+ *      others are interned once even from several threads, and sets
+ *      parse, test and compare over any number of ids.
+ */
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "extensions.h"
+
+using namespace std;
+
+#define THREADS 8
+#define NAMES   200
+
+int main()
+{
+  auto fp64 = Extension_set::lookup("cl_khr_fp64");
+  auto icd = Extension_set::lookup("cl_khr_icd");
+  auto qcom = Extension_set::lookup("cl_qcom_ext_host_ptr");
+  CHECK(fp64 >= 0 && icd >= 0 && qcom >= 0);
+  CHECK(fp64 != icd && icd != qcom && fp64 != qcom);
+  CHECK(fp64 == Extension_set::intern("cl_khr_fp64"));
+  CHECK("cl_khr_fp64" == Extension_set::name(fp64));
+  CHECK("cl_qcom_ext_host_ptr" == Extension_set::name(qcom));
+
+  /* Near misses of known names are not known */
+  CHECK(-1 == Extension_set::lookup("cl_khr_fp6"));
+  CHECK(-1 == Extension_set::lookup("cl_khr_fp644"));
+  CHECK(-1 == Extension_set::lookup("CL_KHR_FP64"));
+  CHECK(-1 == Extension_set::lookup(""));
+
+  /* Others are interned after the known ones, once */
+  CHECK(-1 == Extension_set::lookup("cl_vendor_thing"));
+  auto vendor = Extension_set::intern("cl_vendor_thing");
+  CHECK(vendor > max(fp64, max(icd, qcom)));
+  CHECK(vendor == Extension_set::intern("cl_vendor_thing"));
+  CHECK(vendor == Extension_set::lookup("cl_vendor_thing"));
+  CHECK("cl_vendor_thing" == Extension_set::name(vendor));
+
+  Extension_set set("  cl_khr_icd\tcl_vendor_thing cl_khr_fp64\n");
+  CHECK(set.has("cl_khr_fp64") && set.has(icd) && set.has(vendor));
+  CHECK(!set.has("cl_khr_fp16") && !set.has(-1) && !set.has(1 << 20));
+  CHECK((vector<string>{"cl_khr_fp64", "cl_khr_icd", "cl_vendor_thing"}) == set.names());
+  CHECK(Extension_set("").names().empty());
+
+  Extension_set needs("cl_khr_fp64 cl_vendor_thing");
+  CHECK(set.contains(needs) && !needs.contains(set));
+  CHECK(set.contains(Extension_set()) && Extension_set().contains(Extension_set()));
+  CHECK(!Extension_set().contains(needs));
+
+  /* Names interned on several threads at once get one id each */
+  vector<vector<int>> ids(THREADS, vector<int>(NAMES));
+  vector<thread> threads;
+  for (int tt = 0; tt < THREADS; ++tt)
+    threads.push_back(thread([&ids, tt]
+    {
+      for (int ii = 0; ii < NAMES; ++ii)
+      {
+        auto n = tt % 2 ? NAMES - 1 - ii : ii;
+        ids[tt][n] = Extension_set::intern("cl_thread_" + to_string(n));
+      }
+    }));
+  for (auto& t : threads)
+    t.join();
+  Extension_set many;
+  for (int ii = 0; ii < NAMES; ++ii)
+  {
+    for (int tt = 1; tt < THREADS; ++tt)
+      CHECK(ids[0][ii] == ids[tt][ii]);
+    CHECK("cl_thread_" + to_string(ii) == Extension_set::name(ids[0][ii]));
+    many.insert(ids[0][ii]);
+  }
+  auto sorted = ids[0];
+  sort(sorted.begin(), sorted.end());
+  CHECK(adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+
+  /* Sets span as many words as the ids need */
+  CHECK((size_t) NAMES == many.names().size());
+  CHECK(many.has(sorted.back()) && !many.has(sorted.back() + 1));
+  CHECK(!many.contains(set) && !set.contains(many));
+  many.insert(fp64);
+  many.insert(icd);
+  many.insert(vendor);
+  CHECK(many.contains(set));
+
+  return check_result("check_extensions");
+}
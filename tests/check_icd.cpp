@@ -0,0 +1,60 @@
+/**
+ * check_icd.cpp --
+ *
+ *      icd_libraries(): which .icd files of OCL_ICD_VENDORS a glob
+ *      selects, in what order, and the library line read from each.
+ */
+#include <fstream>
+#include <vector>
+#include "check.h"
+#include "icd.h"
+
+using namespace std;
+
+static string dir;
+
+static void icd_file(const string& name, const string& contents)
+{
+  ofstream(dir + "/" + name) << contents;
+}
+
+int main()
+{
+  auto base = check_path("vendors.XXXXXX");
+  vector<char> path(base.begin(), base.end());
+  path.push_back('\0');
+  if (nullptr == mkdtemp(path.data()))
+  {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+  dir = path.data();
+  icd_file("nvidia.icd", "libnvidia-opencl.so.1\n");
+  icd_file("amd.icd", "libamdocl64.so");
+  icd_file("intel.icd", "  /opt/intel/libintelocl.so \r\nignored second line\n");
+  icd_file("empty.icd", "");
+  icd_file("blank.icd", " \t \n");
+  icd_file(".icd", "libhidden.so\n");
+  icd_file("pocl.icd.bak", "libpocl.so\n");
+  icd_file("README", "libreadme.so\n");
+  setenv("OCL_ICD_VENDORS", dir.c_str(), 1);
+
+  /* Sorted by file name, trimmed, empty files and other names left out */
+  CHECK((vector<string>{"libamdocl64.so", "/opt/intel/libintelocl.so", "libnvidia-opencl.so.1"})
+        == icd_libraries("*"));
+  CHECK(icd_libraries("*") == icd_libraries("*.icd"));
+  CHECK(vector<string>{"/opt/intel/libintelocl.so"} == icd_libraries("*intel*"));
+  CHECK((vector<string>{"libamdocl64.so", "libnvidia-opencl.so.1"}) == icd_libraries("[an]*"));
+  CHECK(vector<string>{"libnvidia-opencl.so.1"} == icd_libraries("nvidia.icd"));
+  CHECK(icd_libraries("nvidia").empty());
+  CHECK(icd_libraries("pocl*").empty());
+
+  setenv("OCL_ICD_VENDORS", (dir + "/missing").c_str(), 1);
+  CHECK(icd_libraries("*").empty());
+
+  for (auto name : {"nvidia.icd", "amd.icd", "intel.icd", "empty.icd", "blank.icd", ".icd", "pocl.icd.bak",
+                    "README"})
+    remove((dir + "/" + name).c_str());
+  rmdir(dir.c_str());
+  return check_result("check_icd");
+}
@@ -0,0 +1,65 @@
+/**
+ * check_select.cpp --
+ *
+ *      The --select expression compiler: what it accepts and the message
+ *      and column of what it rejects.
+ */
+#include "check.h"
+#include "bench.h"
+
+using namespace std;
+
+static bool accepts(const string& expression)
+{
+  string error;
+  auto ok = select_check(expression, error);
+  if (!ok)
+    fprintf(stderr, "'%s': %s\n", expression.c_str(), error.c_str());
+  return ok;
+}
+
+static bool rejects(const string& expression, const string& message)
+{
+  string error;
+  if (select_check(expression, error))
+    return false;
+  if (string::npos != error.find(message))
+    return true;
+  fprintf(stderr, "'%s': %s, not %s\n", expression.c_str(), error.c_str(), message.c_str());
+  return false;
+}
+
+int main()
+{
+  CHECK(accepts("type == GPU && GLOBAL_MEM_SIZE >= 8GiB && has(cl_khr_fp64)"));
+  CHECK(accepts("TYPE!=cpu||(max_compute_units>4 && !IMAGE_SUPPORT)"));
+  CHECK(accepts("CL_DEVICE_MAX_COMPUTE_UNITS"));
+  CHECK(accepts("MAX_MEM_ALLOC_SIZE > 512M && GLOBAL_MEM_SIZE < 1T && LOCAL_MEM_SIZE >= 32KB"));
+  CHECK(accepts("MAX_COMPUTE_UNITS == 0x10"));
+  CHECK(accepts("NAME == \"a device\" && VENDOR != \"\""));
+
+  CHECK(rejects("", "column 1: expected a property or has()"));
+  CHECK(rejects("FOO > 1", "column 4: unknown property FOO"));
+  CHECK(rejects("NAME", "NAME needs a comparison"));
+  CHECK(rejects("NAME < \"a\"", "NAME supports only == and != comparisons"));
+  CHECK(rejects("NAME == a", "expected a quoted string"));
+  CHECK(rejects("NAME == \"a", "unterminated string"));
+  CHECK(rejects("TYPE == FPGA", "expected CPU, GPU, ACCELERATOR or DEFAULT"));
+  CHECK(rejects("(TYPE == GPU", "expected ')'"));
+  CHECK(rejects("has(cl_khr_fp64", "expected has(EXTENSION)"));
+  CHECK(rejects("TYPE == GPU GPU", "column 13: unexpected 'G'"));
+
+  /* A number is one token, its unit included */
+  CHECK(rejects("GLOBAL_MEM_SIZE >= 8 G", "column 22: unexpected 'G'"));
+  CHECK(rejects("GLOBAL_MEM_SIZE >= 8G iB", "column 23: unexpected 'i'"));
+  CHECK(rejects("GLOBAL_MEM_SIZE >= 8Gx", "column 22: unexpected 'x' in a number"));
+  CHECK(rejects("GLOBAL_MEM_SIZE >= 8GiBs", "unexpected 's' in a number"));
+  CHECK(rejects("GLOBAL_MEM_SIZE >= GPU", "column 20: expected a number"));
+  CHECK(rejects("GLOBAL_MEM_SIZE >= 18446744073709551616",
+                "column 20: 18446744073709551616 does not fit in 64 bits"));
+  CHECK(rejects("GLOBAL_MEM_SIZE >= 16777216T", "column 20: 16777216T does not fit in 64 bits"));
+  CHECK(accepts("GLOBAL_MEM_SIZE >= 16777215T"));
+  CHECK(accepts("GLOBAL_MEM_SIZE >= 18446744073709551615"));
+
+  return check_result("check_select");
+}
@@ -0,0 +1,192 @@
+/**
+ * check_snapshot.cpp --
+ *
+ *      Snapshots: an inventory reads back as it was written, and a
+ *      truncated or foreign file is rejected.
+ */
+#include <cstring>
+#include <vector>
+#include "check.h"
+#include "inventory.h"
+
+using namespace std;
+
+/* Every field of an inventory as text, to compare two of them. */
+struct Dump {
+  string text;
+
+  void add(const char* name, cl_int status, size_t size)
+  {
+    text += string(" ") + name + ":" + to_string(status) + ":" + to_string(size) + "=";
+  }
+  void operator()(const char* name, const Field<uint64_t>& field)
+  {
+    add(name, field.status, field.size);
+    text += to_string(field.value);
+  }
+  void operator()(const char* name, const Field<string>& field)
+  {
+    add(name, field.status, field.size);
+    text += field.value;
+  }
+  void operator()(const char* name, const Field<vector<uint64_t>>& field)
+  {
+    add(name, field.status, field.size);
+    for (auto v : field.value)
+      text += to_string(v) + ",";
+  }
+  void operator()(const char* name, const Field<vector<cl_image_format>>& field)
+  {
+    add(name, field.status, field.size);
+    for (auto& v : field.value)
+      text += to_string(v.image_channel_order) + "/" + to_string(v.image_channel_data_type) + ",";
+  }
+  void step(const char* failed) { text += string(" step=") + (failed ? failed : "(none)"); }
+};
+
+static string dump(const Inventory& inventory)
+{
+  Dump d;
+  d.text = to_string(inventory.status);
+  d.step(inventory.failed);
+  for (auto& platform : inventory.platforms)
+  {
+    visit_platform(platform, d);
+    d.text += " devices:" + to_string(platform.devices_status) + ":" + to_string(platform.crash_signal);
+    d.step(platform.devices_failed);
+    for (auto& device : platform.devices)
+    {
+      visit_device(device, d);
+      d.text += " formats:" + to_string(device.image_formats_collected);
+      if (device.image_formats_collected)
+      {
+        d("IMAGE_FORMATS", device.IMAGE_FORMATS);
+        d.step(device.image_formats_failed);
+        d.text += ":" + to_string(device.image_formats_release);
+      }
+    }
+  }
+  return d.text;
+}
+
+template <typename T>
+static void set(Field<T>& field, const T& value, size_t size)
+{
+  field.value = value;
+  field.status = CL_SUCCESS;
+  field.size = size;
+}
+
+static Inventory sample()
+{
+  Inventory inventory;
+  inventory.status = CL_SUCCESS;
+  inventory.failed = nullptr;
+  inventory.platforms.resize(2);
+
+  auto& good = inventory.platforms[0];
+  good.id = nullptr;
+  set(good.name, string("Mock Platform"), 14);
+  set(good.vendor, string("Mock"), 5);
+  set(good.version, string("OpenCL 3.0 mock"), 16);
+  good.profile.status = CL_INVALID_VALUE;
+  good.devices_status = CL_SUCCESS;
+  good.devices_failed = nullptr;
+  good.crash_signal = -1;
+  good.devices.resize(2);
+
+  auto& gpu = good.devices[0];
+  gpu.id = nullptr;
+  set(gpu.TYPE, (uint64_t) CL_DEVICE_TYPE_GPU, sizeof(cl_device_type));
+  set(gpu.NAME, string("Mock GPU"), 9);
+  set(gpu.EXTENSIONS, string("cl_khr_fp64 cl_mock_unknown"), 28);
+  set(gpu.GLOBAL_MEM_SIZE, (uint64_t) 8 << 30, sizeof(cl_ulong));
+  set(gpu.MAX_WORK_ITEM_SIZES, vector<uint64_t>{1024, 1024, 64}, 3 * sizeof(size_t));
+  gpu.MAX_COMPUTE_UNITS.status = CL_INVALID_OPERATION;
+  gpu.image_formats_collected = true;
+  set(gpu.IMAGE_FORMATS, vector<cl_image_format>{{CL_RGBA, CL_UNORM_INT8}, {CL_R, CL_FLOAT}},
+      2 * sizeof(cl_image_format));
+  gpu.image_formats_failed = nullptr;
+  gpu.image_formats_release = CL_SUCCESS;
+
+  auto& cpu = good.devices[1];
+  cpu.id = nullptr;
+  set(cpu.TYPE, (uint64_t) CL_DEVICE_TYPE_CPU, sizeof(cl_device_type));
+  cpu.image_formats_collected = true;
+  cpu.IMAGE_FORMATS.status = CL_OUT_OF_HOST_MEMORY;
+  cpu.image_formats_failed = "clCreateContext";
+  cpu.image_formats_release = CL_INVALID_CONTEXT;
+
+  auto& crashed = inventory.platforms[1];
+  crashed.id = nullptr;
+  crashed.devices_status = CL_DEVICE_NOT_AVAILABLE;
+  crashed.devices_failed = "clGetDeviceIDs";
+  crashed.crash_signal = 11;
+  return inventory;
+}
+
+/* Reads a snapshot from the first size bytes of data. */
+static bool read_bytes(Inventory& inventory, vector<char>& data, size_t size)
+{
+  auto file = fmemopen(data.data(), size, "rb");
+  if (nullptr == file)
+    return false;
+  auto ok = snapshot_read(inventory, file);
+  fclose(file);
+  return ok;
+}
+
+int main()
+{
+  auto written = sample();
+  auto file = tmpfile();
+  CHECK(nullptr != file && snapshot_write(written, file));
+  if (nullptr == file)
+    return check_result("check_snapshot");
+  vector<char> data(ftell(file));
+  rewind(file);
+  CHECK(data.size() == fread(data.data(), 1, data.size(), file));
+  fclose(file);
+
+  Inventory read;
+  CHECK(read_bytes(read, data, data.size()));
+  CHECK(dump(written) == dump(read));
+  CHECK(read.platforms.size() == 2 && read.platforms[0].devices.size() == 2);
+  if (read.platforms.size() == 2 && read.platforms[0].devices.size() == 2)
+  {
+    auto& gpu = read.platforms[0].devices[0];
+    CHECK(nullptr == gpu.id);
+    CHECK(gpu.extension_set.has("cl_khr_fp64"));
+    CHECK(gpu.extension_set.has("cl_mock_unknown"));
+    CHECK(!gpu.extension_set.has("cl_khr_fp16"));
+    CHECK(0 == strcmp("clCreateContext", read.platforms[0].devices[1].image_formats_failed));
+  }
+
+  /* Every truncation is caught */
+  for (size_t size = 1; size < data.size(); ++size)
+  {
+    Inventory partial;
+    if (read_bytes(partial, data, size))
+    {
+      fprintf(stderr, "a snapshot truncated to %zu of %zu bytes was read\n", size, data.size());
+      CHECK(false);
+      break;
+    }
+  }
+
+  auto foreign = data;
+  foreign[0] ^= 1;
+  CHECK(!read_bytes(read, foreign, foreign.size()));
+  auto newer = data;
+  newer[8] += 1; /* the version follows the 8 byte magic */
+  CHECK(!read_bytes(read, newer, newer.size()));
+
+  /* And through the path API */
+  auto path = check_path("snapshot");
+  CHECK(snapshot_write(written, path));
+  Inventory from_path;
+  CHECK(snapshot_read(from_path, path) && dump(written) == dump(from_path));
+  remove(path.c_str());
+
+  return check_result("check_snapshot");
+}
@@ -0,0 +1,127 @@
+/**
+ * check_trace_report.cpp --
+ *
+ *      clinfo --trace-report on hand-written logs: the counts, times and
+ *      errors per function, dropped records, and the logs it refuses.
+ */
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "check.h"
+#include "clinfo.h"
+#include "cltrace.h"
+
+using namespace std;
+
+static Cltrace_header header()
+{
+  Cltrace_header h;
+  memset(&h, 0, sizeof h);
+  memcpy(h.magic, CLTRACE_MAGIC, sizeof CLTRACE_MAGIC);
+  h.version = CLTRACE_VERSION;
+  h.record_size = sizeof(Cltrace_record);
+  h.pid = 42;
+  return h;
+}
+
+static Cltrace_record record(unsigned function, uint32_t thread, uint64_t start, uint64_t duration,
+                             cl_int status)
+{
+  Cltrace_record r;
+  memset(&r, 0, sizeof r);
+  r.function = function;
+  r.thread = thread;
+  r.start = start;
+  r.duration = duration;
+  r.status = status;
+  return r;
+}
+
+static void write(const string& path, const Cltrace_header& h, const vector<Cltrace_record>& records,
+                  const string& tail = string())
+{
+  ofstream out(path, ios::binary);
+  out.write(reinterpret_cast<const char*>(&h), sizeof h);
+  for (auto& r : records)
+    out.write(reinterpret_cast<const char*>(&r), sizeof r);
+  out << tail;
+}
+
+/* Runs the report with stdout in a file, and returns what it printed. */
+static int report(const string& path, const string& output, string& text)
+{
+  fflush(stdout);
+  if (nullptr == freopen(output.c_str(), "w", stdout))
+    return -1;
+  auto status = trace_report(path);
+  fflush(stdout);
+  ifstream in(output);
+  stringstream ss;
+  ss << in.rdbuf();
+  text = ss.str();
+  return status;
+}
+
+/* The table line of a function: calls, errors and mean us. */
+static bool row(const string& text, const char* function, size_t& calls, unsigned long& errors, double& mean)
+{
+  auto at = text.find(string("\n") + function + " ");
+  if (string::npos == at)
+    return false;
+  char name[64];
+  double total;
+  return 5 == sscanf(text.c_str() + at + 1, "%63s %zu %lu %lf %lf", name, &calls, &errors, &total, &mean);
+}
+
+int main()
+{
+  auto path = check_path("trace");
+  auto output = check_path("trace-report");
+  string text;
+  size_t calls;
+  unsigned long errors;
+  double mean;
+
+  auto dropped = record(CLTRACE_DROPPED, 1, 0, 0, CL_SUCCESS);
+  dropped.args[0] = 5;
+  write(path, header(), {
+    record(CLTRACE_clGetPlatformIDs, 1, 1000, 1000, CL_SUCCESS),
+    record(CLTRACE_clGetPlatformIDs, 1, 3000, 3000, CL_INVALID_VALUE),
+    record(CLTRACE_clGetPlatformIDs, 1, 7000, 2000, CL_SUCCESS),
+    record(CLTRACE_clEnqueueTask, 2, 2000, 500, CL_INVALID_KERNEL),
+    dropped,
+    record(CLTRACE_NUM_FUNCTIONS + 1, 1, 0, 1000000, CL_SUCCESS),
+  }, "partial record");
+  CHECK(EXIT_SUCCESS == report(path, output, text));
+  CHECK(string::npos != text.find(": pid 42, 4 calls in 2 threads over 0.000 s, 5 records dropped\n"));
+  CHECK(row(text, "clGetPlatformIDs", calls, errors, mean) && 3 == calls && 1 == errors && 2.0 == mean);
+  CHECK(row(text, "clEnqueueTask", calls, errors, mean) && 1 == calls && 1 == errors && 0.5 == mean);
+  CHECK(text.find("\nclGetPlatformIDs ") < text.find("\nclEnqueueTask "));
+  CHECK(string::npos != text.find(cl_error_str(CL_INVALID_VALUE)));
+  CHECK(string::npos != text.find(cl_error_str(CL_INVALID_KERNEL)));
+
+  write(path, header(), {});
+  CHECK(EXIT_SUCCESS == report(path, output, text));
+  CHECK(string::npos != text.find(", 0 calls in 0 threads"));
+
+  auto foreign = header();
+  foreign.magic[0] = 'X';
+  write(path, foreign, {});
+  CHECK(EXIT_FAILURE == report(path, output, text));
+  auto newer = header();
+  newer.version = CLTRACE_VERSION + 1;
+  write(path, newer, {});
+  CHECK(EXIT_FAILURE == report(path, output, text));
+  auto wider = header();
+  wider.record_size = 2 * sizeof(Cltrace_record);
+  write(path, wider, {});
+  CHECK(EXIT_FAILURE == report(path, output, text));
+  ofstream(path) << "CLTRACE";
+  CHECK(EXIT_FAILURE == report(path, output, text));
+  remove(path.c_str());
+  CHECK(EXIT_FAILURE == report(path, output, text));
+
+  remove(output.c_str());
+  return check_result("check_trace_report");
+}
@@ -0,0 +1,165 @@
+/**
+ * timeline.cpp --
+ *
+ *      Chrome trace-event recording, see timeline.h.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "format.h"
+#include "timeline.h"
+
+using namespace std;
+
+#define HOST_PID   1
+#define DEVICE_PID 2
+
+namespace {
+
+struct Event {
+  string name;
+  const char* category;
+  int pid, tid;
+  uint64_t start, end; /* host ns */
+};
+
+struct Track {
+  string name;
+  int64_t offset;      /* host ns minus device ns */
+};
+
+mutex events_lock;
+string path;
+uint64_t origin;
+vector<Event> events;
+vector<Track> tracks;
+map<thread::id, int> threads;
+
+/* Called with the lock held. */
+int thread_track()
+{
+  auto it = threads.find(this_thread::get_id());
+  if (it != threads.end())
+    return it->second;
+  int tid = threads.size() + 1;
+  threads[this_thread::get_id()] = tid;
+  return tid;
+}
+
+}
+
+bool Timeline::active = false;
+
+void Timeline::open(const string& file)
+{
+  path = file;
+  origin = now();
+  active = true;
+  atexit(write);
+}
+
+uint64_t Timeline::now()
+{
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Timeline::host_event(const string& name, const char* category, uint64_t start, uint64_t end)
+{
+  lock_guard<mutex> guard(events_lock);
+  events.push_back(Event{name, category, HOST_PID, thread_track(), start, end});
+}
+
+/**
+ * Timeline::device_track --
+ *
+ *      Adds a track for a command queue created with profiling enabled.
+ *      The clock offset assumes a marker completes halfway between its
+ *      enqueue and the return of clFinish, which is good to a few
+ *      microseconds on an idle queue.
+ *
+ * Results:
+ *      the track id for device_event.
+ */
+int Timeline::device_track(const string& name, cl_command_queue queue)
+{
+  int64_t offset = 0;
+  auto synced = false;
+#ifdef CL_VERSION_1_2
+  cl_event marker;
+  cl_ulong end;
+  auto before = now();
+  if (CL_SUCCESS == clEnqueueMarkerWithWaitList(queue, 0, NULL, &marker))
+  {
+    auto after = CL_SUCCESS == clFinish(queue) ? now() : 0;
+    if (after && CL_SUCCESS == clGetEventProfilingInfo(marker, CL_PROFILING_COMMAND_END, sizeof end, &end, NULL))
+    {
+      offset = (int64_t) (before + (after - before) / 2) - (int64_t) end;
+      synced = true;
+    }
+    clReleaseEvent(marker);
+  }
+#else
+  (void) queue;
+#endif
+  lock_guard<mutex> guard(events_lock);
+  tracks.push_back(Track{synced ? name : name + " (clock not synced)", offset});
+  return tracks.size() - 1;
+}
+
+void Timeline::device_event(int track, const string& name, cl_event event)
+{
+  cl_ulong start, end;
+  if (CL_SUCCESS != clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof start, &start, NULL)
+      || CL_SUCCESS != clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof end, &end, NULL))
+    return;
+  lock_guard<mutex> guard(events_lock);
+  auto offset = tracks[track].offset;
+  events.push_back(Event{name, "device", DEVICE_PID, track + 1, start + offset, end + offset});
+}
+
+/**
+ * Timeline::write --
+ *
+ *      Writes everything recorded so far; registered with atexit by open.
+ *
+ * Results:
+ *      void.
+ */
+void Timeline::write()
+{
+  lock_guard<mutex> guard(events_lock);
+  if (!active)
+    return;
+  active = false;
+  ofstream out(path);
+  if (!out)
+  {
+    cerr << "Unable to write the timeline to " << path << "!" << endl;
+    return;
+  }
+  char buf[128];
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << HOST_PID << ",\"args\":{\"name\":\"clinfo host\"}},\n";
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << DEVICE_PID << ",\"args\":{\"name\":\"devices\"}}";
+  for (auto& t : threads)
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << HOST_PID << ",\"tid\":" << t.second
+        << ",\"args\":{\"name\":\"thread " << t.second << "\"}}";
+  for (size_t ii = 0; ii < tracks.size(); ++ii)
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << DEVICE_PID << ",\"tid\":" << ii + 1
+        << ",\"args\":{\"name\":\"" << json_escape(tracks[ii].name) << "\"}}";
+  for (auto& e : events)
+  {
+    /* Device events may start before the origin if the clock sync is off */
+    auto start = (int64_t) (e.start - origin);
+    snprintf(buf, sizeof buf, "\"ts\":%.3f,\"dur\":%.3f", start * 1e-3, (int64_t) (e.end - e.start) * 1e-3);
+    out << ",\n{\"name\":\"" << json_escape(e.name) << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"pid\":"
+        << e.pid << ",\"tid\":" << e.tid << "," << buf << "}";
+  }
+  out << "\n]}\n";
+}
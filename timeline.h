@@ -0,0 +1,83 @@
+/**
+ * timeline.h --
+ *
+ *      Records a timeline of host calls and device commands and writes it
+ *      as Chrome/Perfetto trace-event JSON (clinfo --trace-out FILE).
+ *
+ *      Host events go on one track per host thread.  Device commands go
+ *      on one track per command queue, with their profiling timestamps
+ *      moved onto the host clock by an offset measured when the track is
+ *      created.  Recording is off, and costs a flag test, until open()
+ *      is called.
+ */
+#ifndef CLINFO_TIMELINE_H
+#define CLINFO_TIMELINE_H
+
+#include <cstdint>
+#include <string>
+#include "clinfo.h"
+
+class Timeline {
+
+public:
+
+  /* Starts recording; the file is written at exit. */
+  static void open(const std::string& path);
+  static bool enabled() { return active; }
+
+  /* Nanoseconds on the host monotonic clock. */
+  static uint64_t now();
+
+  static void host_event(const std::string& name, const char* category, uint64_t start, uint64_t end);
+
+  /* Creates a track for a profiling command queue and syncs its clock. */
+  static int device_track(const std::string& name, cl_command_queue queue);
+  static void device_event(int track, const std::string& name, cl_event event);
+
+  static void write();
+
+private:
+  static bool active;
+};
+
+/**
+ * Timeline_scope --
+ *
+ *      Records its own lifetime as a host event on the calling thread.
+ */
+class Timeline_scope {
+
+public:
+
+  Timeline_scope(const char* name, const char* category) : category(category), start(0)
+  {
+    if (Timeline::enabled())
+    {
+      this->name = name;
+      start = Timeline::now();
+    }
+  }
+  Timeline_scope(const std::string& name, const char* category) : category(category), start(0)
+  {
+    if (Timeline::enabled())
+    {
+      this->name = name;
+      start = Timeline::now();
+    }
+  }
+  ~Timeline_scope()
+  {
+    if (start)
+      Timeline::host_event(name, category, start, Timeline::now());
+  }
+
+private:
+  std::string name;
+  const char* category;
+  uint64_t start;
+
+  Timeline_scope(const Timeline_scope&) = delete;
+  Timeline_scope& operator=(const Timeline_scope&) = delete;
+};
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * trace_report.cpp --
+ *
+ *      clinfo --trace-report: summarises a libcltrace.so log.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+#include "clinfo.h"
+#include "cltrace.h"
+
+using namespace std;
+
+static double percentile(const vector<uint64_t>& sorted, double p)
+{
+  return sorted[min(sorted.size() - 1, (size_t) (p * sorted.size()))] * 1e-3;
+}
+
+int trace_report(const string& path)
+{
+  ifstream in(path, ios::binary);
+  Cltrace_header header;
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof header))
+  {
+    cerr << path << ": Unable to read the trace header!" << endl;
+    return EXIT_FAILURE;
+  }
+  if (0 != memcmp(header.magic, CLTRACE_MAGIC, sizeof CLTRACE_MAGIC)
+      || CLTRACE_VERSION != header.version || sizeof(Cltrace_record) != header.record_size)
+  {
+    cerr << path << ": Not a version " << CLTRACE_VERSION << " cltrace log!" << endl;
+    return EXIT_FAILURE;
+  }
+
+  vector<vector<uint64_t>> durations(CLTRACE_NUM_FUNCTIONS);
+  vector<uint64_t> totals(CLTRACE_NUM_FUNCTIONS), failures(CLTRACE_NUM_FUNCTIONS);
+  map<pair<unsigned, cl_int>, uint64_t> errors;
+  set<uint32_t> threads;
+  uint64_t calls = 0, dropped = 0, first = UINT64_MAX, last = 0;
+  Cltrace_record record;
+  while (in.read(reinterpret_cast<char*>(&record), sizeof record))
+  {
+    threads.insert(record.thread);
+    if (CLTRACE_DROPPED == record.function)
+    {
+      dropped += record.args[0];
+      continue;
+    }
+    if (record.function >= CLTRACE_NUM_FUNCTIONS)
+      continue;
+    ++calls;
+    first = min(first, record.start);
+    last = max(last, record.start + record.duration);
+    durations[record.function].push_back(record.duration);
+    totals[record.function] += record.duration;
+    if (CL_SUCCESS != record.status)
+    {
+      ++failures[record.function];
+      ++errors[make_pair((unsigned) record.function, (cl_int) record.status)];
+    }
+  }
+
+  printf("%s: pid %lu, %lu calls in %zu threads over %.3f s, %lu records dropped\n", path.c_str(),
+         (unsigned long) header.pid, (unsigned long) calls, threads.size(),
+         calls ? (last - first) * 1e-9 : 0.0, (unsigned long) dropped);
+  printf("traced: the core OpenCL host API; extension functions are not logged\n");
+  if (0 == calls)
+    return EXIT_SUCCESS;
+
+  vector<unsigned> order;
+  for (unsigned ii = 0; ii < CLTRACE_NUM_FUNCTIONS; ++ii)
+    if (!durations[ii].empty())
+      order.push_back(ii);
+  sort(order.begin(), order.end(), [&](unsigned a, unsigned b) { return totals[a] > totals[b]; });
+
+  printf("%-36s %9s %7s %12s %10s %10s %10s %10s %10s\n", "function", "calls", "errors",
+         "total ms", "mean us", "p50 us", "p90 us", "p99 us", "max us");
+  for (auto fn : order)
+  {
+    auto& d = durations[fn];
+    sort(d.begin(), d.end());
+    printf("%-36s %9zu %7lu %12.3f %10.2f %10.2f %10.2f %10.2f %10.2f\n", cltrace_function_name(fn),
+           d.size(), (unsigned long) failures[fn], totals[fn] * 1e-6, totals[fn] * 1e-3 / d.size(),
+           percentile(d, 0.50), percentile(d, 0.90), percentile(d, 0.99), d.back() * 1e-3);
+  }
+  if (!errors.empty())
+  {
+    printf("errors:\n");
+    for (auto& e : errors)
+      printf("  %-34s %-36s %9lu\n", cltrace_function_name(e.first.first), cl_error_str(e.first.second),
+             (unsigned long) e.second);
+  }
+  return EXIT_SUCCESS;
+}
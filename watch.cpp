@@ -0,0 +1,187 @@
+/**
+ * watch.cpp --
+ *
+ *      Polls the part of the inventory that can change while the ICDs
+ *      stay loaded (platform and device counts, device availability)
+ *      and prints each change as a JSON line.  A tick costs one
+ *      clGetPlatformIDs pair, one clGetDeviceIDs pair per platform and
+ *      one clGetDeviceInfo per dynamic property and device.
+ */
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "icd.h"
+#include "inventory.h"
+
+using namespace std;
+
+#define DYNAMIC_PROPS                        \
+    def(AVAILABLE),                          \
+    def(COMPILER_AVAILABLE),
+
+#define UNKNOWN -1 /* the query failed, printed as null */
+
+namespace {
+
+struct State {
+  int64_t platforms;
+  map<cl_uint, int64_t> devices;                      /* platform */
+  map<pair<cl_uint, cl_uint>, vector<int64_t>> props; /* platform, device */
+};
+
+}
+
+static void print_value(int64_t val)
+{
+  if (UNKNOWN == val)
+    printf("null");
+  else
+    printf("%lld", (long long) val);
+}
+
+/**
+ * print_change --
+ *
+ *      Prints one change, the first state having an old value of null.
+ *
+ * Results:
+ *      void.
+ */
+static void print_change(double now, int platform, int device, const char* what, int64_t old_val, int64_t new_val)
+{
+  printf("{\"time\": %.3f", now);
+  if (platform >= 0)
+    printf(", \"platform\": %d", platform);
+  if (device >= 0)
+    printf(", \"device\": %d", device);
+  printf(", \"property\": \"%s\", \"old\": ", what);
+  print_value(old_val);
+  printf(", \"new\": ");
+  print_value(new_val);
+  printf("}\n");
+}
+
+/**
+ * poll --
+ *
+ *      Queries the dynamic state once.
+ *
+ * Results:
+ *      the state.
+ */
+static State poll()
+{
+  static const cl_device_info params[] = {
+#define def(X) CL_DEVICE_##X
+    DYNAMIC_PROPS
+#undef def
+  };
+  State state;
+  auto enumeration = enumerate_devices();
+  state.platforms = CL_SUCCESS == enumeration.status ? static_cast<int64_t>(enumeration.platforms.size()) : UNKNOWN;
+
+  for (size_t ii = 0; ii < enumeration.platforms.size(); ++ii)
+  {
+    auto& platform = enumeration.platforms[ii];
+    if (CL_SUCCESS != platform.devices_status)
+    {
+      state.devices[ii] = UNKNOWN;
+      continue;
+    }
+    auto& devices = platform.devices;
+    state.devices[ii] = devices.size();
+    for (size_t jj = 0; jj < devices.size(); ++jj)
+    {
+      auto& vals = state.props[make_pair(ii, jj)];
+      for (auto param : params)
+      {
+        uint64_t val = 0; /* Narrower params fill only the low bytes */
+        if (CL_SUCCESS == icd_get_device_info(devices[jj], param, sizeof val, &val, NULL))
+          vals.push_back(val);
+        else
+          vals.push_back(UNKNOWN);
+      }
+    }
+  }
+  return state;
+}
+
+/**
+ * print_changes --
+ *
+ *      Prints the differences between two states.  Platforms and
+ *      devices that went away show up with a new value of null.
+ *
+ * Results:
+ *      true if anything was printed.
+ */
+static bool print_changes(double now, const State& old_state, const State& new_state)
+{
+  static const char* names[] = {
+#define def(X) #X
+    DYNAMIC_PROPS
+#undef def
+  };
+  auto changed = false;
+  if (old_state.platforms != new_state.platforms)
+  {
+    print_change(now, -1, -1, "PLATFORMS", old_state.platforms, new_state.platforms);
+    changed = true;
+  }
+
+  auto platforms = old_state.devices;
+  platforms.insert(new_state.devices.begin(), new_state.devices.end());
+  for (auto& p : platforms)
+  {
+    auto o = old_state.devices.find(p.first);
+    auto n = new_state.devices.find(p.first);
+    auto old_val = o == old_state.devices.end() ? UNKNOWN : o->second;
+    auto new_val = n == new_state.devices.end() ? UNKNOWN : n->second;
+    if (old_val != new_val)
+    {
+      print_change(now, p.first, -1, "DEVICES", old_val, new_val);
+      changed = true;
+    }
+  }
+
+  auto devices = old_state.props;
+  devices.insert(new_state.props.begin(), new_state.props.end());
+  for (auto& d : devices)
+  {
+    auto o = old_state.props.find(d.first);
+    auto n = new_state.props.find(d.first);
+    for (size_t ii = 0; ii < sizeof names / sizeof names[0]; ++ii)
+    {
+      auto old_val = o == old_state.props.end() ? UNKNOWN : o->second[ii];
+      auto new_val = n == new_state.props.end() ? UNKNOWN : n->second[ii];
+      if (old_val != new_val)
+      {
+        print_change(now, d.first.first, d.first.second, names[ii], old_val, new_val);
+        changed = true;
+      }
+    }
+  }
+  return changed;
+}
+
+int watch(double interval)
+{
+  State state;
+  state.platforms = UNKNOWN;
+  auto period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(interval));
+  auto tick = chrono::steady_clock::now();
+  for (;;)
+  {
+    auto next = poll();
+    auto now = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+    if (print_changes(now, state, next))
+      fflush(stdout);
+    state = next;
+    tick += period;
+    this_thread::sleep_until(tick);
+  }
+}
@@ -0,0 +1,83 @@
+/**
+ * watchdog.cpp --
+ *
+ *      Driver calls on a supervised worker thread, see watchdog.h.
+ */
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "watchdog.h"
+
+using namespace std;
+
+/* Shared by the watchdog and its worker thread, which outlives it when abandoned. */
+struct Watchdog::Worker {
+  mutex lock;
+  condition_variable wake, done;
+  function<void()> call;
+  bool pending = false;
+  bool quit = false;
+};
+
+Watchdog::Watchdog(unsigned timeout_ms) : timeout(timeout_ms), num_abandoned(0)
+{
+}
+
+Watchdog::~Watchdog()
+{
+  if (!worker)
+    return;
+  {
+    lock_guard<mutex> guard(worker->lock);
+    worker->quit = true;
+  }
+  worker->wake.notify_one();
+}
+
+bool Watchdog::run(const function<void()>& call)
+{
+  if (!worker)
+  {
+    worker = make_shared<Worker>();
+    thread(&Watchdog::work, worker).detach();
+  }
+  unique_lock<mutex> guard(worker->lock);
+  worker->call = call;
+  worker->pending = true;
+  worker->wake.notify_one();
+  if (worker->done.wait_for(guard, timeout, [this] { return !worker->pending; }))
+    return true;
+  /* Stuck in the driver: leave it the call, and quit once it returns */
+  worker->quit = true;
+  guard.unlock();
+  worker.reset();
+  ++num_abandoned;
+  return false;
+}
+
+/**
+ * Watchdog::work --
+ *
+ *      The worker thread: runs one call at a time until told to quit.
+ *
+ * Results:
+ *      void.
+ */
+void Watchdog::work(shared_ptr<Worker> w)
+{
+  unique_lock<mutex> guard(w->lock);
+  for (;;)
+  {
+    w->wake.wait(guard, [&] { return w->pending || w->quit; });
+    if (!w->pending)
+      return;
+    auto call = w->call;
+    guard.unlock();
+    call();
+    guard.lock();
+    w->pending = false;
+    w->done.notify_one();
+    if (w->quit)
+      return;
+  }
+}
@@ -0,0 +1,41 @@
+/**
+ * watchdog.h --
+ *
+ *      Driver calls with a deadline.  A call runs on a worker thread while
+ *      the caller waits for it; if it misses the deadline the caller gives
+ *      up on it and the worker is left to the driver, detached, with the
+ *      state it needs kept alive.  The next call gets a new worker.
+ *
+ *      A call that may be abandoned must only write to memory it owns.
+ */
+#ifndef CLINFO_WATCHDOG_H
+#define CLINFO_WATCHDOG_H
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+class Watchdog {
+
+public:
+
+  explicit Watchdog(unsigned timeout_ms);
+  ~Watchdog();
+
+  /* Runs call on the worker; false if it missed the deadline. */
+  bool run(const std::function<void()>& call);
+  /* The calls given up on so far. */
+  size_t abandoned() const { return num_abandoned; }
+
+private:
+  struct Worker;
+  std::shared_ptr<Worker> worker;
+  std::chrono::milliseconds timeout;
+  size_t num_abandoned;
+
+  static void work(std::shared_ptr<Worker> w);
+  Watchdog(const Watchdog&) = delete;
+  Watchdog& operator=(const Watchdog&) = delete;
+};
+
+#endif